@@ -0,0 +1,26 @@
+# Command-line calibration tool (no GUI)
+
+include(common.pri)
+
+QT = core serialport
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = auto-calib-cli
+TEMPLATE = app
+
+SOURCES += \
+	src/cli.cpp \
+	src/headless-runner.cpp \
+	src/batch-queue.cpp
+
+HEADERS += \
+	src/headless-runner.h \
+	src/batch-queue.h
+
+LIBS = -L$$CORE_DIR -l$$CORE_LIB $$LIBS
+PRE_TARGETDEPS += $$CORE_LIB_FILE
+
+# batch-queue is compiled by gui.pro too, keep objects of the apps apart
+OBJECTS_DIR = $$OUT_PWD/.obj-cli
+MOC_DIR = $$OUT_PWD/.moc-cli
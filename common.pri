@@ -0,0 +1,45 @@
+# Settings shared by all the auto-calib subprojects
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# You can also make your code fail to compile if you use deprecated APIs.
+# In order to do so, uncomment the following line.
+# You can also select to disable deprecated APIs only up to a certain version of Qt.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+CONFIG += c++17
+QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -std=c++17
+INCLUDEPATH += $$PWD $$PWD/src
+
+win32 {
+	LIBS += -lsetupapi
+}
+win64 {
+	LIBS += -lsetupapi
+}
+
+VERSION_MAJOR = 1
+VERSION_MINOR = 5
+
+DEFINES += "VERSION_MAJOR=$$VERSION_MAJOR" \
+	"VERSION_MINOR=$$VERSION_MINOR"
+
+#Target version
+VERSION = $${VERSION_MAJOR}.$${VERSION_MINOR}
+
+# Single build configuration per build directory: no debug/ & release/
+# subdirectories, so applications find the core library in CORE_DIR
+CONFIG -= debug_and_release debug_and_release_target
+
+# Calibration core library (core.pro) linked to applications
+CORE_DIR = $$OUT_PWD
+CORE_LIB = auto-calib-core
+win32-msvc* {
+	CORE_LIB_FILE = $$CORE_DIR/$${CORE_LIB}.lib
+} else {
+	CORE_LIB_FILE = $$CORE_DIR/lib$${CORE_LIB}.a
+}
@@ -0,0 +1,69 @@
+# Calibration core: XpressNET & WSM libraries and calibration classes shared
+# by GUI and CLI. Application helpers are compiled in the applications.
+
+include(common.pri)
+
+QT = core serialport
+
+TARGET = auto-calib-core
+TEMPLATE = lib
+CONFIG += staticlib
+
+SOURCES += \
+	lib/wsm/wsm.cpp \
+	lib/xn/xn.cpp \
+	lib/xn/xn-api.cpp \
+	lib/xn/xn-receive.cpp \
+	lib/xn/xn-send.cpp \
+	lib/xn/xn-hist.cpp \
+	lib/xn/xn-win-com-discover.cpp \
+	src/settings.cpp \
+	src/power-map.cpp \
+	src/speed-map.cpp \
+	src/calib-step.cpp \
+	src/calib-man.cpp \
+	src/calib-overview.cpp \
+	src/calib-range.cpp \
+	src/settle-detector.cpp \
+	src/speed-estimator.cpp \
+	src/sample-buffer.cpp \
+	src/track-mark.cpp \
+	src/step-planner.cpp \
+	src/pom-queue.cpp \
+	src/decoder-image.cpp \
+	src/calib-config.cpp \
+	src/loco-file.cpp \
+	src/clock.cpp \
+	src/calib-metrics.cpp \
+	src/trace.cpp \
+	src/log-sink.cpp
+
+HEADERS += \
+	lib/q-str-exception.h \
+	lib/wsm/q-str-exception.h \
+	lib/wsm/wsm.h \
+	lib/xn/xn.h \
+	lib/xn/xn-loco-addr.h \
+	lib/xn/xn-commands.h \
+	lib/xn/xn-win-com-discover.h \
+	lib/xn/q-str-exception.h \
+	src/settings.h \
+	src/power-map.h \
+	src/speed-map.h \
+	src/calib-step.h \
+	src/calib-man.h \
+	src/calib-overview.h \
+	src/calib-range.h \
+	src/settle-detector.h \
+	src/speed-estimator.h \
+	src/sample-buffer.h \
+	src/track-mark.h \
+	src/step-planner.h \
+	src/pom-queue.h \
+	src/decoder-image.h \
+	src/calib-config.h \
+	src/loco-file.h \
+	src/clock.h \
+	src/calib-metrics.h \
+	src/trace.h \
+	src/log-sink.h
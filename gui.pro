@@ -0,0 +1,47 @@
+# GUI application
+
+include(common.pri)
+
+QT += core gui serialport charts concurrent
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = auto-calib
+TEMPLATE = app
+
+SOURCES += \
+	src/main.cpp \
+	src/main-window.cpp \
+	src/station.cpp \
+	src/batch-queue.cpp \
+	src/worker-thread.cpp \
+	src/decimated-series.cpp \
+	src/log-model.cpp \
+	src/power-graph-window.cpp \
+	src/speed-chart-window.cpp
+
+HEADERS += \
+	src/main-window.h \
+	src/station.h \
+	src/batch-queue.h \
+	src/worker-thread.h \
+	src/decimated-series.h \
+	src/log-model.h \
+	src/power-graph-window.h \
+	src/speed-chart-window.h
+
+FORMS += \
+	form/main-window.ui \
+	form/power-graph-window.ui \
+	form/speed-chart-window.ui
+
+UI_DIR = src
+
+RESOURCES += auto-calib.qrc
+win32:RC_ICONS += icon/app-icon.ico
+
+LIBS = -L$$CORE_DIR -l$$CORE_LIB $$LIBS
+PRE_TARGETDEPS += $$CORE_LIB_FILE
+
+# batch-queue is compiled by cli.pro too, keep objects of the apps apart
+OBJECTS_DIR = $$OUT_PWD/.obj-gui
+MOC_DIR = $$OUT_PWD/.moc-gui
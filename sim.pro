@@ -0,0 +1,69 @@
+# Simulator of loco, decoder, XpressNET & WSM running calibration core on
+# virtual time (see sim/ and src/clock.h). sim/lib replaces XpressNET & WSM
+# libraries, so the core sources are compiled here again instead of linking
+# the core library.
+
+include(common.pri)
+
+QT = core serialport
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = auto-calib-sim
+TEMPLATE = app
+
+# sim/lib/{xn,wsm} must be found before lib/{xn,wsm}
+INCLUDEPATH = $$PWD/sim $$INCLUDEPATH
+
+SOURCES += \
+	sim/sim-main.cpp \
+	sim/loco-model.cpp \
+	sim/recording.cpp \
+	sim/lib/xn/xn.cpp \
+	sim/lib/wsm/wsm.cpp \
+	src/settings.cpp \
+	src/power-map.cpp \
+	src/speed-map.cpp \
+	src/calib-step.cpp \
+	src/calib-man.cpp \
+	src/calib-overview.cpp \
+	src/settle-detector.cpp \
+	src/speed-estimator.cpp \
+	src/sample-buffer.cpp \
+	src/track-mark.cpp \
+	src/step-planner.cpp \
+	src/pom-queue.cpp \
+	src/decoder-image.cpp \
+	src/calib-config.cpp \
+	src/clock.cpp \
+	src/calib-metrics.cpp \
+	src/trace.cpp \
+	src/log-sink.cpp
+
+HEADERS += \
+	sim/loco-model.h \
+	sim/recording.h \
+	sim/lib/xn/xn.h \
+	sim/lib/wsm/wsm.h \
+	src/settings.h \
+	src/power-map.h \
+	src/speed-map.h \
+	src/calib-step.h \
+	src/calib-man.h \
+	src/calib-overview.h \
+	src/settle-detector.h \
+	src/speed-estimator.h \
+	src/sample-buffer.h \
+	src/track-mark.h \
+	src/step-planner.h \
+	src/pom-queue.h \
+	src/decoder-image.h \
+	src/calib-config.h \
+	src/clock.h \
+	src/calib-metrics.h \
+	src/trace.h \
+	src/log-sink.h
+
+# Core sources are compiled again here, keep their objects apart from core.pro
+OBJECTS_DIR = $$OUT_PWD/.obj-sim
+MOC_DIR = $$OUT_PWD/.moc-sim
@@ -0,0 +1,46 @@
+#include <cmath>
+
+#include "lib/wsm/wsm.h"
+
+namespace Wsm {
+
+Wsm::Wsm(QObject *parent) : QObject(parent) {
+	QObject::connect(&t_sample, SIGNAL(timeout()), this, SLOT(t_sample_tick()));
+}
+
+void Wsm::connect(const QString &) {
+	m_connected = true;
+	t_sample.start(sample_interval);
+}
+
+void Wsm::disconnect() {
+	t_sample.stop();
+	m_connected = false;
+}
+
+bool Wsm::connected() const { return m_connected; }
+bool Wsm::isSpeedOk() const { return m_connected && loco != nullptr; }
+
+uint32_t Wsm::distRaw() const {
+	if (loco == nullptr)
+		return 0;
+	const double circumference = M_PI * wheelDiameter / 1000; // m
+	return static_cast<uint32_t>(loco->position() / circumference * ticksPerRevolution);
+}
+
+double Wsm::calcDist(const uint32_t dist_raw) const {
+	return dist_raw * M_PI * wheelDiameter / 1000 / ticksPerRevolution;
+}
+
+double Wsm::dist() const { return calcDist(distRaw()); }
+
+void Wsm::t_sample_tick() {
+	if (loco == nullptr)
+		return;
+	const double speed = loco->measuredSpeed(); // updates position too
+	const uint32_t dist_raw = distRaw();
+	emit distanceRead(calcDist(dist_raw), dist_raw);
+	emit speedRead(speed, 0);
+}
+
+} // namespace Wsm
@@ -0,0 +1,75 @@
+#ifndef SIM_WSM_H
+#define SIM_WSM_H
+
+/*
+Simulated wireless speedometer. This header replaces lib/wsm/wsm.h in the
+simulator build. It provides only the part of the WSM library API the
+calibration core uses.
+
+ * After connect(), measured speed of the simulated loco (loco-model.h) is
+   reported each 'sample_interval' ms of virtual time (clock.h).
+ * Distance counter counts ticksPerRevolution ticks per revolution of
+   a wheelDiameter mm wheel; distance is in real meters.
+*/
+
+#include <QObject>
+#include <QString>
+
+#include "clock.h"
+#include "loco-model.h"
+
+namespace Wsm {
+
+constexpr unsigned DEFAULT_SAMPLE_INTERVAL = 100; // ms
+
+class QStrException {
+	QString m_err_msg;
+
+public:
+	QStrException(const QString msg) : m_err_msg(msg) {}
+	QString str() const noexcept { return this->m_err_msg; }
+	operator QString() const { return this->m_err_msg; }
+};
+
+struct EOpenError : public QStrException {
+	EOpenError(const QString str) : QStrException(str) {}
+};
+
+class Wsm : public QObject {
+	Q_OBJECT
+
+public:
+	Sim::Loco *loco = nullptr;
+	unsigned sample_interval = DEFAULT_SAMPLE_INTERVAL;
+	unsigned scale = 120;
+	double wheelDiameter = 8; // mm
+	double ticksPerRevolution = 8;
+
+	Wsm(QObject *parent = nullptr);
+
+	void connect(const QString &portname);
+	void disconnect();
+	bool connected() const;
+	bool isSpeedOk() const;
+	uint32_t distRaw() const;
+	double calcDist(uint32_t dist_raw) const; // m
+	double dist() const; // m
+
+private:
+	Vc::Timer t_sample;
+	bool m_connected = false;
+
+private slots:
+	void t_sample_tick();
+
+signals:
+	void speedRead(double speed, uint16_t speed_raw);
+	void distanceRead(double distance, uint32_t distance_raw);
+	void onError(QString error);
+	void speedReceiveTimeout();
+	void speedReceiveRestore();
+};
+
+} // namespace Wsm
+
+#endif
@@ -0,0 +1,67 @@
+#include "clock.h"
+#include "lib/xn/xn.h"
+
+namespace Xn {
+
+LIType liInterface(const QString &name) {
+	if (name == "LI100")
+		return LIType::LI100;
+	if (name == "LI101")
+		return LIType::LI101;
+	if (name == "LI-USB-Ethernet")
+		return LIType::LIUSBEth;
+	return LIType::uLI;
+}
+
+XpressNet::XpressNet(QObject *parent) : QObject(parent) {}
+
+void XpressNet::connect(const QString &, int32_t, QSerialPort::FlowControl, LIType) {
+	m_connected = true;
+}
+
+void XpressNet::disconnect() { m_connected = false; }
+bool XpressNet::connected() const { return m_connected; }
+void XpressNet::setConfig(const XNConfig &config) { m_out_interval = config.outInterval; }
+unsigned XpressNet::commands() const { return m_commands; }
+
+void XpressNet::send(std::function<void()> apply, const bool may_fail, UPCb ok, UPCb err) {
+	if (!m_connected)
+		throw QStrException("XpressNET not connected!");
+
+	m_commands++;
+	m_busy_until = std::max(m_busy_until, Vc::now()) + m_out_interval;
+	const bool fail = may_fail && (std::uniform_real_distribution<double>(0, 1)(m_random) < error_rate);
+
+	std::shared_ptr<Cb> okCb = std::move(ok);
+	std::shared_ptr<Cb> errCb = std::move(err);
+	Vc::singleShot(m_busy_until - Vc::now(), [this, apply, fail, okCb, errCb]() {
+		if (fail) {
+			if (errCb != nullptr)
+				errCb->func(this, errCb->data);
+			return;
+		}
+		apply();
+		if (okCb != nullptr)
+			okCb->func(this, okCb->data);
+	});
+}
+
+void XpressNet::pomWriteCv(const LocoAddr &, uint16_t cv, uint8_t value, UPCb ok, UPCb err) {
+	send([this, cv, value]() { if (loco != nullptr) loco->writeCv(cv, value); },
+	     true, std::move(ok), std::move(err));
+}
+
+void XpressNet::pomWriteBit(const LocoAddr &, uint16_t cv, uint8_t biti, bool value, UPCb ok,
+                            UPCb err) {
+	send([this, cv, biti, value]() { if (loco != nullptr) loco->writeBit(cv, biti, value); },
+	     true, std::move(ok), std::move(err));
+}
+
+void XpressNet::setSpeed(const LocoAddr &, uint8_t speed, Direction direction, UPCb ok, UPCb err) {
+	send([this, speed, direction]() {
+		if (loco != nullptr)
+			loco->setSpeed(speed, direction == Direction::Forward);
+	}, false, std::move(ok), std::move(err));
+}
+
+} // namespace Xn
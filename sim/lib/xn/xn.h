@@ -0,0 +1,107 @@
+#ifndef SIM_XN_H
+#define SIM_XN_H
+
+/*
+Simulated XpressNET. This header replaces lib/xn/xn.h in the simulator build
+(sim.pro puts sim/ first to the include path). It provides only the part of
+the XpressNET library API the calibration core uses.
+
+ * Commands are executed on the virtual clock (clock.h) one by one, each
+   takes 'out_interval' ms like the real LI (outIntervalMs).
+ * Commands are applied to the simulated loco (loco-model.h).
+ * 'error_rate' of POM commands fail randomly (no response from LI).
+*/
+
+#include <QObject>
+#include <QSerialPort>
+#include <QString>
+#include <functional>
+#include <memory>
+#include <random>
+
+#include "loco-model.h"
+
+namespace Xn {
+
+class QStrException {
+	QString m_err_msg;
+
+public:
+	QStrException(const QString msg) : m_err_msg(msg) {}
+	QString str() const noexcept { return this->m_err_msg; }
+	operator QString() const { return this->m_err_msg; }
+};
+
+constexpr size_t _STEPS_CNT = 28;
+
+enum class Direction {
+	Backward = false,
+	Forward = true,
+};
+
+enum class LIType {
+	LI100,
+	LI101,
+	uLI,
+	LIUSBEth,
+};
+
+LIType liInterface(const QString &);
+
+struct XNConfig {
+	size_t outInterval = 50; // ms
+};
+
+struct LocoAddr {
+	uint16_t addr;
+
+	LocoAddr(uint16_t addr) : addr(addr) {}
+	LocoAddr(uint8_t lo, uint8_t hi) : addr(lo | (hi << 8)) {}
+	operator uint16_t() const { return addr; }
+};
+
+using CbFunc = std::function<void(void *sender, void *data)>;
+
+struct Cb {
+	CbFunc const func;
+	void *const data;
+
+	Cb(CbFunc const func, void *const data = nullptr) : func(func), data(data) {}
+};
+
+using UPCb = std::unique_ptr<Cb>;
+
+class XpressNet : public QObject {
+public:
+	Sim::Loco *loco = nullptr;
+	double error_rate = 0;
+
+	XpressNet(QObject *parent = nullptr);
+
+	void connect(const QString &portname, int32_t br, QSerialPort::FlowControl, LIType);
+	void disconnect();
+	bool connected() const;
+	void setConfig(const XNConfig &);
+
+	void pomWriteCv(const LocoAddr &, uint16_t cv, uint8_t value, UPCb ok = nullptr,
+	                UPCb err = nullptr);
+	void pomWriteBit(const LocoAddr &, uint16_t cv, uint8_t biti, bool value,
+	                 UPCb ok = nullptr, UPCb err = nullptr);
+	void setSpeed(const LocoAddr &, uint8_t speed, Direction direction, UPCb ok = nullptr,
+	              UPCb err = nullptr);
+
+	unsigned commands() const; // number of commands sent
+
+private:
+	bool m_connected = true;
+	size_t m_out_interval = XNConfig().outInterval;
+	qint64 m_busy_until = 0;
+	unsigned m_commands = 0;
+	std::mt19937 m_random;
+
+	void send(std::function<void()> apply, bool may_fail, UPCb ok, UPCb err);
+};
+
+} // namespace Xn
+
+#endif
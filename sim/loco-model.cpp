@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "clock.h"
+#include "cvs.h"
+#include "loco-model.h"
+
+namespace Sim {
+
+constexpr double SCALE = 120; // TT
+constexpr double ACCEL_SECONDS_PER_CV = 0.9; // CV3/CV4 unit: time from 0 to full power
+constexpr double UPDATE_MAX_DT = 0.02; // s, integration step
+
+LocoParams LocoParams::random(std::mt19937 &gen) {
+	LocoParams p;
+	p.max_speed = std::uniform_real_distribution<double>(70, 220)(gen);
+	p.start_power = std::uniform_int_distribution<unsigned>(5, 45)(gen);
+	p.gamma = std::uniform_real_distribution<double>(0.7, 1.5)(gen);
+	p.inertia = std::uniform_real_distribution<double>(0.2, 2.0)(gen);
+	p.noise = std::uniform_real_distribution<double>(0.005, 0.05)(gen);
+	p.gradient = std::uniform_real_distribution<double>(0.0, 0.06)(gen);
+	p.track_length = std::uniform_real_distribution<double>(5, 25)(gen);
+	return p;
+}
+
+Loco::Loco(const LocoParams &params, const unsigned seed) : params(params), m_random(seed) {
+	m_cvs[CV_START_VOLTAGE] = 1;
+	m_cvs[CV_VMAX] = 255;
+	m_cvs[CV_BASIC_CONFIG] = 0x06;
+	for (unsigned i = 0; i < STEPS_CNT; i++)
+		m_cvs[CV_CURVE_START+i] = static_cast<uint8_t>(1 + ((POWER_MAX-1) * i) / (STEPS_CNT-1));
+	m_last_update = Vc::now();
+}
+
+uint8_t Loco::cv(const unsigned cv) const {
+	auto it = m_cvs.find(cv);
+	return (it != m_cvs.end()) ? it->second : 0;
+}
+
+void Loco::writeCv(const unsigned cv, const uint8_t value) {
+	update();
+	m_cvs[cv] = value;
+}
+
+void Loco::writeBit(const unsigned cv, const unsigned bit, const bool value) {
+	update();
+	m_cvs[cv] = (this->cv(cv) & ~(1 << bit)) | (value << bit);
+}
+
+void Loco::setSpeed(const unsigned step, const bool forward) {
+	update();
+	m_step = std::min(step, STEPS_CNT);
+	m_forward = forward;
+}
+
+unsigned Loco::step() const { return m_step; }
+bool Loco::forward() const { return m_forward; }
+
+unsigned Loco::power(const unsigned step) const {
+	if (step == 0)
+		return 0;
+	if ((cv(CV_BASIC_CONFIG) >> CV_CONFIG_BIT_SPEED_TABLE) & 1)
+		return cv(CV_CURVE_START + step - 1);
+
+	const unsigned vstart = cv(CV_START_VOLTAGE);
+	const unsigned vhigh = (cv(CV_VMAX) == 0) ? POWER_MAX : cv(CV_VMAX);
+	return vstart + ((vhigh - std::min(vstart, vhigh)) * (step-1)) / (STEPS_CNT-1);
+}
+
+double Loco::steadySpeed(const unsigned power) const {
+	const double vmax = params.max_speed * ((cv(CV_VMAX) == 0) ? 255 : cv(CV_VMAX)) / 255.0;
+	if (!params.curve.empty())
+		return curveSpeed(power) * vmax / params.max_speed;
+	if (power <= params.start_power)
+		return 0;
+	const double x = static_cast<double>(power - params.start_power) / (POWER_MAX - params.start_power);
+	return vmax * std::pow(x, params.gamma);
+}
+
+double Loco::curveSpeed(const unsigned power) const {
+	// Linear interpolation, power 0 = standing, extrapolation by the last segment
+	const std::map<unsigned, double> &curve = params.curve;
+	auto upper = curve.lower_bound(power);
+	if (upper != curve.end() && upper->first == power)
+		return upper->second;
+
+	std::pair<unsigned, double> left{0, 0};
+	std::pair<unsigned, double> right;
+	if (upper == curve.end()) {
+		right = *std::prev(upper);
+		if (curve.size() > 1)
+			left = *std::prev(upper, 2);
+	} else {
+		right = *upper;
+		if (upper != curve.begin())
+			left = *std::prev(upper);
+	}
+	if (right.first == left.first)
+		return right.second;
+
+	const double speed = left.second + (right.second - left.second) *
+	                     (static_cast<double>(power) - left.first) / (right.first - left.first);
+	return std::max(speed, 0.0);
+}
+
+void Loco::update() {
+	const qint64 now = Vc::now();
+	double dt_total = (now - m_last_update) / 1000.0;
+	m_last_update = now;
+
+	const double target_power = power(m_step);
+	while (dt_total > 0) {
+		const double dt = std::min(dt_total, UPDATE_MAX_DT);
+		dt_total -= dt;
+
+		// Decoder acceleration/deceleration ramps power
+		const unsigned ramp_cv = (target_power > m_power) ? cv(CV_ACCEL) : cv(CV_DECEL);
+		if (ramp_cv == 0) {
+			m_power = target_power;
+		} else {
+			const double rate = POWER_MAX / (ramp_cv * ACCEL_SECONDS_PER_CV); // power/s
+			if (target_power > m_power)
+				m_power = std::min(target_power, m_power + rate*dt);
+			else
+				m_power = std::max(target_power, m_power - rate*dt);
+		}
+
+		// Motor inertia & track gradient
+		const double phase = 2*M_PI * m_position / params.track_length;
+		const double target_speed = steadySpeed(static_cast<unsigned>(std::lround(m_power))) *
+		                            (1 + params.gradient*std::sin(phase));
+		m_speed += (target_speed - m_speed) * (1 - std::exp(-dt / params.inertia));
+		m_position += (m_speed / 3.6 / SCALE) * dt;
+	}
+}
+
+double Loco::speed() {
+	update();
+	return m_speed;
+}
+
+double Loco::position() const { return m_position; }
+
+double Loco::measuredSpeed() {
+	const double real = speed();
+	if (real <= 0)
+		return 0;
+	if (!params.noise_samples.empty()) {
+		const double noise = params.noise_samples[m_noise_index++ % params.noise_samples.size()];
+		return std::max(0.0, real * (1 + noise));
+	}
+	return std::max(0.0, real * (1 + params.noise*m_noise(m_random)));
+}
+
+} // namespace Sim
@@ -0,0 +1,86 @@
+#ifndef LOCO_MODEL_H
+#define LOCO_MODEL_H
+
+/*
+This file defines a simulated loco with a DCC decoder. It is used by the
+fake XpressNET & WSM (sim/lib) to calibrate synthetic locos.
+
+ * Decoder: CVs, 28 speed steps, speed table (CV 67-94) enabled by CV29 bit
+   4, otherwise linear curve Vstart (CV2) - Vhigh (CV5). Accel (CV3) and
+   decel (CV4) ramp the power like a real decoder.
+ * Motor: power-to-speed curve with a start power and nonlinearity, speed
+   follows the curve with first-order inertia.
+ * Track: periodic gradient which changes speed along the track.
+ * Measurement: WSM speed with gaussian noise.
+ * Alternatively, the curve and the noise could be given as recorded data
+   (see recording.h): curve is interpolated linearly, noise is replayed.
+
+All the randomness comes from a seeded generator, so the same seed gives
+the same loco and the same run.
+*/
+
+#include <QtGlobal>
+#include <array>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace Sim {
+
+constexpr unsigned POWER_MAX = 255;
+constexpr unsigned STEPS_CNT = 28;
+
+struct LocoParams {
+	double max_speed = 120; // km/h at full power & CV5=255
+	unsigned start_power = 20; // lowest power which moves the loco
+	double gamma = 1.0; // curve nonlinearity (1 = linear)
+	double inertia = 0.6; // s, time constant of motor
+	double noise = 0.02; // relative sigma of measured speed
+	double gradient = 0.03; // relative speed change on the steepest gradient
+	double track_length = 12; // m (real), period of the gradient
+	std::map<unsigned, double> curve; // power -> km/h, replaces the parametric curve when set
+	std::vector<double> noise_samples; // relative noise replayed in order instead of gaussian
+
+	static LocoParams random(std::mt19937 &);
+};
+
+class Loco {
+public:
+	LocoParams params;
+
+	Loco(const LocoParams &, unsigned seed);
+
+	// Decoder
+	void setSpeed(unsigned step, bool forward);
+	void writeCv(unsigned cv, uint8_t value);
+	void writeBit(unsigned cv, unsigned bit, bool value);
+	uint8_t cv(unsigned cv) const;
+	unsigned power(unsigned step) const; // power the decoder assigns to step
+	unsigned step() const;
+	bool forward() const;
+
+	// Physics
+	double steadySpeed(unsigned power) const; // km/h, no gradient
+	double speed(); // km/h, true speed at current time
+	double measuredSpeed(); // km/h, speed with measurement noise
+	double position() const; // m (real) travelled, as of the last speed()
+
+private:
+	std::map<unsigned, uint8_t> m_cvs;
+	std::mt19937 m_random;
+	std::normal_distribution<double> m_noise{0.0, 1.0};
+	unsigned m_step = 0;
+	bool m_forward = true;
+	double m_power = 0; // current (ramped) power
+	double m_speed = 0; // km/h
+	double m_position = 0; // m
+	qint64 m_last_update = 0;
+	size_t m_noise_index = 0;
+
+	void update();
+	double curveSpeed(unsigned power) const;
+};
+
+} // namespace Sim
+
+#endif
@@ -0,0 +1,185 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <deque>
+#include <optional>
+
+#include "lib/q-str-exception.h"
+#include "recording.h"
+
+namespace Sim {
+
+constexpr size_t MAX_WINDOW = 256; // samples kept to match measure windows
+constexpr double MIN_INERTIA_CHANGE = 1; // km/h, smaller speed changes are not used
+
+struct Sample {
+	qint64 time;
+	double speed;
+};
+
+struct PowerChange {
+	qint64 time;
+	double speed_before;
+	std::vector<Sample> samples;
+};
+
+struct LocoTrace {
+	std::map<unsigned, std::vector<double>> speeds; // power -> measured speeds
+	std::vector<double> noise;
+	std::vector<double> inertias; // s
+	std::vector<qint64> intervals; // ms
+	std::deque<Sample> window;
+	std::optional<PowerChange> change;
+	std::optional<qint64> run_start;
+	unsigned runs = 0;
+	bool done = false;
+	qint64 time = 0;
+	unsigned iterations = 0;
+	unsigned measures = 0;
+};
+
+template <typename T>
+static T median(std::vector<T> values) {
+	std::nth_element(values.begin(), values.begin() + values.size()/2, values.end());
+	return values[values.size()/2];
+}
+
+static void measured(LocoTrace &loco, const QJsonObject &record, const bool step) {
+	const unsigned power = record["power"].toInt();
+	const double speed = record["speed"].toDouble();
+	const size_t samples = record["samples"].toInt();
+	loco.speeds[power].push_back(speed);
+	loco.measures++;
+
+	if (speed > 0) {
+		// Samples of the measure window are the last 'samples' samples
+		const size_t count = std::min(samples, loco.window.size());
+		for (auto it = loco.window.end() - count; it != loco.window.end(); ++it)
+			loco.noise.push_back(it->speed / speed - 1);
+	}
+
+	if (step && loco.change.has_value()) {
+		const PowerChange &change = loco.change.value();
+		const double delta = speed - change.speed_before;
+		if (std::abs(delta) >= MIN_INERTIA_CHANGE) {
+			for (const Sample &sample : change.samples) {
+				if ((sample.speed - change.speed_before) / delta >= 0.63) {
+					loco.inertias.push_back((sample.time - change.time) / 1000.0);
+					break;
+				}
+			}
+		}
+		loco.change.reset();
+	}
+}
+
+static void runEnd(LocoTrace &loco, const qint64 time, const bool done) {
+	if (!loco.run_start.has_value())
+		return;
+	loco.time += time - loco.run_start.value();
+	loco.done = done;
+	loco.run_start.reset();
+}
+
+static void loadFile(const QString &filename, std::vector<Recording> &recordings) {
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		throw QStrException("Unable to open " + filename + ": " + file.errorString());
+
+	std::map<unsigned, LocoTrace> locos;
+	while (!file.atEnd()) {
+		const QJsonObject record = QJsonDocument::fromJson(file.readLine()).object();
+		if (record.isEmpty())
+			continue; // truncated line of an interrupted trace
+		const qint64 t = record["t"].toVariant().toLongLong();
+		const QString src = record["src"].toString();
+		const QString ev = record["ev"].toString();
+
+		if (src == "trace" && ev == "open") {
+			// Time restarts, runs interrupted without end record are lost
+			for (auto &loco : locos) {
+				loco.second.run_start.reset();
+				loco.second.change.reset();
+				loco.second.window.clear();
+			}
+			continue;
+		}
+
+		if (!record.contains("loco"))
+			continue;
+		LocoTrace &loco = locos[record["loco"].toInt()];
+
+		if (src == "wsm" && ev == "speed") {
+			const Sample sample{t, record["speed"].toDouble()};
+			if (!loco.window.empty())
+				loco.intervals.push_back(sample.time - loco.window.back().time);
+			loco.window.push_back(sample);
+			if (loco.window.size() > MAX_WINDOW)
+				loco.window.pop_front();
+			if (loco.change.has_value())
+				loco.change->samples.push_back(sample);
+		} else if (src == "cs" && ev == "set_power") {
+			loco.iterations++;
+			const double before = loco.window.empty() ? 0 : loco.window.back().speed;
+			loco.change = PowerChange{t, before, {}};
+		} else if (src == "cs" && ev == "measured") {
+			measured(loco, record, true);
+		} else if (src == "co" && ev == "measured") {
+			measured(loco, record, false);
+		} else if (src == "cm" && ev == "run_start") {
+			loco.run_start = t;
+			loco.runs++;
+		} else if (src == "cm" && ev == "done") {
+			runEnd(loco, t, true);
+		} else if (src == "cm" && (ev == "error" || ev == "stop")) {
+			runEnd(loco, t, false);
+		}
+	}
+
+	for (auto &pair : locos) {
+		LocoTrace &loco = pair.second;
+		if (loco.speeds.empty())
+			continue; // nothing to build the model from
+
+		Recording recording;
+		recording.name = QFileInfo(filename).fileName() + ":" + QString::number(pair.first);
+		recording.loco = pair.first;
+		recording.runs = loco.runs;
+		recording.done = loco.done;
+		recording.time = loco.time / 1000.0;
+		recording.iterations = loco.iterations;
+		recording.measures = loco.measures;
+
+		for (const auto &speeds : loco.speeds) {
+			double sum = 0;
+			for (const double speed : speeds.second)
+				sum += speed;
+			recording.params.curve[speeds.first] = sum / speeds.second.size();
+		}
+		recording.params.noise_samples = loco.noise;
+		recording.params.gradient = 0; // contained in recorded noise
+		if (!loco.inertias.empty())
+			recording.params.inertia = std::max(median(loco.inertias), 0.05);
+		if (!loco.intervals.empty())
+			recording.sample_interval = std::max<qint64>(median(loco.intervals), 1);
+
+		recordings.push_back(recording);
+	}
+}
+
+std::vector<Recording> loadRecordings(const QString &path) {
+	std::vector<Recording> recordings;
+	if (QFileInfo(path).isDir()) {
+		const QDir dir(path);
+		for (const QString &name : dir.entryList({"*.jsonl"}, QDir::Files, QDir::Name))
+			loadFile(dir.filePath(name), recordings);
+	} else {
+		loadFile(path, recordings);
+	}
+	return recordings;
+}
+
+} // namespace Sim
@@ -0,0 +1,48 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+/*
+This file defines loading of recorded calibration traces (JSONL, see
+src/trace.h) for replay in the simulator. Each loco in a trace becomes
+a Recording: a loco model fitted to the recorded data plus the outcome of
+the recorded calibration, so a replay with a different configuration could
+be compared with the real run.
+
+ * Power-to-speed curve: mean of recorded speed measures (CalibStep and
+   CalibOverview) per power.
+ * Noise: relative deviations of recorded WSM samples from the mean of
+   their measure window, replayed in the recorded order.
+ * Inertia: median time in which the speed reached 63 % of its change
+   after a new power was set.
+ * WSM sample interval: median interval of recorded samples.
+ * Traces of multiple runs of the same loco (in the same file) are merged.
+*/
+
+#include <QString>
+#include <map>
+#include <vector>
+
+#include "loco-model.h"
+
+namespace Sim {
+
+struct Recording {
+	QString name; // <file>:<loco>
+	unsigned loco = 0;
+	LocoParams params;
+	unsigned sample_interval = 100; // ms
+
+	// Recorded calibration
+	unsigned runs = 0;
+	bool done = false;
+	double time = 0; // s
+	unsigned iterations = 0; // CalibStep set power & measure cycles
+	unsigned measures = 0; // CalibStep & CalibOverview speed measures
+};
+
+// Loads a trace file or all *.jsonl files in a directory, throws QStrException
+std::vector<Recording> loadRecordings(const QString &path);
+
+} // namespace Sim
+
+#endif
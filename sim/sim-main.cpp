@@ -0,0 +1,231 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+#include "calib-config.h"
+#include "calib-man.h"
+#include "clock.h"
+#include "loco-model.h"
+#include "recording.h"
+#include "power-map.h"
+#include "settings.h"
+#include "speed-map.h"
+
+/* Simulator: calibrates synthetic locos (or locos fitted to recorded traces,
+   see recording.h) on virtual time and prints results. Use it to benchmark
+   and tune the calibration algorithms, see sim.pro. */
+
+struct SimResult {
+	bool done = false;
+	bool finished = false;
+	QString error;
+	double virtual_time = 0; // s
+	unsigned xn_commands = 0;
+	unsigned pom_sent = 0;
+	Mt::Counters counters;
+	double mean_error = 0; // km/h
+	double max_error = 0; // km/h
+};
+
+struct SimOptions {
+	Settings *settings = nullptr;
+	double error_rate = 0;
+	qint64 time_limit = 0; // ms
+};
+
+static SimResult simulate(const Sim::LocoParams &params, const unsigned seed,
+                          const unsigned sample_interval, Ssm::StepsToSpeedMap &ssm,
+                          const SimOptions &options) {
+	SimResult result;
+	Vc::VirtualClock clock;
+	Vc::setVirtualClock(&clock);
+
+	{
+		Sim::Loco loco(params, seed);
+		Xn::XpressNet xn;
+		xn.loco = &loco;
+		xn.error_rate = options.error_rate;
+		Wsm::Wsm wsm;
+		wsm.loco = &loco;
+		wsm.sample_interval = sample_interval;
+		Pm::PowerToSpeedMap pm;
+		Cm::CalibMan cm(xn, pm, wsm, ssm);
+		if (options.settings != nullptr)
+			Cc::applyCalib(*options.settings, cm);
+
+		QObject::connect(&cm, &Cm::CalibMan::onDone, [&result]() {
+			result.done = true;
+			result.finished = true;
+		});
+		QObject::connect(&cm, &Cm::CalibMan::onError,
+		                 [&result](Cm::CmError error, unsigned step, const QString &) {
+			result.error = Cm::errorStr(error) + " (step " + QString::number(step) + ")";
+			result.finished = true;
+		});
+
+		wsm.connect("sim");
+		cm.calibrateAll(3, Xn::Direction::Forward);
+		while (!result.finished && clock.now() < options.time_limit && clock.step());
+
+		if (!result.finished) {
+			result.error = "Timeout";
+			cm.stop();
+		}
+		wsm.disconnect();
+
+		result.virtual_time = clock.now() / 1000.0;
+		result.xn_commands = xn.commands();
+		result.pom_sent = cm.pom.sent();
+		result.counters = cm.metrics.total;
+
+		if (result.done) {
+			unsigned count = 0;
+			for (unsigned step = 1; step <= Xn::_STEPS_CNT; step++) {
+				if (ssm[step-1] == nullptr)
+					continue;
+				const double error = std::abs(loco.steadySpeed(loco.power(step)) - *ssm[step-1]);
+				result.mean_error += error;
+				result.max_error = std::max(result.max_error, error);
+				count++;
+			}
+			if (count > 0)
+				result.mean_error /= count;
+		}
+	}
+
+	Vc::setVirtualClock(nullptr);
+	return result;
+}
+
+static void printResult(QTextStream &out, const SimResult &r) {
+	out << (r.done ? QString("ok") : r.error) << ";" << QString::number(r.virtual_time, 'f', 1)
+	    << ";" << r.xn_commands << ";" << r.pom_sent << ";" << r.counters.iterations << ";"
+	    << r.counters.measures << ";" << r.counters.measure_repeats << ";"
+	    << QString::number(r.mean_error, 'f', 2) << ";" << QString::number(r.max_error, 'f', 2);
+}
+
+int main(int argc, char *argv[]) {
+	QCoreApplication a(argc, argv);
+	QCoreApplication::setApplicationName("auto-calib-sim");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Calibration of simulated locos on virtual time.");
+	parser.addHelpOption();
+	parser.addOptions({
+		{{"n", "locos"}, "Number of synthetic locos (default 100).", "count", "100"},
+		{"seed", "Seed of the first loco (default 1).", "seed", "1"},
+		{{"r", "replay"}, "Replay locos from trace file or directory of *.jsonl traces "
+		                  "instead of synthetic locos.", "path"},
+		{{"s", "speed"}, "Steps-to-speed csv file (default speed.csv).", "file", "speed.csv"},
+		{{"c", "config"}, "Config file with [Calibration] section to use.", "file"},
+		{"error-rate", "Ratio of failing POM commands (default 0).", "ratio", "0"},
+		{"time-limit", "Virtual time limit per loco in minutes (default 120).", "min", "120"},
+	});
+	parser.process(a);
+
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+
+	Ssm::StepsToSpeedMap ssm;
+	try {
+		ssm.load(parser.value("speed"));
+	} catch (const std::exception &) {
+		err << "Unable to load steps-to-speed file " << parser.value("speed") << "!" << Qt::endl;
+		return 1;
+	}
+	ssm.setMaxSpeed(ssm.maxSpeedInFile());
+
+	std::unique_ptr<Settings> settings;
+	if (parser.isSet("config")) {
+		settings = std::make_unique<Settings>();
+		settings->load(parser.value("config"));
+	}
+
+	SimOptions options;
+	options.settings = settings.get();
+	options.error_rate = parser.value("error-rate").toDouble();
+	options.time_limit = parser.value("time-limit").toLongLong() * 60 * 1000;
+
+	std::vector<Sim::Recording> recordings;
+	if (parser.isSet("replay")) {
+		try {
+			recordings = Sim::loadRecordings(parser.value("replay"));
+		} catch (const QStrException &e) {
+			err << e.str() << Qt::endl;
+			return 1;
+		}
+	}
+
+	const bool replay = parser.isSet("replay");
+	const unsigned count = replay ? recordings.size() : parser.value("locos").toUInt();
+	const unsigned first_seed = parser.value("seed").toUInt();
+
+	unsigned done = 0;
+	double virtual_total = 0, mean_error_total = 0, max_error = 0;
+	unsigned long long pom_total = 0, iterations_total = 0;
+	double rec_time_total = 0;
+	unsigned long long rec_iterations_total = 0;
+	QElapsedTimer wall;
+	wall.start();
+
+	out << (replay ? "recording" : "seed") << ";result;virtual_s;xn_commands;pom_sent;iterations;"
+	       "measures;measure_repeats;mean_err_kmph;max_err_kmph";
+	if (replay)
+		out << ";rec_result;rec_s;rec_iterations;rec_measures";
+	out << Qt::endl;
+
+	for (unsigned i = 0; i < count; i++) {
+		const unsigned seed = first_seed + i;
+		SimResult r;
+		if (replay) {
+			const Sim::Recording &rec = recordings[i];
+			r = simulate(rec.params, seed, rec.sample_interval, ssm, options);
+			out << rec.name << ";";
+			printResult(out, r);
+			out << ";" << (rec.done ? "ok" : "failed") << ";" << QString::number(rec.time, 'f', 1)
+			    << ";" << rec.iterations << ";" << rec.measures << Qt::endl;
+			rec_time_total += rec.time;
+			rec_iterations_total += rec.iterations;
+		} else {
+			std::mt19937 gen(seed);
+			r = simulate(Sim::LocoParams::random(gen), seed, Wsm::DEFAULT_SAMPLE_INTERVAL, ssm,
+			             options);
+			out << seed << ";";
+			printResult(out, r);
+			out << Qt::endl;
+		}
+
+		virtual_total += r.virtual_time;
+		pom_total += r.pom_sent;
+		iterations_total += r.counters.iterations;
+		if (r.done) {
+			done++;
+			mean_error_total += r.mean_error;
+			max_error = std::max(max_error, r.max_error);
+		}
+	}
+
+	err << "Locos: " << count << ", calibrated: " << done << Qt::endl;
+	if (count > 0) {
+		err << "Mean virtual time: " << QString::number(virtual_total / count, 'f', 1) << " s, "
+		    << "mean POM writes: " << QString::number(static_cast<double>(pom_total) / count, 'f', 1)
+		    << ", mean iterations: "
+		    << QString::number(static_cast<double>(iterations_total) / count, 'f', 1) << Qt::endl;
+	}
+	if (replay && count > 0) {
+		err << "Recorded: mean time " << QString::number(rec_time_total / count, 'f', 1)
+		    << " s, mean iterations: "
+		    << QString::number(static_cast<double>(rec_iterations_total) / count, 'f', 1)
+		    << Qt::endl;
+	}
+	if (done > 0) {
+		err << "Mean speed error: " << QString::number(mean_error_total / done, 'f', 2)
+		    << " km/h, max: " << QString::number(max_error, 'f', 2) << " km/h" << Qt::endl;
+	}
+	err << "Wall time: " << wall.elapsed() << " ms" << Qt::endl;
+
+	return (done == count) ? 0 : 2;
+}
@@ -0,0 +1,286 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <algorithm>
+
+#include "batch-queue.h"
+#include "clock.h"
+
+namespace Bq {
+
+std::vector<Job> loadManifest(const QString &filename) {
+	QFile file(filename);
+	if (!file.open(QFile::ReadOnly | QFile::Text))
+		throw EManifest("Cannot read file " + filename);
+
+	const QDir dir(QFileInfo(filename).absolutePath());
+	std::vector<Job> jobs;
+	QTextStream in(&file);
+	unsigned lineno = 0;
+
+	while (!in.atEnd()) {
+		const QString line = in.readLine().trimmed();
+		lineno++;
+		if (line.isEmpty() || line.startsWith("#"))
+			continue;
+
+		const QStringList parts = line.split(';');
+		const QString where = filename + ":" + QString::number(lineno) + ": ";
+		if (parts.size() < 4)
+			throw EManifest(where + "expected <addr>;<direction>;<speed csv>;<output xml>[;swap][;reset]");
+
+		Job job;
+		bool ok;
+		job.addr = parts[0].trimmed().toUInt(&ok);
+		if (!ok || job.addr == 0 || job.addr > 9999)
+			throw EManifest(where + "invalid loco address " + parts[0]);
+
+		const QString direction = parts[1].trimmed().toLower();
+		if (direction == "forward")
+			job.direction = Xn::Direction::Forward;
+		else if (direction == "backward")
+			job.direction = Xn::Direction::Backward;
+		else
+			throw EManifest(where + "invalid direction " + parts[1]);
+
+		job.speed_file = dir.filePath(parts[2].trimmed());
+		job.output = dir.filePath(parts[3].trimmed());
+		for (const QString &part : parts.mid(4)) {
+			const QString flag = part.trimmed().toLower();
+			if (flag == "swap")
+				job.swap = true;
+			else if (flag == "reset")
+				job.reset = true;
+			else if (!flag.isEmpty())
+				throw EManifest(where + "unknown flag " + part);
+		}
+		jobs.push_back(job);
+	}
+
+	return jobs;
+}
+
+Lf::LocoInfo locoInfo(const unsigned addr, const Cm::CalibMan &cm, const Ssm::StepsToSpeedMap &ssm) {
+	Lf::LocoInfo info;
+	info.addr = addr;
+	info.max_speed = ssm.maxSpeed();
+
+	auto cv = cm.init_cvs.find(CV_ACCEL);
+	if (cv != cm.init_cvs.end())
+		info.accel = cv->second;
+	cv = cm.init_cvs.find(CV_DECEL);
+	if (cv != cm.init_cvs.end())
+		info.decel = cv->second;
+	cv = cm.init_cvs.find(CV_VMAX);
+	if (cv != cm.init_cvs.end())
+		info.vmax = cv->second;
+
+	for (unsigned step = 1; step <= Xn::_STEPS_CNT; step++)
+		info.steps[step-1] = cm.stepPower(step);
+	return info;
+}
+
+BatchQueue::BatchQueue(Cm::CalibMan &cm, Pm::PowerToSpeedMap &pm, Ssm::StepsToSpeedMap &ssm,
+                       QObject *parent)
+    : QObject(parent), m_cm(cm), m_pm(pm), m_ssm(ssm) {}
+
+QString BatchQueue::jobName(const size_t index) const {
+	return "Job " + QString::number(index+1) + "/" + QString::number(jobs.size()) + " (loco " +
+	       QString::number(jobs[index].addr) + ")";
+}
+
+void BatchQueue::log(const QString &message, const Cm::LogLevel level) {
+	emit onLog(message, level);
+}
+
+void BatchQueue::start() {
+	if (m_running || m_cm.inProgress())
+		return;
+
+	for (Job &job : jobs) {
+		job.state = JobState::Waiting;
+		job.note = "";
+	}
+
+	QObject::connect(&m_cm, SIGNAL(onDone()), this, SLOT(cm_done()));
+	QObject::connect(&m_cm, SIGNAL(onError(Cm::CmError,uint,const QString&)),
+	                 this, SLOT(cm_error(Cm::CmError,uint,const QString&)));
+
+	m_running = true;
+	m_paused = false;
+	m_current = 0;
+
+	if (!jobs.empty() && jobs[0].swap) {
+		m_paused = true;
+		emit onSwapNeeded(0);
+	} else {
+		run();
+	}
+}
+
+void BatchQueue::stop() {
+	if (!m_running)
+		return;
+	if (m_cm.inProgress()) {
+		jobs[m_current].state = JobState::Failed;
+		jobs[m_current].note = "Interrupted";
+		m_cm.stop();
+	}
+	log("Batch interrupted!", Cm::LogLevel::Warning);
+	finish();
+}
+
+void BatchQueue::resume() {
+	if (!m_running || !m_paused)
+		return;
+	m_paused = false;
+	run();
+}
+
+bool BatchQueue::inProgress() const { return m_running; }
+bool BatchQueue::paused() const { return m_paused; }
+size_t BatchQueue::current() const { return m_current; }
+
+unsigned BatchQueue::done() const {
+	return std::count_if(jobs.begin(), jobs.end(),
+	                     [](const Job &job) { return job.state == JobState::Done; });
+}
+
+unsigned BatchQueue::failed() const {
+	return std::count_if(jobs.begin(), jobs.end(),
+	                     [](const Job &job) { return job.state == JobState::Failed; });
+}
+
+void BatchQueue::run() {
+	if (m_current >= jobs.size())
+		return finish();
+
+	Job &job = jobs[m_current];
+	job.state = JobState::Running;
+	emit onJobStart(m_current);
+	log(jobName(m_current) + " started");
+
+	m_pm.clear();
+	m_cm.reset();
+	m_ssm.clear();
+	try {
+		m_ssm.load(job.speed_file);
+	} catch (const std::exception &e) {
+		return jobFinished(false, "Unable to load speed profile " + job.speed_file);
+	}
+	m_ssm.setMaxSpeed(max_speed > 0 ? max_speed : m_ssm.maxSpeedInFile());
+
+	if ((job.swap || job.reset) && m_cm.pom.image != nullptr) {
+		// Another decoder (or reset one) -> nothing is known about it
+		m_cm.pom.image->forget(job.addr);
+		log(jobName(m_current) + ": decoder image forgotten");
+	}
+
+	try {
+		m_cm.calibrateAll(job.addr, job.direction);
+	} catch (const QStrException &e) {
+		startFailed(e.str());
+	} catch (const Xn::QStrException &e) {
+		startFailed(e.str());
+	}
+}
+
+void BatchQueue::startFailed(const QString &note) {
+	if (m_cm.inProgress()) {
+		try {
+			m_cm.stop();
+		} catch (...) {} // XpressNET is probably broken anyway
+	}
+	saveMetrics();
+	jobFinished(false, "Unable to start calibration: " + note);
+}
+
+void BatchQueue::next() {
+	if (!m_running)
+		return;
+
+	m_current++;
+	if (m_current >= jobs.size())
+		return finish();
+
+	if (jobs[m_current].swap) {
+		m_paused = true;
+		log(jobName(m_current) + ": waiting for loco swap");
+		emit onSwapNeeded(m_current);
+		return;
+	}
+
+	run();
+}
+
+void BatchQueue::cm_done() {
+	if (!m_running || m_paused)
+		return;
+
+	const Job &job = jobs[m_current];
+	try {
+		Lf::save(job.output, locoInfo(job.addr, m_cm, m_ssm), m_pm);
+	} catch (const Lf::EFileError &e) {
+		return jobFinished(false, e.str());
+	}
+	saveMetrics();
+	log(jobName(m_current) + ": saved " + job.output, Cm::LogLevel::Success);
+	jobFinished(true);
+}
+
+void BatchQueue::cm_error(Cm::CmError error, unsigned step, const QString &note) {
+	if (!m_running || m_paused)
+		return;
+
+	QString message = Cm::errorStr(error);
+	if (step > 0)
+		message += " (step " + QString::number(step) + ")";
+	if (!note.isEmpty())
+		message += " " + note;
+	saveMetrics();
+	jobFinished(false, message);
+}
+
+void BatchQueue::saveMetrics() {
+	// Metrics are saved for failed jobs too to spot problematic decoders
+	const QString &output = jobs[m_current].output;
+	try {
+		m_cm.metrics.saveJson(Mt::CalibMetrics::filename(output, "json"));
+		m_cm.metrics.saveCsv(Mt::CalibMetrics::filename(output, "csv"));
+	} catch (const QStrException &e) {
+		log(e.str(), Cm::LogLevel::Warning);
+	}
+}
+
+void BatchQueue::jobFinished(const bool ok, const QString &note) {
+	Job &job = jobs[m_current];
+	job.state = ok ? JobState::Done : JobState::Failed;
+	job.note = note;
+	if (!ok)
+		log(jobName(m_current) + " failed: " + note, Cm::LogLevel::Error);
+	emit onJobDone(m_current, ok);
+
+	if (!ok && stop_on_error)
+		return finish();
+
+	// Calibration manager is still emitting its event -> continue later
+	Vc::singleShot(0, [this]() { next(); });
+}
+
+void BatchQueue::finish() {
+	if (!m_running)
+		return;
+	m_running = false;
+	m_paused = false;
+
+	QObject::disconnect(&m_cm, SIGNAL(onDone()), this, SLOT(cm_done()));
+	QObject::disconnect(&m_cm, SIGNAL(onError(Cm::CmError,uint,const QString&)),
+	                    this, SLOT(cm_error(Cm::CmError,uint,const QString&)));
+
+	log("Batch finished: " + QString::number(done()) + " done, " + QString::number(failed()) +
+	    " failed", failed() > 0 ? Cm::LogLevel::Warning : Cm::LogLevel::Success);
+	emit onFinished(done(), failed());
+}
+
+} // namespace Bq
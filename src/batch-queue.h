@@ -0,0 +1,116 @@
+#ifndef BATCH_QUEUE_H
+#define BATCH_QUEUE_H
+
+/*
+This file defines a BatchQueue class which calibrates multiple locos back to
+back on a single calibration manager (single test track) without operator.
+
+ * Jobs are read from a manifest file, one job per line:
+     <addr>;<forward|backward>;<speed profile csv>;<output xml>[;swap][;reset]
+   Empty lines and lines starting with '#' are ignored. Relative paths are
+   relative to the manifest file.
+ * For each job, measured data are erased, speed profile is loaded, loco is
+   calibrated and loco file is saved (loco-file.h). Calibration metrics
+   (calib-metrics.h) are saved next to the loco file, also for failed jobs.
+ * Decoder image (decoder-image.h) of the address is forgotten before a job
+   with 'swap' (a swapped loco often has the same address as the previous
+   one) or 'reset' (decoder was reset) flag. Otherwise writes known from
+   a previous (e.g. interrupted) run are skipped.
+ * When a job fails (including calibration which could not be started, e.g.
+   XpressNET disconnected), queue continues with the next job (unless
+   stop_on_error is set).
+ * When a job has 'swap' flag, the queue pauses before the job (onSwapNeeded)
+   so the operator could put the loco on the track. Call resume() to continue.
+ * At the end, onFinished is always called.
+*/
+
+#include <QObject>
+#include <vector>
+
+#include "calib-man.h"
+#include "lib/q-str-exception.h"
+#include "loco-file.h"
+#include "power-map.h"
+#include "speed-map.h"
+
+namespace Bq {
+
+struct EManifest : public QStrException {
+	EManifest(const QString str) : QStrException(str) {}
+};
+
+enum class JobState {
+	Waiting,
+	Running,
+	Done,
+	Failed,
+};
+
+struct Job {
+	unsigned addr;
+	Xn::Direction direction = Xn::Direction::Forward;
+	QString speed_file;
+	QString output;
+	bool swap = false; // pause before the job to let operator swap locos
+	bool reset = false; // decoder was reset, its image is not valid
+	JobState state = JobState::Waiting;
+	QString note; // reason of failure
+};
+
+std::vector<Job> loadManifest(const QString &filename); // throws EManifest
+
+Lf::LocoInfo locoInfo(unsigned addr, const Cm::CalibMan &, const Ssm::StepsToSpeedMap &);
+
+class BatchQueue : public QObject {
+	Q_OBJECT
+
+public:
+	std::vector<Job> jobs;
+	unsigned max_speed = 0; // 0 = use max speed from speed profile
+	bool stop_on_error = false;
+
+	BatchQueue(Cm::CalibMan &, Pm::PowerToSpeedMap &, Ssm::StepsToSpeedMap &,
+	           QObject *parent = nullptr);
+
+	void start();
+	void stop();
+	void resume(); // continue after onSwapNeeded
+	bool inProgress() const;
+	bool paused() const;
+	size_t current() const; // index of the running (or paused) job
+
+	unsigned done() const;
+	unsigned failed() const;
+
+private:
+	Cm::CalibMan &m_cm;
+	Pm::PowerToSpeedMap &m_pm;
+	Ssm::StepsToSpeedMap &m_ssm;
+	size_t m_current = 0;
+	bool m_running = false;
+	bool m_paused = false;
+
+	void next();
+	void run();
+	void startFailed(const QString &note);
+	void jobFinished(bool ok, const QString &note = "");
+	void saveMetrics();
+	void finish();
+	void log(const QString &, Cm::LogLevel = Cm::LogLevel::Info);
+	QString jobName(size_t) const;
+
+private slots:
+	void cm_done();
+	void cm_error(Cm::CmError, unsigned step, const QString &note);
+
+signals:
+	void onJobStart(size_t job);
+	void onJobDone(size_t job, bool ok);
+	void onSwapNeeded(size_t job);
+	void onFinished(unsigned done, unsigned failed);
+	void onLog(const QString &, Cm::LogLevel);
+};
+
+} // namespace Bq
+
+#endif
@@ -0,0 +1,99 @@
+#include "calib-config.h"
+
+namespace Cc {
+
+void applyXn(Settings &s, Xn::XpressNet &xn) {
+	bool ok;
+	Xn::XNConfig xn_config;
+	xn_config.outInterval = s["XN"]["outIntervalMs"].toUInt(&ok);
+	if (!ok)
+		throw QStrException("unable to parse outIntervalMs");
+	xn.setConfig(xn_config);
+}
+
+void connectXn(Settings &s, Xn::XpressNet &xn) {
+	xn.connect(s["XN"]["port"].toString(), s["XN"]["baudrate"].toInt(),
+	           static_cast<QSerialPort::FlowControl>(s["XN"]["flowcontrol"].toInt()),
+	           Xn::liInterface(s["XN"]["interface"].toString()));
+}
+
+void applyWsm(std::map<QString, QVariant> &cfg, Wsm::Wsm &wsm) {
+	wsm.scale = cfg["scale"].toInt();
+	wsm.wheelDiameter = cfg["wheelDiameter"].toDouble();
+	wsm.ticksPerRevolution = cfg["ticksPerRevolution"].toDouble();
+}
+
+void applyDecoderImage(Settings &s, Di::DecoderImage &di) {
+	di.open(s["DecoderImage"]["file"].toString());
+	di.skip_known = s["DecoderImage"]["skipKnown"].toBool();
+	di.max_age = s["DecoderImage"]["maxAgeHours"].toUInt();
+}
+
+Ls::Options logOptions(Settings &s) {
+	Ls::Options options;
+	options.max_size = static_cast<qint64>(s["Logging"]["maxSizeKb"].toUInt()) * 1024;
+	options.rotate_count = s["Logging"]["rotateCount"].toUInt();
+	options.memory_budget = static_cast<size_t>(s["Logging"]["memoryKb"].toUInt()) * 1024;
+	return options;
+}
+
+void applyTrace(Settings &s, Tr::Trace &trace) {
+	const QString filename = s["Trace"]["file"].toString();
+	if (filename.isEmpty())
+		trace.close();
+	else if (!trace.enabled() || trace.filename() != filename)
+		trace.open(filename);
+}
+
+void applyCalib(Settings &s, Cm::CalibMan &man) {
+	auto& calcfg = s["Calibration"];
+
+	Settings::cfgToDouble(calcfg, "absDeviation", man.cs.abs_deviation);
+	Settings::cfgToDouble(calcfg, "relDeviation", man.cs.rel_deviation);
+	Settings::cfgToDouble(calcfg, "maxAbsDiffusion", man.cs.max_abs_diffusion);
+	Settings::cfgToDouble(calcfg, "maxAbsDiffusion", man.co.max_abs_diffusion);
+	Settings::cfgToDouble(calcfg, "maxRelDiffusion", man.cs.max_rel_diffusion);
+	Settings::cfgToDouble(calcfg, "maxRelDiffusion", man.co.max_rel_diffusion);
+	Settings::cfgToUnsigned(calcfg, "measureCount", man.cs.measure_count);
+	Settings::cfgToUnsigned(calcfg, "measureCount", man.co.measure_count);
+	Settings::cfgToUnsigned(calcfg, "measureRevolutions", man.cs.measure_revolutions);
+	Settings::cfgToUnsigned(calcfg, "measureRevolutions", man.co.measure_revolutions);
+	unsigned trackLength = man.track.track_length;
+	Settings::cfgToUnsigned(calcfg, "trackLength", trackLength);
+	man.track.track_length = trackLength;
+	unsigned trackMark = man.track.mark;
+	Settings::cfgToUnsigned(calcfg, "trackMark", trackMark);
+	man.track.mark = trackMark;
+	Settings::cfgToUnsigned(calcfg, "markTimeout", man.cs.mark_timeout);
+	Settings::cfgToUnsigned(calcfg, "markTimeout", man.co.mark_timeout);
+	Settings::cfgToUnsigned(calcfg, "measureLaps", man.cs.measure_laps);
+	Settings::cfgToUnsigned(calcfg, "measureLaps", man.co.measure_laps);
+	Settings::cfgToUnsigned(calcfg, "earlyStopMin", man.cs.early_stop_min);
+	Settings::cfgToDouble(calcfg, "earlyStopZ", man.cs.early_stop_z);
+	Settings::cfgToUnsigned(calcfg, "spAdaptTimeout", man.cs.sp_adapt_timeout);
+	Settings::cfgToUnsigned(calcfg, "spAdaptTimeout", man.co.sp_adapt_timeout);
+	Settings::cfgToUnsigned(calcfg, "settleWindow", man.cs.settle_window);
+	Settings::cfgToDouble(calcfg, "settleMaxSlope", man.cs.settle_max_slope);
+	QString speedEstimator = (man.cs.speed_estimator == Se::Method::Distance) ? "distance" : "samples";
+	Settings::cfgToQString(calcfg, "speedEstimator", speedEstimator);
+	man.cs.speed_estimator = (speedEstimator == "distance") ? Se::Method::Distance : Se::Method::Samples;
+	man.co.speed_estimator = man.cs.speed_estimator;
+	Settings::cfgToUnsigned(calcfg, "overviewStep", man.co.overview_step);
+	Settings::cfgToUnsigned(calcfg, "overviewStart", man.co.overview_start);
+	Settings::cfgToUnsigned(calcfg, "overviewMinSpeed", man.co.min_speed);
+	QString overviewMode = (man.co.mode == Co::Mode::Ramp) ? "ramp" : "steps";
+	Settings::cfgToQString(calcfg, "overviewMode", overviewMode);
+	man.co.mode = (overviewMode == "ramp") ? Co::Mode::Ramp : Co::Mode::Steps;
+	Settings::cfgToUnsigned(calcfg, "rampIncrement", man.co.ramp_increment);
+	Settings::cfgToUnsigned(calcfg, "rampInterval", man.co.ramp_interval);
+	Settings::cfgToUnsigned(calcfg, "rampLag", man.co.ramp_lag);
+	Settings::cfgToUnsigned(calcfg, "rampMinSamples", man.co.ramp_min_samples);
+	QString stepOrder = (man.step_order == Cm::StepOrder::Planned) ? "planned" : "bisection";
+	Settings::cfgToQString(calcfg, "stepOrder", stepOrder);
+	man.step_order = (stepOrder == "bisection") ? Cm::StepOrder::Bisection : Cm::StepOrder::Planned;
+	Settings::cfgToUnsigned(calcfg, "stepAnchors", man.step_anchors);
+	Settings::cfgToDouble(calcfg, "transitionBase", man.transition_cost.base);
+	Settings::cfgToDouble(calcfg, "transitionPerKmph", man.transition_cost.per_kmph);
+}
+
+} // namespace Cc
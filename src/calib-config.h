@@ -0,0 +1,33 @@
+#ifndef CALIB_CONFIG_H
+#define CALIB_CONFIG_H
+
+/*
+This file defines functions which apply loaded configuration (settings.h) to
+the calibration core objects. They are shared by GUI and command-line
+runner, so both behave the same with the same config file.
+
+Missing config values are filled with current values of the objects (=
+defaults), so saved config file contains all the options.
+*/
+
+#include "calib-man.h"
+#include "decoder-image.h"
+#include "log-sink.h"
+#include "lib/wsm/wsm.h"
+#include "lib/xn/xn.h"
+#include "settings.h"
+#include "trace.h"
+
+namespace Cc {
+
+void applyXn(Settings &, Xn::XpressNet &); // throws QStrException, Xn::QStrException
+void connectXn(Settings &, Xn::XpressNet &); // throws Xn::QStrException
+void applyWsm(std::map<QString, QVariant> &cfg, Wsm::Wsm &);
+void applyDecoderImage(Settings &, Di::DecoderImage &);
+void applyTrace(Settings &, Tr::Trace &); // throws QStrException
+Ls::Options logOptions(Settings &);
+void applyCalib(Settings &, Cm::CalibMan &);
+
+} // namespace Cc
+
+#endif
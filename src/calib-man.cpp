@@ -7,12 +7,17 @@ namespace Cm {
 CalibMan::CalibMan(Xn::XpressNet &xn, Pm::PowerToSpeedMap &pm, Wsm::Wsm &wsm,
                    Ssm::StepsToSpeedMap &ssm, QObject *parent)
     : QObject(parent),
-      cs(xn, pm, wsm,
+      samples(wsm),
+      pom(xn),
+      cs(pom, pm, wsm, samples,
           {[this](unsigned a, unsigned b) { return this->csNeighbourPower(a, b); }},
-          {[this](unsigned step) { return this->power[step-1]; }}),
-      co(xn, pm, wsm, ssm.maxSpeed()),
-      m_ssm(ssm),
-      m_xn(xn) {
+          {[this](unsigned step) { return this->power[step-1]; }},
+          {[this](unsigned step) { return this->csPowerBounds(step); }}),
+      co(pom, pm, samples, ssm.maxSpeed()),
+      m_ssm(ssm) {
+	QObject::connect(&samples, SIGNAL(sampleAdded(quint64)), this, SLOT(samplesAdded(quint64)));
+	cs.track = &track;
+	co.track = &track;
 	reset();
 }
 
@@ -21,21 +26,68 @@ void CalibMan::reset() {
 		s = StepState::Uncalibred;
 	for (auto &s : power)
 		s = 0;
+	metrics.reset();
 }
 
 bool CalibMan::inProgress() const { return m_progress != CalibState::Stopped; }
 
 CalibState CalibMan::progress() const { return m_progress; }
 
+unsigned CalibMan::stepPower(unsigned step) const { return power[step-1]; }
+
+void CalibMan::setTrace(Tr::Trace *trace) {
+	m_trace = trace;
+	pom.trace = trace;
+	cs.trace = trace;
+	co.trace = trace;
+}
+
+void CalibMan::record(const char *event, std::initializer_list<Tr::Field> fields) const {
+	if (m_trace == nullptr || !m_trace->enabled())
+		return;
+	std::vector<Tr::Field> all {{"loco", m_locoAddr}};
+	all.insert(all.end(), fields.begin(), fields.end());
+	m_trace->record("cm", event, all);
+}
+
+void CalibMan::samplesAdded(const quint64 seq) {
+	if (m_trace == nullptr || m_progress == CalibState::Stopped)
+		return; // samples are interesting only during calibration
+	Sb::Sample sample;
+	if (!samples.read(seq, sample))
+		return;
+	m_trace->record("wsm", "speed", {{"loco", m_locoAddr}, {"speed", sample.speed},
+	                                 {"raw", static_cast<unsigned>(sample.speed_raw)},
+	                                 {"dist_raw", sample.dist_raw}});
+}
+
 void CalibMan::done() {
 	updateProg(CalibState::Stopped, 1, 1);
+	metrics.runEnd(true, pomCounters());
+	record("done", {{"pom_sent", pom.sent()}});
+	if (m_trace != nullptr)
+		m_trace->flush();
 	log("Calibration done :)", LogLevel::Success);
+	log("POM writes: " + QString::number(pom.sent()) + " sent, " +
+	    QString::number(pom.merged()) + " merged, " + QString::number(pom.dropped()) +
+	    " dropped, " + QString::number(pom.skipped()) + " skipped (known)", LogLevel::Info);
+	if (pom.image != nullptr)
+		pom.image->sync();
 	emit onDone();
 }
 
 void CalibMan::error(const Cm::CmError e, const unsigned step, const QString &note) {
+	metrics.error(errorName(e));
+	if (m_step_measuring.has_value())
+		metricsStepEnd(0, false);
 	updateProg(CalibState::Stopped, 0, 1);
+	metrics.runEnd(false, pomCounters());
+	record("error", {{"error", errorName(e)}, {"step", step}, {"note", note}});
+	if (m_trace != nullptr)
+		m_trace->flush();
 	log("Step " + QString::number(step) + " calibration error!", LogLevel::Error);
+	if (pom.image != nullptr)
+		pom.image->sync();
 	emit onError(e, step, note);
 }
 
@@ -43,11 +95,34 @@ void CalibMan::log(const QString &message, LogLevel level) {
 	emit onLog(message, level);
 }
 
+static QString phaseName(const CalibState cs) {
+	switch (cs) {
+		case CalibState::InitProg: return "InitProg";
+		case CalibState::Overview: return "Overview";
+		case CalibState::Steps: return "Steps";
+		case CalibState::Interpolation: return "Interpolation";
+		default: return "";
+	}
+}
+
 void CalibMan::updateProg(const CalibState cs, const size_t progress, const size_t max) {
+	if (cs != m_progress) {
+		metrics.phaseStart(phaseName(cs), pomCounters());
+		record("phase", {{"phase", (cs == CalibState::Stopped) ? "Stopped" : phaseName(cs)}});
+	}
 	m_progress = cs;
 	emit onProgressUpdate(getProgress(cs, progress, max));
 }
 
+Mt::PomCounters CalibMan::pomCounters() const {
+	return {pom.sent(), pom.merged(), pom.dropped(), pom.skipped()};
+}
+
+void CalibMan::metricsStepEnd(const unsigned power, const bool done) {
+	metrics.stepEnd(m_step_measuring.value(), power, done, cs.stats(), pomCounters());
+	m_step_measuring.reset();
+}
+
 size_t CalibMan::getProgress(const CalibState cs, const size_t progress, const size_t max) {
 	if (cs == CalibState::InitProg) // 0-10
 		return 10 * progress / max;
@@ -78,6 +153,8 @@ void CalibMan::stepDone(unsigned step, unsigned power) {
 // Calibration Step events:
 
 void CalibMan::csDone(unsigned step, unsigned power) {
+	metricsStepEnd(power, true);
+	record("step_done", {{"step", step}, {"power", power}});
 	this->stepDone(step, power);
 	step = step - 1; // convert step to step index
 	state[step] = StepState::Calibred;
@@ -89,7 +166,7 @@ void CalibMan::csDone(unsigned step, unsigned power) {
 		    state[i] == StepState::Uncalibred) {
 			m_step_writing = i;
 			m_step_power = power;
-			m_xn.pomWriteCv(
+			pom.pomWriteCv(
 				Xn::LocoAddr(m_locoAddr),
 				CV_CURVE_START + i,
 				power,
@@ -105,7 +182,7 @@ void CalibMan::csDone(unsigned step, unsigned power) {
 }
 
 void CalibMan::csError(Cs::CsError cs, unsigned step) {
-	m_xn.setSpeed(Xn::LocoAddr(m_locoAddr), 0, direction);
+	pom.setSpeed(Xn::LocoAddr(m_locoAddr), 0, direction);
 	csSigDisconnect();
 
 	if (cs == Cs::CsError::LargeDiffusion)
@@ -123,19 +200,25 @@ void CalibMan::csError(Cs::CsError cs, unsigned step) {
 }
 
 void CalibMan::coError(Co::Error co, unsigned step) {
-	m_xn.setSpeed(Xn::LocoAddr(m_locoAddr), 0, direction);
+	pom.setSpeed(Xn::LocoAddr(m_locoAddr), 0, direction);
 	csSigDisconnect();
 
 	if (co == Co::Error::LargeDiffusion)
 		error(CmError::LargeDiffusion, step);
 	else if (co == Co::Error::XnNoResponse)
 		error(CmError::XnNoResponse, step);
+	else if (co == Co::Error::WsmError)
+		error(CmError::WsmError, step);
 }
 
 void CalibMan::cStepPowerChanged(unsigned step, unsigned power) {
 	this->changeStepPower(step, power);
 }
 
+void CalibMan::cPowerTried(unsigned step, unsigned power) {
+	emit onPowerTried(step, power, m_progress);
+}
+
 void CalibMan::xnStepWritten(void *, void *) {
 	state[m_step_writing] = StepState::Calibred;
 	this->stepDone(m_step_writing+1, m_step_power);
@@ -144,7 +227,7 @@ void CalibMan::xnStepWritten(void *, void *) {
 		if (nullptr != m_ssm[i] && *(m_ssm[i]) == *(m_ssm[m_step_writing]) &&
 			state[i] == StepState::Uncalibred) {
 			m_step_writing = i;
-			m_xn.pomWriteCv(
+			pom.pomWriteCv(
 				Xn::LocoAddr(m_locoAddr),
 				CV_CURVE_START + i,
 				m_step_power,
@@ -165,6 +248,7 @@ void CalibMan::coDone() {
 	// Phase 2: move from phase "Getting basic data" to phase "Calibration"
 	log("Overview finished.", LogLevel::Success);
 	updateProg(CalibState::Steps, 0, 1);
+	planSteps();
 	calibrateNextStep();
 }
 
@@ -175,50 +259,58 @@ void CalibMan::coProgressUpdate(size_t progress, size_t max) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-std::unique_ptr<unsigned> CalibMan::nextStep() {
-	std::vector<unsigned> used_steps; // map of indexes of steps
+std::vector<Sp::Target> CalibMan::usedSteps() const {
+	std::vector<Sp::Target> used_steps;
 	int last = -1;
 	for (size_t i = 0; i < Xn::_STEPS_CNT; i++)
 		if (nullptr != m_ssm[i] && static_cast<int>(*m_ssm[i]) != last) {
-			used_steps.push_back(i);
+			used_steps.push_back({static_cast<unsigned>(i), static_cast<double>(*m_ssm[i])});
 			last = *m_ssm[i]; // avoid duplicate speds
 		}
+	return used_steps;
+}
 
+std::unique_ptr<unsigned> CalibMan::nextStep() {
+	const std::vector<Sp::Target> used_steps = usedSteps();
 	if (used_steps.empty()) // no available steps
 		return nullptr;
 
-	// Check if min step calibred
-	if (state[used_steps[0]] == StepState::Uncalibred)
-		return std::make_unique<unsigned>(used_steps[0]);
+	for (const Sp::Target &target : m_plan)
+		if (state[target.step] == StepState::Uncalibred)
+			return std::make_unique<unsigned>(target.step);
 
-	// Check if max step calibred
-	if (state[used_steps[used_steps.size()-1]] == StepState::Uncalibred)
-		return std::make_unique<unsigned>(used_steps[used_steps.size()-1]);
+	// No plan or plan finished: min step, max step, then binary search
+	for (const Sp::Target &target : Sp::bisection(used_steps))
+		if (state[target.step] == StepState::Uncalibred)
+			return std::make_unique<unsigned>(target.step);
 
-	// Binary search next step; interval=[left, right)
-	return nextStepBin(used_steps, 0, used_steps.size());
+	return nullptr;
 }
 
-std::unique_ptr<unsigned> CalibMan::nextStepBin(const std::vector<unsigned> &used_steps,
-                                                const size_t left, const size_t right) {
-	if (right <= left)
-		return nullptr;
-
-	size_t middle = ((right-left) / 2) + left;
-	if (state[used_steps[middle]] == StepState::Uncalibred)
-		return std::make_unique<unsigned>(used_steps[middle]);
-
-	std::unique_ptr<unsigned> res;
+void CalibMan::planSteps() {
+	m_plan.clear();
+	if (step_order != StepOrder::Planned)
+		return;
 
-	res = nextStepBin(used_steps, left, middle);
-	if (nullptr != res)
-		return res;
+	const std::vector<Sp::Target> used_steps = usedSteps();
+	std::vector<Sp::Target> uncalibred;
+	for (const Sp::Target &target : used_steps)
+		if (state[target.step] == StepState::Uncalibred)
+			uncalibred.push_back(target);
+	std::vector<Sp::Target> bisection;
+	for (const Sp::Target &target : Sp::bisection(used_steps))
+		if (state[target.step] == StepState::Uncalibred)
+			bisection.push_back(target);
 
-	res = nextStepBin(used_steps, middle+1, right);
-	if (nullptr != res)
-		return res;
+	// Loco is slow after the overview
+	m_plan = Sp::plan(uncalibred, 0, step_anchors, transition_cost);
 
-	return nullptr;
+	QString order;
+	for (const Sp::Target &target : m_plan)
+		order += " " + QString::number(target.step+1);
+	log("Steps order:" + order + ", expected transition time " +
+	    QString::number(transition_cost.order(m_plan, 0), 'f', 1) + " s (bisection: " +
+	    QString::number(transition_cost.order(bisection, 0), 'f', 1) + " s)", LogLevel::Info);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -229,6 +321,13 @@ void CalibMan::calibrateAll(const unsigned locoAddr, Xn::Direction dir) {
 	csSigConnect();
 	co.max_speed = m_ssm.maxSpeed();
 	m_no_calibrated = 0;
+	m_plan.clear();
+	pom.clear();
+	pom.resetCounters();
+	const std::optional<Sb::Sample> last = samples.last();
+	track.setOrigin(last.has_value() ? last->dist_raw : 0); // track mark is relative to here
+	metrics.runStart(locoAddr, pomCounters());
+	record("run_start", {{"direction", (dir == Xn::Direction::Forward) ? "forward" : "backward"}});
 
 	// Phase 0: set CV defaults
 	log("Starting calibration of loco "+QString::number(locoAddr)+"...", LogLevel::Info);
@@ -246,9 +345,15 @@ void CalibMan::stop() {
 	}
 
 	csSigDisconnect();
-	m_xn.setSpeed(Xn::LocoAddr(m_locoAddr), 0, direction);
+	pom.setSpeed(Xn::LocoAddr(m_locoAddr), 0, direction);
 	emit onLocoSpeedChanged(0);
+	if (m_step_measuring.has_value())
+		metricsStepEnd(0, false);
 	updateProg(CalibState::Stopped, 0, 1);
+	metrics.runEnd(false, pomCounters());
+	record("stop");
+	if (m_trace != nullptr)
+		m_trace->flush();
 }
 
 void CalibMan::calibrateNextStep() {
@@ -257,7 +362,7 @@ void CalibMan::calibrateNextStep() {
 		if (nullptr == next) {
 			// No more steps to calibrate
 			csSigDisconnect();
-			m_xn.setSpeed(Xn::LocoAddr(m_locoAddr), 0, direction);
+			pom.setSpeed(Xn::LocoAddr(m_locoAddr), 0, direction);
 			emit onLocoSpeedChanged(0);
 
 			// Phase 3: Interpolate the rest of the steps
@@ -269,8 +374,11 @@ void CalibMan::calibrateNextStep() {
 		unsigned step = (*next)+1;
 		log("Starting calibration of step " + QString::number(step), LogLevel::Info);
 		emit onStepStart(step);
-		m_xn.setSpeed(Xn::LocoAddr(m_locoAddr), step, direction);
+		pom.setSpeed(Xn::LocoAddr(m_locoAddr), step, direction);
 		emit onLocoSpeedChanged(step);
+		metrics.stepStart(step, *(m_ssm[*next]), pomCounters());
+		record("step_start", {{"step", step}, {"speed", static_cast<double>(*(m_ssm[*next]))}});
+		m_step_measuring = step;
 		cs.calibrate(m_locoAddr, step, *(m_ssm[*next]));
 	} catch (const QStrException& e) {
 		error(CmError::WsmError, 0, e.str());
@@ -287,12 +395,14 @@ void CalibMan::csSigConnect() {
 	QObject::connect(&cs, SIGNAL(done(uint,uint)), this, SLOT(csDone(uint,uint)));
 	QObject::connect(&cs, SIGNAL(step_power_changed(uint,uint)),
 	                 this, SLOT(cStepPowerChanged(uint,uint)));
+	QObject::connect(&cs, SIGNAL(power_tried(uint,uint)), this, SLOT(cPowerTried(uint,uint)));
 
 	QObject::connect(&co, SIGNAL(on_error(Co::Error,uint)), this,
 	                 SLOT(coError(Co::Error,uint)));
 	QObject::connect(&co, SIGNAL(done()), this, SLOT(coDone()));
 	QObject::connect(&co, SIGNAL(step_power_changed(uint,uint)),
 	                 this, SLOT(cStepPowerChanged(uint,uint)));
+	QObject::connect(&co, SIGNAL(power_tried(uint,uint)), this, SLOT(cPowerTried(uint,uint)));
 	QObject::connect(&co, SIGNAL(progress_update(size_t,size_t)),
 	                 this, SLOT(coProgressUpdate(size_t,size_t)));
 }
@@ -304,12 +414,16 @@ void CalibMan::csSigDisconnect() {
 	                    SLOT(csDone(unsigned, unsigned)));
 	QObject::disconnect(&cs, SIGNAL(step_power_changed(unsigned, unsigned)),
 	                    this, SLOT(cStepPowerChanged(unsigned, unsigned)));
+	QObject::disconnect(&cs, SIGNAL(power_tried(unsigned, unsigned)),
+	                    this, SLOT(cPowerTried(unsigned, unsigned)));
 
 	QObject::disconnect(&co, SIGNAL(on_error(Co::Error, unsigned)), this,
 	                    SLOT(coError(Co::Error, unsigned)));
 	QObject::disconnect(&co, SIGNAL(done()), this, SLOT(coDone()));
 	QObject::disconnect(&co, SIGNAL(step_power_changed(unsigned, unsigned)),
 	                    this, SLOT(cStepPowerChanged(unsigned, unsigned)));
+	QObject::disconnect(&co, SIGNAL(power_tried(unsigned, unsigned)),
+	                    this, SLOT(cPowerTried(unsigned, unsigned)));
 	QObject::disconnect(&co, SIGNAL(progress_update(size_t, size_t)),
 	                    this, SLOT(coProgressUpdate(size_t, size_t)));
 }
@@ -396,7 +510,7 @@ void CalibMan::interpolateNext() {
 
 	unsigned power = getIPpower(m_thisIPleft, m_thisIPright, m_thisIPstep);
 
-	m_xn.pomWriteCv(
+	pom.pomWriteCv(
 		Xn::LocoAddr(m_locoAddr),
 		CV_CURVE_START + m_thisIPstep,
 		power,
@@ -423,6 +537,16 @@ unsigned CalibMan::csNeighbourPower(unsigned middleStep, unsigned neighStep) con
 		power[middleStep-1];
 }
 
+// Return range of powers allowed for 'CalibStep' based on calibrated neighbours
+std::pair<unsigned, unsigned> CalibMan::csPowerBounds(unsigned step) const {
+	const std::optional<unsigned> lower = this->nearestCalibredOrSetStep(step-1, -1);
+	const std::optional<unsigned> upper = this->nearestCalibredOrSetStep(step+1, 1);
+	return {
+		(lower.has_value()) ? power[lower.value()-1] : Cs::POWER_MIN,
+		(upper.has_value()) ? power[upper.value()-1] : Cs::POWER_MAX,
+	};
+}
+
 // Direction: -1, 1
 std::optional<unsigned> CalibMan::nearestCalibredOrSetStep(unsigned start, int direction) const {
 	if (std::abs(direction) != 1)
@@ -468,7 +592,13 @@ void CalibMan::initCVs() {
 		QString::number(CV_CONFIG_BIT_SPEED_TABLE) + " = " + QString::number(CV_CONFIG_SPEED_TABLE_VALUE),
 		LogLevel::Info);
 
-	m_xn.pomWriteBit(
+	if (pom.image != nullptr && pom.image->skip_known &&
+	    pom.image->isBitKnown(m_locoAddr, CV_BASIC_CONFIG, CV_CONFIG_BIT_SPEED_TABLE,
+	                          CV_CONFIG_SPEED_TABLE_VALUE))
+		log("Speed curve already active (decoder image).", LogLevel::Info);
+
+	// PomQueue skips the write when the bit is known
+	pom.pomWriteBit(
 		Xn::LocoAddr(m_locoAddr),
 		CV_BASIC_CONFIG,
 		CV_CONFIG_BIT_SPEED_TABLE,
@@ -498,7 +628,7 @@ void CalibMan::initCVsWriteNext() {
 		// Go to phase 1: make an overview of mapping steps to speed
 		log("Initial CVs written, startring CalibrationOverview phase...", LogLevel::Success);
 		updateProg(CalibState::Overview, 0, 1);
-		m_xn.setSpeed(Xn::LocoAddr(m_locoAddr), co.overview_step, direction);
+		pom.setSpeed(Xn::LocoAddr(m_locoAddr), co.overview_step, direction);
 		emit onLocoSpeedChanged(co.overview_step);
 		co.makeOverview(m_locoAddr);
 		return;
@@ -509,7 +639,7 @@ void CalibMan::initCVsWriteNext() {
 
 	this->log("Write CV "+QString::number(cv)+" = "+QString::number(value), LogLevel::Info);
 
-	m_xn.pomWriteCv(
+	pom.pomWriteCv(
 		Xn::LocoAddr(m_locoAddr),
 		cv,
 		value,
@@ -526,4 +656,35 @@ void CalibMan::initCVsOk(void *, void *) {
 
 void CalibMan::initCVsError(void *, void *) { error(CmError::XnNoResponse, 0); }
 
+QString errorStr(const CmError ce) {
+	if (ce == CmError::Exception)
+		return "Exception!";
+	if (ce == CmError::LargeDiffusion)
+		return "Loco speed too diffused!";
+	if (ce == CmError::XnNoResponse)
+		return "No response from XpressNET!";
+	if (ce == CmError::LocoStopped)
+		return "Loco stopped!";
+	if (ce == CmError::NoStep)
+		return "No suitable power step for this speed!";
+	if (ce == CmError::Oscilation)
+		return "Unable to reach target speed in "+QString::number(Cs::MAX_ITERATIONS)+" iterations!";
+	if (ce == CmError::WsmError)
+		return "WSM read speed error!";
+	return "Unknown error!";
+}
+
+QString errorName(const CmError ce) {
+	switch (ce) {
+		case CmError::Exception: return "Exception";
+		case CmError::LargeDiffusion: return "LargeDiffusion";
+		case CmError::XnNoResponse: return "XnNoResponse";
+		case CmError::LocoStopped: return "LocoStopped";
+		case CmError::NoStep: return "NoStep";
+		case CmError::Oscilation: return "Oscilation";
+		case CmError::WsmError: return "WsmError";
+	}
+	return "Unknown";
+}
+
 } // namespace Cm
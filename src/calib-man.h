@@ -24,10 +24,16 @@ Calibration stages:
  1) Set important CVs to default (accel, decel, Vmax, ...).
  2) Make "basic overview" of power-to-speed mapping = try some powers and
     measure speed (calib-overview.h)
- 3) Calibrate speed steps (calib-step.h).
+ 3) Calibrate speed steps (calib-step.h). Steps are calibrated in order
+    planned to minimize speed changes of the loco (or in bisection order),
+    see step-planner.h.
  4) Interpolate the rest of the steps.
 
-All programming is done via POM (it is fast!).
+All programming is done via POM (it is fast!). POM writes and speed commands
+go through a coalescing queue (pom-queue.h), so superseded writes are not sent.
+
+When a trace (trace.h) is set, CalibMan, CalibStep, CalibOverview and
+PomQueue record every decision, POM write and WSM sample into it.
 */
 
 #include <QObject>
@@ -35,12 +41,18 @@ All programming is done via POM (it is fast!).
 #include <vector>
 #include <optional>
 
+#include "calib-metrics.h"
 #include "calib-overview.h"
 #include "calib-step.h"
 #include "lib/wsm/wsm.h"
 #include "lib/xn/xn.h"
+#include "pom-queue.h"
 #include "power-map.h"
+#include "sample-buffer.h"
 #include "speed-map.h"
+#include "step-planner.h"
+#include "trace.h"
+#include "track-mark.h"
 #include "cvs.h"
 
 #include "lib/q-str-exception.h"
@@ -71,6 +83,11 @@ enum class CalibState {
 	Interpolation,
 };
 
+enum class StepOrder {
+	Bisection,
+	Planned,
+};
+
 enum class LogLevel {
 	Error,
 	Warning,
@@ -80,13 +97,23 @@ enum class LogLevel {
 
 constexpr bool CV_CONFIG_SPEED_TABLE_VALUE = true;
 
+QString errorStr(CmError);
+QString errorName(CmError); // short identifier, e.g. for metrics
+
 class CalibMan : public QObject {
 	Q_OBJECT
 
 public:
+	Sb::SampleBuffer samples; // shared by all measurements of this WSM
+	Tm::TrackMark track; // origin is set at the start of calibration
+	Pq::PomQueue pom;
 	Cs::CalibStep cs;
 	Co::CalibOverview co;
 	Xn::Direction direction;
+	StepOrder step_order = StepOrder::Planned;
+	unsigned step_anchors = Sp::DEFAULT_ANCHORS;
+	Sp::TransitionCost transition_cost;
+	Mt::CalibMetrics metrics;
 
 	using CVsConfig = std::map<unsigned, unsigned>;
 	CVsConfig init_cvs = { // (cv, value)
@@ -108,10 +135,12 @@ public:
 	bool inProgress() const;
 	CalibState progress() const;
 	unsigned csNeighbourPower(unsigned middleStep, unsigned neighStep) const;
+	std::pair<unsigned, unsigned> csPowerBounds(unsigned step) const;
+	unsigned stepPower(unsigned step) const; // power assigned to step (1-28)
+	void setTrace(Tr::Trace *); // nullptr = no trace
 
 private:
 	Ssm::StepsToSpeedMap &m_ssm;
-	Xn::XpressNet &m_xn;
 	StepState state[Xn::_STEPS_CNT]; // step index used as index
 	unsigned power[Xn::_STEPS_CNT]; // power assigned to steps after calibration
 	unsigned m_locoAddr = 3;
@@ -123,14 +152,21 @@ private:
 	CVsConfig::iterator m_init_cv_iterator;
 	unsigned m_init_cv_index;
 
+	std::vector<Sp::Target> m_plan;
+	std::optional<unsigned> m_step_measuring; // step being calibrated by cs
+	Tr::Trace *m_trace = nullptr;
+
 	std::unique_ptr<unsigned> nextStep(); // returns step index
 	void calibrateNextStep();
-	std::unique_ptr<unsigned> nextStepBin(const std::vector<unsigned> &used_steps,
-	                                      size_t left, size_t right);
+	std::vector<Sp::Target> usedSteps() const;
+	void planSteps();
 	void csSigConnect();
 	void csSigDisconnect();
 	void updateProg(CalibState cs, size_t progress, size_t max);
+	Mt::PomCounters pomCounters() const;
+	void metricsStepEnd(unsigned power, bool done);
 	size_t getProgress(CalibState cs, size_t progress, size_t max);
+	void record(const char *event, std::initializer_list<Tr::Field> = {}) const;
 
 	void xnStepWritten(void *, void *);
 	void xnStepWriteError(void *, void *);
@@ -168,6 +204,8 @@ private slots:
 	void coProgressUpdate(size_t progress, size_t max);
 
 	void cStepPowerChanged(unsigned step, unsigned power);
+	void cPowerTried(unsigned step, unsigned power);
+	void samplesAdded(quint64 seq);
 
 signals:
 	void onStepStart(unsigned step);
@@ -178,7 +216,8 @@ signals:
 	void onLog(const QString &, Cm::LogLevel);
 
 	void onLocoSpeedChanged(unsigned step);
-	void onStepPowerChanged(unsigned step, unsigned power);
+	void onStepPowerChanged(unsigned step, unsigned power); // any change of step power
+	void onPowerTried(unsigned step, unsigned power, Cm::CalibState phase); // Overview/Steps attempt
 
 	void onProgressUpdate(size_t val); // value 0-100
 };
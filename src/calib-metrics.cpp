@@ -0,0 +1,216 @@
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include "calib-metrics.h"
+#include "clock.h"
+#include "lib/q-str-exception.h"
+
+namespace Mt {
+
+PomCounters PomCounters::operator-(const PomCounters &other) const {
+	return {sent - other.sent, merged - other.merged, dropped - other.dropped,
+	        skipped - other.skipped};
+}
+
+PomCounters &PomCounters::operator+=(const PomCounters &other) {
+	sent += other.sent;
+	merged += other.merged;
+	dropped += other.dropped;
+	skipped += other.skipped;
+	return *this;
+}
+
+Counters &Counters::operator+=(const Counters &other) {
+	time += other.time;
+	iterations += other.iterations;
+	measures += other.measures;
+	measure_repeats += other.measure_repeats;
+	samples += other.samples;
+	pom += other.pom;
+	return *this;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CalibMetrics::reset() { *this = CalibMetrics(); }
+
+void CalibMetrics::runStart(const unsigned addr, const PomCounters &pom) {
+	if (addr != loco_addr)
+		reset();
+	loco_addr = addr;
+	if (runs == 0)
+		started = QDateTime::currentDateTime();
+	runs++;
+	m_running = true;
+	m_run_start = Vc::now();
+	m_run_pom = pom;
+}
+
+void CalibMetrics::runEnd(const bool done, const PomCounters &pom) {
+	if (!m_running)
+		return;
+	phaseStart("", pom);
+	m_running = false;
+	if (done)
+		runs_done++;
+	total.time += Vc::now() - m_run_start;
+	total.pom += pom - m_run_pom;
+}
+
+void CalibMetrics::phaseStart(const QString &phase, const PomCounters &pom) {
+	if (phase == m_phase)
+		return;
+
+	const qint64 now = Vc::now();
+	if (!m_phase.isEmpty()) {
+		Counters &counters = phases[m_phase];
+		counters.time += now - m_phase_start;
+		counters.pom += pom - m_phase_pom;
+	}
+
+	m_phase = phase;
+	m_phase_start = now;
+	m_phase_pom = pom;
+}
+
+void CalibMetrics::stepStart(const unsigned step, const double target_speed,
+                             const PomCounters &pom) {
+	StepMetrics &metrics = steps[step];
+	metrics.step = step;
+	metrics.target_speed = target_speed;
+	metrics.attempts++;
+	m_step = step;
+	m_step_start = Vc::now();
+	m_step_pom = pom;
+}
+
+void CalibMetrics::stepEnd(const unsigned step, const unsigned power, const bool done,
+                           const Counters &cs, const PomCounters &pom) {
+	if (step != m_step)
+		return;
+	m_step = 0;
+
+	Counters counters = cs;
+	counters.time = Vc::now() - m_step_start;
+	counters.pom = pom - m_step_pom;
+
+	StepMetrics &metrics = steps[step];
+	metrics.power = power;
+	metrics.done = done;
+	metrics.counters += counters;
+
+	// Phase time & POM are measured by phase, only take the CalibStep counters
+	Counters &phase = phases[m_phase];
+	phase.iterations += cs.iterations;
+	phase.measures += cs.measures;
+	phase.measure_repeats += cs.measure_repeats;
+	phase.samples += cs.samples;
+
+	total.iterations += cs.iterations;
+	total.measures += cs.measures;
+	total.measure_repeats += cs.measure_repeats;
+	total.samples += cs.samples;
+}
+
+void CalibMetrics::error(const QString &name) { errors[name]++; }
+
+///////////////////////////////////////////////////////////////////////////////
+
+static QJsonObject toJson(const PomCounters &pom) {
+	return QJsonObject{
+		{"sent", static_cast<int>(pom.sent)},
+		{"merged", static_cast<int>(pom.merged)},
+		{"dropped", static_cast<int>(pom.dropped)},
+		{"skipped", static_cast<int>(pom.skipped)},
+	};
+}
+
+static QJsonObject toJson(const Counters &counters) {
+	return QJsonObject{
+		{"time_ms", static_cast<qint64>(counters.time)},
+		{"iterations", static_cast<int>(counters.iterations)},
+		{"measures", static_cast<int>(counters.measures)},
+		{"measure_repeats", static_cast<int>(counters.measure_repeats)},
+		{"samples", static_cast<int>(counters.samples)},
+		{"pom", toJson(counters.pom)},
+	};
+}
+
+void CalibMetrics::saveJson(const QString &filename) const {
+	QJsonObject root;
+	root["version"] = QString::number(VERSION_MAJOR) + "." + QString::number(VERSION_MINOR);
+	root["loco"] = static_cast<int>(loco_addr);
+	root["started"] = started.toString(Qt::ISODate);
+	root["runs"] = static_cast<int>(runs);
+	root["runs_done"] = static_cast<int>(runs_done);
+	root["total"] = toJson(total);
+
+	QJsonObject phasesJson;
+	for (const auto &phase : phases)
+		phasesJson[phase.first] = toJson(phase.second);
+	root["phases"] = phasesJson;
+
+	QJsonArray stepsJson;
+	for (const auto &item : steps) {
+		const StepMetrics &step = item.second;
+		QJsonObject stepJson = toJson(step.counters);
+		stepJson["step"] = static_cast<int>(step.step);
+		stepJson["target_speed"] = step.target_speed;
+		stepJson["power"] = static_cast<int>(step.power);
+		stepJson["done"] = step.done;
+		stepJson["attempts"] = static_cast<int>(step.attempts);
+		stepsJson.append(stepJson);
+	}
+	root["steps"] = stepsJson;
+
+	QJsonObject errorsJson;
+	for (const auto &error : errors)
+		errorsJson[error.first] = static_cast<int>(error.second);
+	root["errors"] = errorsJson;
+
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly))
+		throw QStrException("Cannot write file " + filename);
+	file.write(QJsonDocument(root).toJson());
+}
+
+static QString csvRow(const QString &kind, const QString &name, const Counters &c) {
+	return kind + ";" + name + ";" + QString::number(c.time) + ";" +
+	       QString::number(c.iterations) + ";" + QString::number(c.measures) + ";" +
+	       QString::number(c.measure_repeats) + ";" + QString::number(c.samples) + ";" +
+	       QString::number(c.pom.sent) + ";" + QString::number(c.pom.merged) + ";" +
+	       QString::number(c.pom.dropped) + ";" + QString::number(c.pom.skipped);
+}
+
+void CalibMetrics::saveCsv(const QString &filename) const {
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		throw QStrException("Cannot write file " + filename);
+
+	QTextStream out(&file);
+	out << "kind;name;time_ms;iterations;measures;measure_repeats;samples;"
+	       "pom_sent;pom_merged;pom_dropped;pom_skipped;power;target_speed;result\n";
+	out << csvRow("total", QString::number(loco_addr), total) << ";;;"
+	    << runs_done << "/" << runs << "\n";
+	for (const auto &phase : phases)
+		out << csvRow("phase", phase.first, phase.second) << ";;;\n";
+	for (const auto &item : steps) {
+		const StepMetrics &step = item.second;
+		out << csvRow("step", QString::number(step.step), step.counters) << ";" << step.power
+		    << ";" << step.target_speed << ";" << (step.done ? "done" : "failed") << "\n";
+	}
+	for (const auto &error : errors)
+		out << "error;" << error.first << ";;;;;;;;;;;;" << error.second << "\n";
+}
+
+QString CalibMetrics::filename(const QString &loco_file, const QString &extension) {
+	QString base = loco_file;
+	if (base.endsWith(".xml"))
+		base.chop(4);
+	return base + ".metrics." + extension;
+}
+
+} // namespace Mt
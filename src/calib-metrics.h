@@ -0,0 +1,97 @@
+#ifndef CALIB_METRICS_H
+#define CALIB_METRICS_H
+
+/*
+This file defines a CalibMetrics class which collects metrics of calibration
+runs of a single loco: where the time goes and how much bus & sensor
+traffic each part of the calibration needs.
+
+ * Metrics are collected per phase (InitProg, Overview, Steps,
+   Interpolation) and per calibrated step.
+ * Counters: time, CalibStep iterations (set power & measure cycles), speed
+   measures started, measures repeated (window slid due to high diffusion),
+   WSM samples used, POM writes (sent/merged/dropped/skipped, see
+   pom-queue.h).
+ * Errors are counted by type.
+ * Time is taken from clock.h, so it is virtual time in the simulator.
+ * Metrics accumulate over resumed runs until reset().
+ * Metrics could be exported as JSON or CSV (next to the loco file,
+   see filename()).
+*/
+
+#include <QDateTime>
+#include <QString>
+#include <map>
+#include <vector>
+
+namespace Mt {
+
+struct PomCounters {
+	unsigned sent = 0;
+	unsigned merged = 0;
+	unsigned dropped = 0;
+	unsigned skipped = 0;
+
+	PomCounters operator-(const PomCounters &) const;
+	PomCounters &operator+=(const PomCounters &);
+};
+
+struct Counters {
+	qint64 time = 0; // ms
+	unsigned iterations = 0;
+	unsigned measures = 0;
+	unsigned measure_repeats = 0;
+	unsigned samples = 0;
+	PomCounters pom;
+
+	Counters &operator+=(const Counters &);
+};
+
+struct StepMetrics {
+	unsigned step; // 1-28
+	double target_speed = 0;
+	unsigned power = 0;
+	bool done = false;
+	unsigned attempts = 0;
+	Counters counters;
+};
+
+class CalibMetrics {
+public:
+	unsigned loco_addr = 0;
+	unsigned runs = 0;
+	unsigned runs_done = 0;
+	QDateTime started;
+	Counters total;
+	std::map<QString, Counters> phases; // phase name -> counters
+	std::map<unsigned, StepMetrics> steps; // step -> metrics
+	std::map<QString, unsigned> errors; // error name -> count
+
+	void reset();
+	void runStart(unsigned loco_addr, const PomCounters &);
+	void runEnd(bool done, const PomCounters &);
+	void phaseStart(const QString &phase, const PomCounters &); // empty phase = none
+	void stepStart(unsigned step, double target_speed, const PomCounters &);
+	void stepEnd(unsigned step, unsigned power, bool done, const Counters &cs, const PomCounters &);
+	void error(const QString &name);
+
+	void saveJson(const QString &filename) const; // throws QStrException
+	void saveCsv(const QString &filename) const; // throws QStrException
+
+	static QString filename(const QString &loco_file, const QString &extension);
+
+private:
+	QString m_phase;
+	qint64 m_phase_start = 0;
+	PomCounters m_phase_pom;
+	qint64 m_run_start = 0;
+	PomCounters m_run_pom;
+	unsigned m_step = 0;
+	qint64 m_step_start = 0;
+	PomCounters m_step_pom;
+	bool m_running = false;
+};
+
+} // namespace Mt
+
+#endif
@@ -1,15 +1,21 @@
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include "calib-overview.h"
 #include "speed-map.h"
 
 namespace Co {
 
-CalibOverview::CalibOverview(Xn::XpressNet &xn, Pm::PowerToSpeedMap &pm, Wsm::Wsm &wsm,
+CalibOverview::CalibOverview(Pq::PomQueue &pom, Pm::PowerToSpeedMap &pm, Sb::SampleBuffer &samples,
                              unsigned max_speed, QObject *parent)
-    : QObject(parent), max_speed(max_speed), m_xn(xn), m_pm(pm), m_wsm(wsm) {
+    : QObject(parent), max_speed(max_speed), m_pom(pom), m_pm(pm), m_samples(samples) {
+	QObject::connect(&samples, SIGNAL(sampleAdded(quint64)), this, SLOT(samples_added()));
+	QObject::connect(&samples, SIGNAL(speedReceiveTimeout()), this, SLOT(samples_timeout()));
 	t_sp_adapt.setSingleShot(true);
 	QObject::connect(&t_sp_adapt, SIGNAL(timeout()), this, SLOT(t_sp_adapt_tick()));
+	t_ramp.setSingleShot(true);
+	QObject::connect(&t_ramp, SIGNAL(timeout()), this, SLOT(t_ramp_tick()));
 }
 
 std::unique_ptr<unsigned> CalibOverview::next_step() {
@@ -41,10 +47,13 @@ std::unique_ptr<unsigned> CalibOverview::next_step() {
 
 void CalibOverview::makeOverview(const unsigned loco_addr) {
 	m_loco_addr = loco_addr;
-	m_diff_count = 0;
 	was_set = false;
+	record("start", {{"mode", (mode == Mode::Ramp) ? "ramp" : "steps"}});
 
-	do_next_step();
+	if (mode == Mode::Ramp)
+		ramp_start();
+	else
+		do_next_step();
 }
 
 void CalibOverview::do_next_step() {
@@ -54,11 +63,14 @@ void CalibOverview::do_next_step() {
 			// Set some "normal" value to step 1
 			reset_step();
 		}
+		record("done");
 		emit done();
 		return;
 	}
 	m_last_power = *next;
+	record("set_power", {{"power", m_last_power}});
 	emit progress_update(m_last_power, POWER_CNT);
+	emit power_tried(overview_step, m_last_power);
 
 	was_set = true;
 	this->pom_write_power(
@@ -68,28 +80,106 @@ void CalibOverview::do_next_step() {
 	);
 }
 
-void CalibOverview::wsm_lt_read(double speed, double diffusion) {
-	QObject::disconnect(&m_wsm, SIGNAL(longTermMeasureDone(double, double)), this,
-	                    SLOT(wsm_lt_read(double, double)));
-	QObject::disconnect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SLOT(wsm_lt_error()));
+void CalibOverview::samples_added() {
+	Sb::Sample sample;
+	while (m_listening != Listening::None && m_samples.next(sample)) {
+		if (m_listening == Listening::Mark)
+			wsm_mark_read(sample);
+		else if (m_listening == Listening::Measure)
+			wsm_speed_read(sample);
+		else
+			wsm_ramp_read(sample);
+	}
+}
 
-	if (speed < min_speed) {
-		// When speed is too low, it may happen that it chnges between zero
-		// and some non/zero value. This causes low speed, but high diffusion.
-		// We ignore those low speeds.
-		m_pm.addOrUpdate(m_last_power, 0);
-		do_next_step();
+void CalibOverview::samples_timeout() {
+	if (m_listening == Listening::None)
+		return;
+	// No more samples would come -> fail instead of waiting forever
+	wsm_lt_error();
+	wsm_error();
+}
+
+void CalibOverview::wsm_error() {
+	record("error", {{"error", "WsmError"}});
+	emit on_error(Co::Error::WsmError, overview_step);
+}
+
+void CalibOverview::measurement_reset(const size_t samples, const unsigned revolutions) {
+	m_measurement.reset(speed_estimator, samples, revolutions,
+	                    m_samples.buffer().tickSpeed(), m_samples.buffer().ticksPerRevolution());
+}
+
+void CalibOverview::wsm_mark_read(const Sb::Sample &sample) {
+	const bool passed = m_mark.add(sample.time, sample.dist_raw);
+	const bool timeout = (m_mark.sinceMark(sample.time) >= mark_timeout);
+	if (!passed && !timeout)
+		return;
+
+	record("mark", {{"power", m_last_power}, {"passed", passed},
+	                {"position", track->position(sample.dist_raw)}});
+	m_laps = passed ? measure_laps : 0;
+	if (m_laps > 0) {
+		measurement_reset(Se::UNLIMITED, 0);
+		m_mark.reset(*track);
+	}
+	m_listening = Listening::Measure;
+	wsm_speed_read(sample); // window begins on the mark
+}
+
+void CalibOverview::lap_read(const Sb::Sample &sample) {
+	m_measurement.add(sample.time, sample.speed, sample.dist_raw);
+	const bool passed = m_mark.add(sample.time, sample.dist_raw);
+	if (m_mark.passed() >= m_laps || (!passed && m_mark.sinceMark(sample.time) >= mark_timeout))
+		speed_measured(m_measurement.speed());
+}
+
+void CalibOverview::wsm_speed_read(const Sb::Sample &sample) {
+	if (m_laps > 0) {
+		lap_read(sample);
 		return;
 	}
+	if (!m_measurement.add(sample.time, sample.speed, sample.dist_raw))
+		return; // aligned window changes on revolution boundaries only
+
+	const Se::RollingSpeed &window = m_measurement.window();
+	if (!window.full())
+		return;
 
-	if (diffusion > max_abs_diffusion && diffusion > speed*max_rel_diffusion) {
-		if (m_diff_count >= ADAPT_MAX_TICKS) {
+	// When speed is too low, it may happen that it chnges between zero
+	// and some non/zero value. This causes low speed, but high diffusion.
+	// We ignore diffusion of those low speeds.
+	if (window.mean() >= min_speed &&
+	    !window.isStable(max_abs_diffusion, max_rel_diffusion)) {
+		if (m_diff_count >= ADAPT_MAX_TICKS*window.capacity()) {
+			wsm_disconnect();
+			record("error", {{"error", "LargeDiffusion"}, {"diffusion", window.diffusion()}});
 			emit on_error(Co::Error::LargeDiffusion, overview_step);
 			return;
 		}
-		// Wait for speed...
+		// Wait for speed: slide the window by one sample (revolution)
 		m_diff_count++;
-		t_sp_adapt_tick();
+		return;
+	}
+
+	speed_measured(m_measurement.speed());
+}
+
+void CalibOverview::speed_measured(double speed) {
+	wsm_disconnect();
+	const Se::RollingSpeed &window = m_measurement.window();
+	record("measured", {{"power", m_last_power}, {"speed", speed},
+	                    {"diffusion", window.diffusion()},
+	                    {"uncertainty", m_measurement.uncertainty(1)},
+	                    {"samples", static_cast<unsigned>(m_measurement.samples().count())},
+	                    {"revolutions", m_measurement.aligned() ? static_cast<unsigned>(window.count()) : 0u},
+	                    {"laps", (m_laps > 0) ? m_mark.passed() : 0u},
+	                    {"repeats", m_diff_count}});
+
+	if (speed < min_speed) {
+		// We ignore those low speeds.
+		m_pm.addOrUpdate(m_last_power, 0);
+		do_next_step();
 		return;
 	}
 
@@ -98,26 +188,46 @@ void CalibOverview::wsm_lt_read(double speed, double diffusion) {
 }
 
 void CalibOverview::t_sp_adapt_tick() {
-	QObject::connect(&m_wsm, SIGNAL(longTermMeasureDone(double,double)), this,
-	                 SLOT(wsm_lt_read(double,double)));
-	QObject::connect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SLOT(wsm_lt_error()));
-	m_wsm.startLongTermMeasure(measure_count);
+	if (!m_samples.buffer().speedOk()) {
+		// WSM timed out while waiting for the loco
+		wsm_lt_error();
+		wsm_error();
+		return;
+	}
+
+	measurement_reset(measure_count, measure_revolutions);
+	m_laps = 0;
+	m_diff_count = 0;
+	m_samples.seekHead();
+
+	if (track != nullptr && track->enabled()) {
+		m_mark.reset(*track);
+		m_listening = Listening::Mark;
+	} else {
+		m_listening = Listening::Measure;
+	}
+}
+
+void CalibOverview::wsm_disconnect() {
+	if (m_listening == Listening::Mark || m_listening == Listening::Measure)
+		m_listening = Listening::None;
 }
 
 void CalibOverview::xn_pom_ok(void *, void *) {
-	// Insert 'waiting on mark' here when necessarry
+	// Waiting on the track mark follows the adaptation (t_sp_adapt_tick)
 	t_sp_adapt.start(sp_adapt_timeout);
 }
 
 void CalibOverview::xn_pom_err(void *, void *) {
+	record("error", {{"error", "XnNoResponse"}});
 	emit on_error(Co::Error::XnNoResponse, overview_step);
 }
 
 void CalibOverview::wsm_lt_error() {
 	t_sp_adapt.stop();
-	QObject::disconnect(&m_wsm, SIGNAL(longTermMeasureDone(double, double)), this,
-	                    SLOT(wsm_lt_read(double, double)));
-	QObject::disconnect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SLOT(wsm_lt_error()));
+	t_ramp.stop();
+	wsm_disconnect();
+	ramp_disconnect();
 	reset_step();
 }
 
@@ -129,7 +239,7 @@ void CalibOverview::stop() { wsm_lt_error(); }
 
 void CalibOverview::pom_write_power(unsigned power, std::unique_ptr<Xn::Cb> ok, std::unique_ptr<Xn::Cb> err) {
 	if (overview_step > 1) {
-		m_xn.pomWriteCv(
+		m_pom.pomWriteCv(
 			Xn::LocoAddr(m_loco_addr),
 			CV_CURVE_START - 1 + overview_step - 1,
 			power
@@ -137,7 +247,7 @@ void CalibOverview::pom_write_power(unsigned power, std::unique_ptr<Xn::Cb> ok,
 		emit step_power_changed(overview_step-1, power);
 	}
 
-	m_xn.pomWriteCv(
+	m_pom.pomWriteCv(
 		Xn::LocoAddr(m_loco_addr),
 		CV_CURVE_START - 1 + overview_step,
 		power,
@@ -147,7 +257,7 @@ void CalibOverview::pom_write_power(unsigned power, std::unique_ptr<Xn::Cb> ok,
 	emit step_power_changed(overview_step, power);
 
 	if (overview_step < Xn::_STEPS_CNT) {
-		m_xn.pomWriteCv(
+		m_pom.pomWriteCv(
 			Xn::LocoAddr(m_loco_addr),
 			CV_CURVE_START - 1 + overview_step + 1,
 			power
@@ -156,4 +266,139 @@ void CalibOverview::pom_write_power(unsigned power, std::unique_ptr<Xn::Cb> ok,
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
+void CalibOverview::ramp_start() {
+	m_ramp_powers.clear();
+	m_ramp_bucket.reset();
+	m_ramp_last_speed = 0;
+	m_ramp_finishing = false;
+	m_last_power = overview_start;
+	was_set = true;
+
+	m_ramp_run++;
+	m_samples.seekHead();
+	m_listening = Listening::Ramp;
+
+	ramp_write();
+}
+
+void CalibOverview::ramp_write() {
+	record("set_power", {{"power", m_last_power}});
+	emit progress_update(m_last_power, POWER_CNT);
+	emit power_tried(overview_step, m_last_power);
+	const unsigned run = m_ramp_run;
+	this->pom_write_power(
+		m_last_power,
+		std::make_unique<Xn::Cb>([this, run](void *, void *) { ramp_pom_ok(run); }),
+		std::make_unique<Xn::Cb>([this, run](void *, void *) { ramp_pom_err(run); })
+	);
+}
+
+bool CalibOverview::ramp_running(const unsigned run) const {
+	// Write could be acknowledged after the ramp was done or stopped
+	return (m_listening == Listening::Ramp && run == m_ramp_run);
+}
+
+void CalibOverview::ramp_pom_ok(const unsigned run) {
+	if (!ramp_running(run))
+		return;
+	// Loco gets the new power now -> speeds from now + lag belong to it
+	m_ramp_powers.push_back({Vc::now(), m_last_power});
+	t_ramp.start(ramp_interval);
+}
+
+void CalibOverview::ramp_pom_err(const unsigned run) {
+	if (!ramp_running(run))
+		return;
+	t_ramp.stop();
+	ramp_disconnect();
+	record("error", {{"error", "XnNoResponse"}});
+	emit on_error(Co::Error::XnNoResponse, overview_step);
+}
+
+void CalibOverview::t_ramp_tick() {
+	if (m_listening != Listening::Ramp)
+		return;
+	if (m_last_power < POWER_CNT-1) {
+		m_last_power = std::min(m_last_power + std::max(ramp_increment, 1u), POWER_CNT-1);
+		ramp_write();
+		return;
+	}
+
+	// Maximum power reached: wait for its speeds to arrive
+	if (!m_ramp_finishing) {
+		m_ramp_finishing = true;
+		t_ramp.start(ramp_lag);
+		return;
+	}
+
+	ramp_flush();
+	ramp_done();
+}
+
+void CalibOverview::wsm_ramp_read(const Sb::Sample &sample) {
+	// Lag compensation: speed is a reaction to power set 'ramp_lag' before
+	// the sample was received (not processed, samples could be queued)
+	const qint64 time = sample.time - ramp_lag;
+	while (m_ramp_powers.size() > 1 && m_ramp_powers[1].time <= time)
+		m_ramp_powers.pop_front();
+	if (m_ramp_powers.empty() || m_ramp_powers.front().time > time)
+		return; // reaction to the first power not visible yet
+
+	const unsigned power = m_ramp_powers.front().power;
+	if (m_ramp_bucket != power) {
+		ramp_flush();
+		m_ramp_bucket = power;
+		measurement_reset(measure_count, 0); // ramp does not wait for whole revolutions
+	}
+	m_measurement.add(sample.time, sample.speed, sample.dist_raw);
+
+	if (m_measurement.samples().count() >= ramp_min_samples && m_measurement.speed() >= max_speed) {
+		ramp_flush();
+		ramp_done();
+	}
+}
+
+void CalibOverview::ramp_flush() {
+	if (!m_ramp_bucket.has_value() || m_measurement.samples().count() < std::max(ramp_min_samples, 1u))
+		return;
+
+	double speed = m_measurement.speed();
+	if (speed < min_speed) {
+		// We ignore those low speeds.
+		speed = 0;
+	}
+	// Speed noise must not make the power-to-speed graph decreasing
+	speed = std::max(speed, m_ramp_last_speed);
+	m_ramp_last_speed = speed;
+
+	record("measured", {{"power", m_ramp_bucket.value()}, {"speed", speed},
+	                    {"diffusion", m_measurement.samples().diffusion()},
+	                    {"samples", static_cast<unsigned>(m_measurement.samples().count())}});
+	m_pm.addOrUpdate(m_ramp_bucket.value(), speed);
+	m_ramp_bucket.reset();
+}
+
+void CalibOverview::ramp_done() {
+	t_ramp.stop();
+	ramp_disconnect();
+	reset_step();
+	record("done");
+	emit done();
+}
+
+void CalibOverview::ramp_disconnect() {
+	if (m_listening == Listening::Ramp)
+		m_listening = Listening::None;
+}
+
+void CalibOverview::record(const char *event, std::initializer_list<Tr::Field> fields) const {
+	if (trace == nullptr || !trace->enabled())
+		return;
+	std::vector<Tr::Field> all {{"loco", m_loco_addr}};
+	all.insert(all.end(), fields.begin(), fields.end());
+	trace->record("co", event, all);
+}
+
 } // namespace Co
@@ -12,8 +12,15 @@ The process ends either by calling done() XOR on_error() event.
 The whole process goes as followed:
 
  1) Set power.
- 2) If speed > threshold, create new entry in power-to-speed graph.
- 3) GOTO 1) (for another power).
+ 2) When a track mark is set (see track-mark.h), wait for the loco to pass
+    it (at most mark_timeout).
+ 3) Measure speed (sliding window over speeds from WSM read from the shared
+    sample buffer, see speed-estimator.h & sample-buffer.h; mean of speeds
+    or distance over time by speed_estimator, optionally over
+    measure_revolutions whole wheel revolutions or measure_laps whole laps
+    from the mark). If speed > threshold, create new entry in power-to-speed
+    graph.
+ 4) GOTO 1) (for another power).
 
 Powers are tested from lowest to highest based on this procedure:
 
@@ -26,14 +33,30 @@ Powers are tested from lowest to highest based on this procedure:
 
 Conclusion: at the end of this procedure, we know the power of minimum speed
 of the loco and the power of maximum speed of the loco.
+
+Alternatively (mode = Mode::Ramp), the power of the overview step is ramped
+continuously from START_STEP: it is increased by RAMP_INCREMENT every
+RAMP_INTERVAL ms until speed >= max_speed or power = 255. Speeds from WSM
+are not waited for; each speed sample is assigned to the power which was
+acknowledged RAMP_LAG ms before the sample was received (the loco reacts to
+a new power with a delay). POM acks arriving after the ramp was finished or
+stopped are ignored. Samples of a single power are averaged and stored to the
+power-to-speed graph. This gives a dense graph in a single pass.
 */
 
 #include <QObject>
-#include <QTimer>
+#include <deque>
+#include <optional>
 
+#include "clock.h"
 #include "lib/wsm/wsm.h"
 #include "lib/xn/xn.h"
+#include "pom-queue.h"
 #include "power-map.h"
+#include "sample-buffer.h"
+#include "speed-estimator.h"
+#include "trace.h"
+#include "track-mark.h"
 #include "cvs.h"
 
 namespace Co {
@@ -42,18 +65,43 @@ constexpr unsigned DEFAULT_SP_ADAPT_TIMEOUT = 2000; // speed timeout, 2 s
 constexpr double DEFAULT_MAX_ABS_DIFFUSION = 1; // kmph
 constexpr double DEFAULT_MAX_REL_DIFFUSION = 0.06; // 6 %
 constexpr unsigned DEFAULT_MEASURE_COUNT = 30; // measuring 30 values = 3 s
+constexpr unsigned DEFAULT_MEASURE_REVOLUTIONS = 0; // 0 = window not aligned to revolutions
+constexpr unsigned DEFAULT_MARK_TIMEOUT = 20000; // ms, waiting for the track mark
+constexpr unsigned DEFAULT_MEASURE_LAPS = 0; // 0 = do not average over laps
 constexpr unsigned DEFAULT_SPEED_MAX = 120;
 constexpr unsigned DEFAULT_OVERVIEW_STEP = 2;
 constexpr unsigned DEFAULT_OVERVIEW_START = 10;
 constexpr unsigned DEFAULT_MIN_SPEED = 5; // kmph
+constexpr unsigned DEFAULT_RAMP_INCREMENT = 2; // power increment per ramp tick
+constexpr unsigned DEFAULT_RAMP_INTERVAL = 300; // ms between power ack and next increment
+constexpr unsigned DEFAULT_RAMP_LAG = 400; // ms from power ack to speed reaction of the loco
+constexpr unsigned DEFAULT_RAMP_MIN_SAMPLES = 2; // minimum speeds per power to create map entry
 
 constexpr unsigned STEP_RESET_VALUE = 10;
-constexpr unsigned ADAPT_MAX_TICKS = 3; // maximum adaptation ticks
+constexpr unsigned ADAPT_MAX_TICKS = 3; // maximum adaptation ticks (in windows of measure_count)
 constexpr unsigned POWER_CNT = 256;
 
+enum class Mode {
+	Steps, // measure a few selected powers
+	Ramp, // ramp power continuously
+};
+
+struct RampPoint {
+	qint64 time; // ms, Vc::now() when the power was acknowledged
+	unsigned power;
+};
+
 enum class Error {
 	LargeDiffusion,
 	XnNoResponse,
+	WsmError, // no speed from WSM
+};
+
+enum class Listening {
+	None,
+	Mark, // samples go to wsm_mark_read
+	Measure, // samples go to wsm_speed_read
+	Ramp, // samples go to wsm_ramp_read
 };
 
 class CalibOverview : public QObject {
@@ -64,11 +112,22 @@ public:
 	double max_abs_diffusion = DEFAULT_MAX_ABS_DIFFUSION;
 	double max_rel_diffusion = DEFAULT_MAX_REL_DIFFUSION;
 	unsigned measure_count = DEFAULT_MEASURE_COUNT;
+	unsigned measure_revolutions = DEFAULT_MEASURE_REVOLUTIONS;
 	unsigned overview_step = DEFAULT_OVERVIEW_STEP;
 	unsigned overview_start = DEFAULT_OVERVIEW_START;
 	unsigned min_speed = DEFAULT_MIN_SPEED;
-
-	CalibOverview(Xn::XpressNet &xn, Pm::PowerToSpeedMap &pm, Wsm::Wsm &wsm,
+	Mode mode = Mode::Steps;
+	unsigned ramp_increment = DEFAULT_RAMP_INCREMENT;
+	unsigned ramp_interval = DEFAULT_RAMP_INTERVAL;
+	unsigned ramp_lag = DEFAULT_RAMP_LAG;
+	unsigned ramp_min_samples = DEFAULT_RAMP_MIN_SAMPLES;
+	Se::Method speed_estimator = Se::Method::Samples;
+	unsigned mark_timeout = DEFAULT_MARK_TIMEOUT;
+	unsigned measure_laps = DEFAULT_MEASURE_LAPS;
+	const Tm::TrackMark *track = nullptr; // nullptr = no mark
+	Tr::Trace *trace = nullptr;
+
+	CalibOverview(Pq::PomQueue &pom, Pm::PowerToSpeedMap &pm, Sb::SampleBuffer &samples,
 	              unsigned max_speed = DEFAULT_SPEED_MAX, QObject *parent = nullptr);
 	void makeOverview(unsigned loco_addr);
 	void stop();
@@ -76,18 +135,38 @@ public:
 	unsigned max_speed;
 
 private:
-	Xn::XpressNet &m_xn;
+	Pq::PomQueue &m_pom;
 	Pm::PowerToSpeedMap &m_pm;
-	Wsm::Wsm &m_wsm;
+	Sb::Reader m_samples;
+	Listening m_listening = Listening::None;
 
 	unsigned m_loco_addr;
-	QTimer t_sp_adapt;
+	Vc::Timer t_sp_adapt;
+	Se::Measurement m_measurement;
+	Tm::MarkTracker m_mark;
+	unsigned m_laps = 0; // laps of current measurement, 0 = window of samples
 	unsigned m_diff_count;
 	unsigned m_last_power;
 	bool was_set = false;
 
+	// Ramp
+	Vc::Timer t_ramp;
+	unsigned m_ramp_run = 0; // POM callbacks of older ramps are ignored
+	std::deque<RampPoint> m_ramp_powers; // acknowledged powers, oldest first
+	std::optional<unsigned> m_ramp_bucket; // power of speeds in m_measurement
+	double m_ramp_last_speed;
+	bool m_ramp_finishing;
+
 	void xn_pom_ok(void *, void *);
 	void xn_pom_err(void *, void *);
+	void wsm_speed_read(const Sb::Sample &);
+	void wsm_mark_read(const Sb::Sample &);
+	void lap_read(const Sb::Sample &);
+	void measurement_reset(size_t samples, unsigned revolutions);
+	void wsm_lt_error();
+	void wsm_error();
+	void speed_measured(double speed);
+	void wsm_disconnect();
 
 	std::unique_ptr<unsigned> next_step();
 
@@ -95,15 +174,29 @@ private:
 	void reset_step();
 	void pom_write_power(unsigned power, std::unique_ptr<Xn::Cb> ok = {}, std::unique_ptr<Xn::Cb> err = {});
 
+	void ramp_start();
+	void ramp_write();
+	void ramp_pom_ok(unsigned run);
+	void ramp_pom_err(unsigned run);
+	bool ramp_running(unsigned run) const;
+	void ramp_flush();
+	void ramp_done();
+	void wsm_ramp_read(const Sb::Sample &);
+	void ramp_disconnect();
+
+	void record(const char *event, std::initializer_list<Tr::Field> = {}) const;
+
 private slots:
-	void wsm_lt_read(double speed, double diffusion);
-	void wsm_lt_error();
+	void samples_added();
+	void samples_timeout();
 	void t_sp_adapt_tick();
+	void t_ramp_tick();
 
 signals:
 	void on_error(Co::Error, unsigned step);
 	void done();
 	void step_power_changed(unsigned step, unsigned power);
+	void power_tried(unsigned step, unsigned power); // once per power measured
 	void progress_update(size_t progress, size_t max);
 };
 
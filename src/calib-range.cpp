@@ -4,8 +4,11 @@
 
 namespace Cr {
 
-CalibRange::CalibRange(Xn::XpressNet &xn, Wsm::Wsm &wsm, QObject *parent)
-    : QObject(parent), m_xn(xn), m_wsm(wsm) {}
+CalibRange::CalibRange(Xn::XpressNet &xn, Wsm::Wsm &wsm, Sb::SampleBuffer &samples, QObject *parent)
+    : QObject(parent), m_xn(xn), m_wsm(wsm), m_samples(samples) {
+	QObject::connect(&samples, SIGNAL(sampleAdded(quint64)), this, SLOT(samples_added()));
+	QObject::connect(&samples, SIGNAL(speedReceiveTimeout()), this, SLOT(samples_timeout()));
+}
 
 void CalibRange::measure(const unsigned loco_addr, const unsigned step, Xn::Direction dir,
                          unsigned spkmph) {
@@ -32,18 +35,29 @@ void CalibRange::wsm_dist_read(double, uint32_t dist_raw) {
 	// Once the distance in read, stop the loco and record distance
     QObject::disconnect(&m_wsm, SIGNAL(distanceRead(double,uint32_t)), this,
                         SLOT(wsm_dist_read(double,uint32_t)));
-    QObject::connect(&m_wsm, SIGNAL(speedRead(double,uint16_t)), this,
-                     SLOT(wsm_speed_read(double,uint16_t)));
+	m_samples.seekHead();
+	m_decelerating = true;
 
 	loco_stop();
 	m_start_dist = dist_raw;
 }
 
-void CalibRange::wsm_speed_read(double speed, uint16_t) {
+void CalibRange::samples_added() {
+	Sb::Sample sample;
+	while (m_decelerating && m_samples.next(sample))
+		wsm_speed_read(sample.speed, sample.dist_raw);
+}
+
+void CalibRange::samples_timeout() {
+	if (m_measuring)
+		wsm_error();
+}
+
+void CalibRange::wsm_speed_read(double speed, uint32_t dist_raw) {
 	// Reading distance when decelarating
-	if (speed > 0 || m_end_dist != m_wsm.distRaw()) {
+	if (speed > 0 || m_end_dist != dist_raw) {
 		m_stop_counter = 0;
-		m_end_dist = m_wsm.distRaw();
+		m_end_dist = dist_raw;
 		return;
 	}
 	if (m_stop_counter < stop_min) {
@@ -52,11 +66,10 @@ void CalibRange::wsm_speed_read(double speed, uint16_t) {
 	}
 
 	// Loco stopped
-	QObject::disconnect(&m_wsm, SIGNAL(speedRead(double, uint16_t)), this,
-	                    SLOT(wsm_speed_read(double, uint16_t)));
-	QObject::disconnect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SLOT(wsm_error()));
+	m_decelerating = false;
+	m_measuring = false;
 
-	emit measured(m_wsm.calcDist(m_wsm.distRaw() - m_start_dist));
+	emit measured(m_wsm.calcDist(dist_raw - m_start_dist));
 }
 
 void CalibRange::wsm_lt_read(double speed, double diffusion) {
@@ -95,7 +108,7 @@ void CalibRange::xn_speed_ok(void *, void *) {
 	// Insert 'waiting of mark' here when neccessarry
     QObject::connect(&m_wsm, SIGNAL(longTermMeasureDone(double,double)), this,
                      SLOT(wsm_lt_read(double,double)));
-	QObject::connect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SLOT(wsm_error()));
+	m_measuring = true;
 	m_speed_err_count = 0;
 	start_lt();
 }
@@ -115,9 +128,8 @@ void CalibRange::disconnect_signals() {
 	                    SLOT(wsm_dist_read(double, uint32_t)));
 	QObject::disconnect(&m_wsm, SIGNAL(longTermMeasureDone(double, double)), this,
 	                    SLOT(wsm_lt_read(double, double)));
-	QObject::disconnect(&m_wsm, SIGNAL(speedRead(double, uint16_t)), this,
-	                    SLOT(wsm_speed_read(double, uint16_t)));
-	QObject::disconnect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SLOT(wsm_error()));
+	m_decelerating = false;
+	m_measuring = false;
 }
 
 } // namespace Cr
@@ -10,6 +10,8 @@ while decelerating from 'step' addr.
  3) Right when next distance fom WSM is measured, the 'IDLE' signal is sent to loco.
  4) Once the speed of the WSM decreses to 0 and some other time is elapsed
     (the loco may still very slowly move), the measured() event is called.
+    Speeds & distances while decelerating are read from the shared sample
+    buffer (sample-buffer.h).
 
 When any error happens, on_error event is called.
 */
@@ -19,6 +21,7 @@ When any error happens, on_error event is called.
 
 #include "lib/wsm/wsm.h"
 #include "lib/xn/xn.h"
+#include "sample-buffer.h"
 
 namespace Cr {
 
@@ -42,12 +45,16 @@ class CalibRange : public QObject {
 public:
 	unsigned stop_min = DEFAULT_STOP_MIN;
 
-	CalibRange(Xn::XpressNet &xn, Wsm::Wsm &wsm, QObject *parent = nullptr);
+	CalibRange(Xn::XpressNet &xn, Wsm::Wsm &wsm, Sb::SampleBuffer &samples,
+	           QObject *parent = nullptr);
 	void measure(unsigned loco_addr, unsigned step, Xn::Direction dir, unsigned spkmph);
 
 private:
 	Xn::XpressNet &m_xn;
 	Wsm::Wsm &m_wsm;
+	Sb::Reader m_samples;
+	bool m_decelerating = false; // samples go to wsm_speed_read
+	bool m_measuring = false; // WSM timeout is an error
 	Xn::Direction m_dir;
 	unsigned m_loco_addr;
 	unsigned m_step;
@@ -65,11 +72,13 @@ private:
 
 	void start_lt();
 	void disconnect_signals();
+	void wsm_speed_read(double speed, uint32_t dist_raw);
+	void wsm_error();
 
 private slots:
+	void samples_added();
+	void samples_timeout();
 	void wsm_dist_read(double dist, uint32_t dist_raw);
-	void wsm_speed_read(double speed, uint16_t speed_raw);
-	void wsm_error();
 	void wsm_lt_read(double speed, double diffusion);
 
 signals:
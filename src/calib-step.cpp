@@ -1,48 +1,180 @@
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include "calib-step.h"
 
 namespace Cs {
 
-CalibStep::CalibStep(Xn::XpressNet &xn, Pm::PowerToSpeedMap &pm, Wsm::Wsm &wsm, const NeighAsker &neighAsker,
-                     const SetPower &setPower, QObject *parent)
-    : QObject(parent), m_xn(xn), m_pm(pm), m_wsm(wsm), neighAsker(neighAsker), setPower(setPower) {
+CalibStep::CalibStep(Pq::PomQueue &pom, Pm::PowerToSpeedMap &pm, Wsm::Wsm &wsm, Sb::SampleBuffer &samples,
+                     const NeighAsker &neighAsker, const SetPower &setPower,
+                     const PowerBounds &powerBounds, QObject *parent)
+    : QObject(parent), m_pom(pom), m_pm(pm), m_wsm(wsm), m_samples(samples), neighAsker(neighAsker),
+      setPower(setPower), powerBounds(powerBounds) {
 	t_sp_adapt.setSingleShot(true);
 	QObject::connect(&t_sp_adapt, SIGNAL(timeout()), this, SLOT(t_sp_adapt_tick()));
+	QObject::connect(&samples, SIGNAL(sampleAdded(quint64)), this, SLOT(samples_added()));
+	QObject::connect(&samples, SIGNAL(speedReceiveTimeout()), this, SLOT(samples_timeout()));
 }
 
 void CalibStep::calibrate(const unsigned loco_addr, const unsigned step, const double speed) {
 	m_loco_addr = loco_addr;
 	m_step = step;
 	m_target_speed = speed;
-	m_diff_count = 0;
-	power_history.clear();
+	m_iterations = 0;
+	m_accepting = false;
+	m_stats = Mt::Counters();
+
+	m_too_slow.reset();
+	m_too_fast.reset();
+	m_last_side = 0;
+	m_slow_weight = 1;
+	m_fast_weight = 1;
+
+	// Calibrated neighbour steps bound the power of this step
+	std::tie(m_bound_min, m_bound_max) = powerBounds(m_step);
+	m_bound_min = std::max(m_bound_min, POWER_MIN);
+	m_bound_max = std::min(m_bound_max, POWER_MAX);
+	if (m_bound_min > m_bound_max) {
+		// Neighbours are not monotone (e.g. set manually) -> ignore them
+		m_bound_min = POWER_MIN;
+		m_bound_max = POWER_MAX;
+	}
+
+	record("start", {{"target", m_target_speed}, {"bound_min", m_bound_min},
+	                 {"bound_max", m_bound_max}});
 
+	std::optional<unsigned> power;
 	try {
-		m_last_power = m_pm.power(m_target_speed);
+		power = next_power();
 	}
 	catch (const Pm::ENoMap&) {
+		record("error", {{"error", "NoStep"}});
 		emit on_error(CsError::NoStep, m_step);
 		return;
 	}
 
-	set_power(m_last_power);
+	set_power(power.value());
 }
 
-void CalibStep::wsm_lt_read(double speed, double diffusion) {
-	wsm_lt_done();
+void CalibStep::samples_added() {
+	Sb::Sample sample;
+	while (m_listening != Listening::None && m_samples.next(sample)) {
+		if (m_listening == Listening::Settle)
+			wsm_settle_read(sample.speed);
+		else if (m_listening == Listening::Mark)
+			wsm_mark_read(sample);
+		else
+			wsm_speed_read(sample);
+	}
+}
+
+void CalibStep::samples_timeout() {
+	if (m_listening == Listening::None)
+		return;
+	// No more samples would come -> fail instead of waiting forever
+	wsm_lt_error();
+	record("error", {{"error", "WsmError"}});
+	emit on_error(CsError::WsmError, m_step);
+}
+
+void CalibStep::wsm_mark_read(const Sb::Sample &sample) {
+	const bool passed = m_mark.add(sample.time, sample.dist_raw);
+	const bool timeout = (m_mark.sinceMark(sample.time) >= mark_timeout);
+	if (!passed && !timeout)
+		return;
+
+	record("mark", {{"passed", passed}, {"position", track->position(sample.dist_raw)}});
+	m_laps = passed ? measure_laps : 0;
+	if (m_laps > 0) {
+		m_measurement.reset(speed_estimator, Se::UNLIMITED, 0, m_samples.buffer().tickSpeed(),
+		                    m_samples.buffer().ticksPerRevolution());
+		m_mark.reset(*track);
+	}
+	m_listening = Listening::Measure;
+	wsm_speed_read(sample); // window begins on the mark
+}
+
+void CalibStep::lap_read(const Sb::Sample &sample) {
+	m_measurement.add(sample.time, sample.speed, sample.dist_raw);
+	const bool passed = m_mark.add(sample.time, sample.dist_raw);
+	if (m_mark.passed() >= m_laps || (!passed && m_mark.sinceMark(sample.time) >= mark_timeout))
+		speed_measured(m_measurement.speed());
+}
+
+void CalibStep::wsm_speed_read(const Sb::Sample &sample) {
+	m_stats.samples++;
+	if (m_laps > 0) {
+		lap_read(sample);
+		return;
+	}
+	if (!m_measurement.add(sample.time, sample.speed, sample.dist_raw))
+		return; // aligned window changes on revolution boundaries only
 
-	if (diffusion > max_abs_diffusion && diffusion > speed*max_rel_diffusion) {
-		if (m_diff_count >= ADAPT_MAX_TICKS) {
+	const Se::RollingSpeed &window = m_measurement.window();
+	if (!window.full()) {
+		if (is_decided())
+			speed_measured(m_measurement.speed());
+		return;
+	}
+
+	if (!window.isStable(max_abs_diffusion, max_rel_diffusion)) {
+		if (m_diff_count >= ADAPT_MAX_TICKS*window.capacity()) {
+			wsm_lt_done();
+			record("error", {{"error", "LargeDiffusion"}, {"diffusion", window.diffusion()}});
 			emit on_error(CsError::LargeDiffusion, m_step);
 			return;
 		}
-		// Wait for speed...
+		// Wait for speed: slide the window by one sample (revolution)
 		m_diff_count++;
-		t_sp_adapt_tick();
+		m_stats.measure_repeats++;
 		return;
 	}
+
+	speed_measured(m_measurement.speed());
+}
+
+bool CalibStep::is_decided() {
+	// Sequential test: is it already certain whether the speed is
+	// close enough to target speed / too low / too high?
+	const Se::RollingSpeed &window = m_measurement.window();
+	if (early_stop_min == 0 || window.count() < std::max(early_stop_min, 2u))
+		return false;
+	if (!window.isStable(max_abs_diffusion, max_rel_diffusion))
+		return false;
+	if (speed_estimator == Se::Method::Samples && window.effectiveCount() < 2)
+		return false; // too few independent samples yet
+
+	// Interval is checked after each sample -> stricter z with each check
+	m_looks++;
+	const double mean = m_measurement.speed();
+	const double half_width = m_measurement.uncertainty(Se::repeatedZ(early_stop_z, m_looks));
+	const double tolerance = std::max(abs_deviation, m_target_speed * rel_deviation);
+
+	if (mean - half_width > m_target_speed - tolerance &&
+	    mean + half_width < m_target_speed + tolerance)
+		return true; // surely done
+	if (mean + half_width < m_target_speed - tolerance)
+		return true; // surely too slow
+	if (mean - half_width > m_target_speed + tolerance)
+		return true; // surely too fast
+	return false;
+}
+
+void CalibStep::speed_measured(double speed) {
+	wsm_lt_done();
+	const Se::RollingSpeed &window = m_measurement.window();
+	record("measured", {{"power", m_last_power}, {"speed", speed},
+	                    {"diffusion", window.diffusion()}, {"mean_error", window.meanError()},
+	                    {"uncertainty", m_measurement.uncertainty(early_stop_z)},
+	                    {"estimator", (speed_estimator == Se::Method::Distance) ? "distance" : "samples"},
+	                    {"samples", static_cast<unsigned>(m_measurement.samples().count())},
+	                    {"revolutions", m_measurement.aligned() ? static_cast<unsigned>(window.count()) : 0u},
+	                    {"laps", (m_laps > 0) ? m_mark.passed() : 0u},
+	                    {"repeats", m_diff_count}, {"early", (m_laps == 0) && !window.full()}});
+
 	if (speed == 0) {
+		record("error", {{"error", "LocoStopped"}});
 		emit on_error(CsError::LocoStopped, m_step);
 		return;
 	}
@@ -52,37 +184,130 @@ void CalibStep::wsm_lt_read(double speed, double diffusion) {
 	double speed_abs_deviation = std::abs(speed - m_target_speed);
 	if (speed_abs_deviation < abs_deviation ||
 	    speed_abs_deviation <= m_target_speed * rel_deviation) {
+		record("done", {{"power", m_last_power}, {"iterations", m_iterations}});
 		emit done(m_step, m_last_power);
 		return;
 	}
 
-	if (is_oscilating()) {
-		emit on_error(CsError::Oscilation, speed);
+	if (m_iterations >= MAX_ITERATIONS) {
+		record("error", {{"error", "Oscilation"}});
+		emit on_error(CsError::Oscilation, m_step);
 		return;
 	}
 
-	unsigned new_power;
+	update_bracket(m_last_power, speed);
+
+	std::optional<unsigned> new_power;
 	try {
-		new_power = m_pm.power(m_target_speed);
+		new_power = next_power();
 	}
 	catch (const Pm::ENoMap&) {
+		record("error", {{"error", "NoStep"}});
 		emit on_error(CsError::NoStep, m_step);
 		return;
 	}
 
-	// Manually increase step when step too small
-	if ((std::abs(static_cast<int>(m_last_power) - static_cast<int>(new_power))) < 1) {
-		if (new_power < m_last_power)
-			new_power = m_last_power - 1;
-		else
-			new_power = m_last_power + 1;
+	if (!new_power.has_value()) {
+		// Target speed lies between two neighbouring powers
+		accept_closest();
+		return;
 	}
 
-	set_power(new_power);
+	set_power(new_power.value());
+}
+
+void CalibStep::update_bracket(const unsigned power, const double speed) {
+	// Illinois: when the same side of the bracket is updated twice in
+	// a row, the other side is stuck -> halve its weight.
+	const bool both = m_too_slow.has_value() && m_too_fast.has_value();
+	if (speed < m_target_speed) {
+		if (!m_too_slow.has_value() || power > m_too_slow->power)
+			m_too_slow = Measured{power, speed};
+		m_slow_weight = 1;
+		if (both && m_last_side < 0)
+			m_fast_weight /= 2;
+		m_last_side = -1;
+	} else {
+		if (!m_too_fast.has_value() || power < m_too_fast->power)
+			m_too_fast = Measured{power, speed};
+		m_fast_weight = 1;
+		if (both && m_last_side > 0)
+			m_slow_weight /= 2;
+		m_last_side = 1;
+	}
+}
+
+std::optional<unsigned> CalibStep::next_power() const {
+	// Returns power strictly inside the bracket or nothing when bracket
+	// is too narrow. Throws Pm::ENoMap when no prediction is possible.
+	unsigned min = m_bound_min;
+	unsigned max = m_bound_max;
+	if (m_too_slow.has_value())
+		min = std::max(min, m_too_slow->power + 1);
+	if (m_too_fast.has_value() && m_too_fast->power > 0)
+		max = std::min(max, m_too_fast->power - 1);
+	if (min > max)
+		return {};
+
+	const bool stuck = (m_slow_weight < 1 || m_fast_weight < 1);
+	double power = -1;
+	if (!stuck) {
+		try {
+			power = m_pm.power(m_target_speed);
+		}
+		catch (const Pm::ENoMap&) {
+			if (!m_too_slow.has_value() || !m_too_fast.has_value())
+				throw;
+		}
+	}
+
+	const bool inside = (power > m_too_slow.value_or(Measured{0, 0}).power &&
+	                     (!m_too_fast.has_value() || power < m_too_fast->power));
+	if ((stuck || !inside) && m_too_slow.has_value() && m_too_fast.has_value()) {
+		// Regula falsi on (possibly weighted) bracket
+		const double f_slow = (m_too_slow->speed - m_target_speed) * m_slow_weight;
+		const double f_fast = (m_too_fast->speed - m_target_speed) * m_fast_weight;
+		power = m_too_slow->power - f_slow*(static_cast<double>(m_too_fast->power) -
+		                                    m_too_slow->power) / (f_fast - f_slow);
+	}
+
+	return static_cast<unsigned>(std::clamp<long>(std::lround(power), min, max));
+}
+
+void CalibStep::accept_closest() {
+	std::optional<Measured> best;
+	for (const auto &candidate : {m_too_slow, m_too_fast}) {
+		if (candidate.has_value() && candidate->power >= m_bound_min &&
+		    candidate->power <= m_bound_max && (!best.has_value() ||
+		    std::abs(candidate->speed - m_target_speed) < std::abs(best->speed - m_target_speed)))
+			best = candidate;
+	}
+
+	if (!best.has_value() || best->power == m_last_power) {
+		record("done", {{"power", m_last_power}, {"iterations", m_iterations}, {"closest", true}});
+		emit done(m_step, m_last_power);
+		return;
+	}
+
+	// Write the better power back to decoder, done once written
+	m_accepting = true;
+	set_power(best->power);
 }
 
 void CalibStep::set_power(unsigned power) {
 	m_last_power = power;
+	record("set_power", {
+		{"power", power},
+		{"iteration", m_iterations + 1},
+		{"too_slow", m_too_slow.has_value() ? static_cast<int>(m_too_slow->power) : -1},
+		{"too_fast", m_too_fast.has_value() ? static_cast<int>(m_too_fast->power) : -1},
+		{"slow_weight", m_slow_weight},
+		{"fast_weight", m_fast_weight},
+		{"bound_min", m_bound_min},
+		{"bound_max", m_bound_max},
+		{"accepting", m_accepting},
+	});
+	emit power_tried(m_step, m_last_power);
 	emit step_power_changed(m_step, m_last_power); // to calculate neighbor steps correctly
 
 	// Set also neighbour speeds: -1, +1
@@ -99,12 +324,13 @@ void CalibStep::set_power(unsigned power) {
 		std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_pom_ok(s, d); }),
 		std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_pom_err(s, d); })
 	);
-	power_history.push_back(m_last_power);
+	m_iterations++;
+	m_stats.iterations = m_iterations;
 }
 
 void CalibStep::pom_write_step(unsigned step, unsigned power, Xn::UPCb ok, Xn::UPCb err) {
 	if (power != this->setPower(step)) {
-		m_xn.pomWriteCv(
+		m_pom.pomWriteCv(
 			Xn::LocoAddr(m_loco_addr),
 			CV_CURVE_START - 1 + step,
 			power,
@@ -116,15 +342,36 @@ void CalibStep::pom_write_step(unsigned step, unsigned power, Xn::UPCb ok, Xn::U
 }
 
 void CalibStep::t_sp_adapt_tick() {
-    QObject::connect(&m_wsm, SIGNAL(longTermMeasureDone(double,double)), this,
-                     SLOT(wsm_lt_read(double,double)));
-	QObject::connect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SLOT(wsm_lt_error()));
-	try {
-		m_wsm.startLongTermMeasure(measure_count);
-	}
-	catch (const Wsm::QStrException& e) {
-		wsm_lt_done();
+	const bool settled = t_sp_adapt.isActive();
+	t_sp_adapt.stop();
+	settle_done();
+	record("adapted", {{"settled", settled}});
+
+	if (!m_wsm.connected() || !m_wsm.isSpeedOk()) {
+		record("error", {{"error", "WsmError"}});
 		emit on_error(CsError::WsmError, m_step);
+		return;
+	}
+
+	measure_start();
+}
+
+void CalibStep::measure_start() {
+	// Speed is estimated from WSM speed stream directly (no WSM long-term
+	// measure), so high diffusion costs just one sample, not whole window.
+	m_measurement.reset(speed_estimator, measure_count, measure_revolutions,
+	                    m_samples.buffer().tickSpeed(), m_samples.buffer().ticksPerRevolution());
+	m_laps = 0;
+	m_diff_count = 0;
+	m_looks = 0;
+	m_stats.measures++;
+	m_samples.seekHead();
+
+	if (track != nullptr && track->enabled()) {
+		m_mark.reset(*track);
+		m_listening = Listening::Mark;
+	} else {
+		m_listening = Listening::Measure;
 	}
 }
 
@@ -132,49 +379,63 @@ void CalibStep::xn_pom_ok(void *source, void *data) {
 	(void)source;
 	(void)data;
 
-	// Insert 'waiting of mark' here when neccessarry
+	if (m_accepting) {
+		record("done", {{"power", m_last_power}, {"iterations", m_iterations}, {"closest", true}});
+		emit done(m_step, m_last_power);
+		return;
+	}
+
+	// Waiting on the track mark follows the adaptation (measure_start)
 	t_sp_adapt.start(sp_adapt_timeout);
+
+	if (settle_window > 0) {
+		m_settle.window = settle_window;
+		m_settle.max_slope = settle_max_slope;
+		m_settle.reset();
+		m_samples.seekHead();
+		m_listening = Listening::Settle;
+	}
+}
+
+void CalibStep::wsm_settle_read(double speed) {
+	// Speed stopped trending -> do not wait for the rest of sp_adapt_timeout
+	if (m_settle.add(speed))
+		t_sp_adapt_tick();
+}
+
+void CalibStep::settle_done() {
+	if (m_listening == Listening::Settle)
+		m_listening = Listening::None;
 }
 
 void CalibStep::xn_pom_err(void *source, void *data) {
 	(void)source;
 	(void)data;
+	record("error", {{"error", "XnNoResponse"}});
 	emit on_error(CsError::XnNoResponse, m_step);
 }
 
 void CalibStep::wsm_lt_error() {
 	t_sp_adapt.stop();
+	settle_done();
 	wsm_lt_done();
 }
 
 void CalibStep::wsm_lt_done() {
-	QObject::disconnect(&m_wsm, SIGNAL(longTermMeasureDone(double, double)), this,
-	                    SLOT(wsm_lt_read(double, double)));
-	QObject::disconnect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SLOT(wsm_lt_error()));
+	if (m_listening == Listening::Mark || m_listening == Listening::Measure)
+		m_listening = Listening::None;
 }
 
 void CalibStep::stop() { wsm_lt_error(); }
 
-bool CalibStep::is_oscilating() const {
-	// Sometimes, it happens that sequence of powers is 87,86,87,86,...
-	// This function detects the behavior.
+const Mt::Counters &CalibStep::stats() const { return m_stats; }
 
-	if (power_history.size() < OSC_MAX_COUNT*2)
-		return false;
-
-	// Compare odd indexes
-	unsigned compared = power_history[power_history.size()-2];
-	for (size_t i = power_history.size() - OSC_MAX_COUNT*2; i < power_history.size(); i += 2)
-		if (power_history[i] != compared)
-			return false;
-
-	// Compare even indexes
-	compared = power_history[power_history.size()-1];
-	for (size_t i = power_history.size() - OSC_MAX_COUNT*2 + 1; i < power_history.size(); i += 2)
-		if (power_history[i] != compared)
-			return false;
-
-	return true;
+void CalibStep::record(const char *event, std::initializer_list<Tr::Field> fields) const {
+	if (trace == nullptr || !trace->enabled())
+		return;
+	std::vector<Tr::Field> all {{"loco", m_loco_addr}, {"step", m_step}};
+	all.insert(all.end(), fields.begin(), fields.end());
+	trace->record("cs", event, all);
 }
 
 } // namespace Cs
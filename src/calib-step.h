@@ -16,22 +16,55 @@ This class does NOT set speed step of a loco. Caller must set the calibrated
 speed step.
 
  1) Set power based on intended speed and power-to-speed graph.
- 2) Wait for speed adaptation for some constant time.
- 3) Wait for low-diffusion of a measured speed.
+ 2) Wait for speed adaptation: until the speed stops trending (see
+    settle-detector.h), but at most some constant time. When a track mark
+    is set (track-mark.h), wait for the loco to pass the mark too (at most
+    mark_timeout), so each measurement starts at the same position.
+ 3) Wait for low-diffusion of a measured speed (sliding window over speeds
+    from WSM read from the shared sample buffer, see speed-estimator.h &
+    sample-buffer.h). Measuring ends early (before
+    measure_count samples are collected) once the confidence interval of
+    the mean speed lies completely inside or completely outside of the
+    target deviation. The interval uses effective number of samples
+    (speeds are autocorrelated) and its z grows with each check (it is
+    checked after every sample, see Se::repeatedZ). With speed_estimator = Se::Method::Distance, speed
+    is distance over time of the window and the interval is +- one
+    distance tick. With measure_revolutions > 0, the window consists of
+    measure_revolutions whole wheel revolutions instead of measure_count
+    samples (early_stop_min counts revolutions then). With measure_laps > 0
+    and the mark passed, the window is measure_laps whole laps instead
+    (no early stop, no diffusion check; decided with the laps measured so
+    far when a lap takes longer than mark_timeout).
  4) Once diffusion is low, add new entry to power-to-speed graph.
     (a) When the meaured speed is epsilon-close to target speed,
         end calibration of the step.
     (b) Otherwise, GOTO 1).
+
+Powers are searched in a bracket: the highest power known to be too slow
+and the lowest power known to be too fast for the step are remembered.
+Powers of already calibrated neighbour steps are used as hard bounds.
+Each new power is chosen strictly inside the bracket (prediction from
+power-to-speed graph; Illinois-modified regula falsi when one side of the
+bracket got stuck), so the bracket shrinks in every iteration. When there
+is no power left inside the bracket (target speed lies between two integer
+powers), the power closer to the target speed is accepted.
 */
 
 #include <QObject>
-#include <QTimer>
-#include <vector>
 #include <functional>
+#include <optional>
 
+#include "calib-metrics.h"
+#include "clock.h"
 #include "lib/wsm/wsm.h"
 #include "lib/xn/xn.h"
+#include "pom-queue.h"
 #include "power-map.h"
+#include "sample-buffer.h"
+#include "settle-detector.h"
+#include "speed-estimator.h"
+#include "trace.h"
+#include "track-mark.h"
 #include "cvs.h"
 
 namespace Cs {
@@ -41,10 +74,19 @@ constexpr double DEFAULT_REL_DEVIATION = 0.025; // +- x %
 constexpr double DEFAULT_MAX_ABS_DIFFUSION = 1; // kmph
 constexpr double DEFAULT_MAX_REL_DIFFUSION = 0.06; // 6 %
 constexpr size_t DEFAULT_MEASURE_COUNT = 30; // measuring 30 values = 3 s
-constexpr unsigned DEFAULT_SP_ADAPT_TIMEOUT = 2000; // ms
-
-constexpr unsigned ADAPT_MAX_TICKS = 3; // maximum adaptation ticks
-constexpr unsigned OSC_MAX_COUNT = 3; // frame length for oscilation detection
+constexpr unsigned DEFAULT_MEASURE_REVOLUTIONS = 0; // 0 = window not aligned to revolutions
+constexpr unsigned DEFAULT_MARK_TIMEOUT = 20000; // ms, waiting for the track mark
+constexpr unsigned DEFAULT_MEASURE_LAPS = 0; // 0 = do not average over laps
+constexpr unsigned DEFAULT_EARLY_STOP_MIN = 8; // minimum samples for early decision, 0 = disabled
+constexpr double DEFAULT_EARLY_STOP_Z = 3; // confidence interval = mean +- z * standard error
+constexpr unsigned DEFAULT_SP_ADAPT_TIMEOUT = 2000; // ms, upper bound of speed adaptation
+constexpr unsigned DEFAULT_SETTLE_WINDOW = Sd::DEFAULT_WINDOW; // 0 = always wait sp_adapt_timeout
+constexpr double DEFAULT_SETTLE_MAX_SLOPE = Sd::DEFAULT_MAX_SLOPE; // kmph per second
+
+constexpr unsigned ADAPT_MAX_TICKS = 3; // maximum adaptation ticks (in windows of measure_count)
+constexpr unsigned MAX_ITERATIONS = 20; // safety limit of set power & measure cycles per step
+constexpr unsigned POWER_MIN = 1;
+constexpr unsigned POWER_MAX = 255;
 
 enum class CsError {
 	LargeDiffusion,
@@ -57,6 +99,19 @@ enum class CsError {
 
 using NeighAsker = std::function<unsigned(unsigned midldeStep, unsigned neighStep)>;
 using SetPower = std::function<unsigned(unsigned step)>;
+using PowerBounds = std::function<std::pair<unsigned, unsigned>(unsigned step)>; // [min, max]
+
+struct Measured {
+	unsigned power;
+	double speed;
+};
+
+enum class Listening {
+	None,
+	Settle, // samples go to wsm_settle_read
+	Mark, // samples go to wsm_mark_read
+	Measure, // samples go to wsm_speed_read
+};
 
 class CalibStep : public QObject {
 	Q_OBJECT
@@ -67,45 +122,88 @@ public:
 	double max_abs_diffusion = DEFAULT_MAX_ABS_DIFFUSION;
 	double max_rel_diffusion = DEFAULT_MAX_REL_DIFFUSION;
 	unsigned measure_count = DEFAULT_MEASURE_COUNT;
+	unsigned measure_revolutions = DEFAULT_MEASURE_REVOLUTIONS;
+	unsigned early_stop_min = DEFAULT_EARLY_STOP_MIN;
+	double early_stop_z = DEFAULT_EARLY_STOP_Z;
 	unsigned sp_adapt_timeout = DEFAULT_SP_ADAPT_TIMEOUT;
-
-	CalibStep(Xn::XpressNet &xn, Pm::PowerToSpeedMap &pm, Wsm::Wsm &wsm,
-		const NeighAsker &neighAsker, const SetPower &setPower, QObject *parent = nullptr);
+	unsigned settle_window = DEFAULT_SETTLE_WINDOW;
+	double settle_max_slope = DEFAULT_SETTLE_MAX_SLOPE;
+	Se::Method speed_estimator = Se::Method::Samples;
+	unsigned mark_timeout = DEFAULT_MARK_TIMEOUT;
+	unsigned measure_laps = DEFAULT_MEASURE_LAPS;
+	const Tm::TrackMark *track = nullptr; // nullptr = no mark
+	Tr::Trace *trace = nullptr;
+
+	CalibStep(Pq::PomQueue &pom, Pm::PowerToSpeedMap &pm, Wsm::Wsm &wsm, Sb::SampleBuffer &samples,
+		const NeighAsker &neighAsker, const SetPower &setPower, const PowerBounds &powerBounds,
+		QObject *parent = nullptr);
 	void calibrate(unsigned loco_addr, unsigned step, double speed);
 	void stop();
+	const Mt::Counters &stats() const; // counters of the last calibrate() (no time & POM)
 
 private:
-	Xn::XpressNet &m_xn;
+	Pq::PomQueue &m_pom;
 	Pm::PowerToSpeedMap &m_pm;
 	Wsm::Wsm &m_wsm;
+	Sb::Reader m_samples;
+	Listening m_listening = Listening::None;
 	unsigned m_loco_addr;
 	unsigned m_step;
 	double m_target_speed;
 	const NeighAsker neighAsker;
 	const SetPower setPower;
+	const PowerBounds powerBounds;
 
-	QTimer t_sp_adapt;
+	Vc::Timer t_sp_adapt;
+	Sd::SettleDetector m_settle;
+	Se::Measurement m_measurement;
+	Tm::MarkTracker m_mark;
+	unsigned m_laps = 0; // laps of current measurement, 0 = window of samples
 	unsigned m_last_power;
 	unsigned m_diff_count;
-
-	std::vector<unsigned> power_history;
+	unsigned m_looks = 0; // checks of the early stop in current measurement
+	unsigned m_iterations;
+	bool m_accepting;
+	Mt::Counters m_stats;
+
+	// Bracket
+	unsigned m_bound_min;
+	unsigned m_bound_max;
+	std::optional<Measured> m_too_slow;
+	std::optional<Measured> m_too_fast;
+	int m_last_side; // -1 = too slow updated, 1 = too fast updated
+	double m_slow_weight;
+	double m_fast_weight;
 
 	void xn_pom_ok(void *, void *);
 	void xn_pom_err(void *, void *);
-	bool is_oscilating() const;
+	void wsm_speed_read(const Sb::Sample &);
+	void wsm_settle_read(double speed);
+	void wsm_mark_read(const Sb::Sample &);
+	void lap_read(const Sb::Sample &);
+	void measure_start();
+	void wsm_lt_error();
+	void wsm_lt_done();
+	void speed_measured(double speed);
+	bool is_decided();
+	void settle_done();
+	void update_bracket(unsigned power, double speed);
+	std::optional<unsigned> next_power() const;
+	void accept_closest();
 	void set_power(unsigned power);
 	void pom_write_step(unsigned step, unsigned power, Xn::UPCb ok = {}, Xn::UPCb err = {});
+	void record(const char *event, std::initializer_list<Tr::Field> = {}) const;
 
 private slots:
-	void wsm_lt_read(double speed, double diffusion);
-	void wsm_lt_error();
-	void wsm_lt_done();
+	void samples_added();
+	void samples_timeout();
 	void t_sp_adapt_tick();
 
 signals:
 	void on_error(Cs::CsError, unsigned step);
 	void done(unsigned step, unsigned power);
 	void step_power_changed(unsigned step, unsigned power);
+	void power_tried(unsigned step, unsigned power); // once per iteration
 };
 
 } // namespace Cs
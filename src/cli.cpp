@@ -0,0 +1,105 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QTextStream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "headless-runner.h"
+
+/* Command-line calibration of a single loco or a batch of locos, see
+   headless-runner.h and batch-queue.h. */
+
+static const char *level_str(Cm::LogLevel level) {
+	switch (level) {
+		case Cm::LogLevel::Error: return "ERROR";
+		case Cm::LogLevel::Warning: return "WARN ";
+		case Cm::LogLevel::Success: return "OK   ";
+		default: return "INFO ";
+	}
+}
+
+int main(int argc, char *argv[]) {
+	QCoreApplication a(argc, argv);
+	QCoreApplication::setApplicationName("auto-calib-cli");
+	QCoreApplication::setApplicationVersion(QString::number(VERSION_MAJOR) + "." +
+	                                        QString::number(VERSION_MINOR));
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Automatic calibration of DCC locos without GUI.");
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.addOptions({
+		{{"a", "addr"}, "Loco address.", "addr"},
+		{{"d", "direction"}, "Direction of loco: forward or backward (default forward).", "dir",
+		 "forward"},
+		{{"c", "config"}, "Config file (default config.ini).", "file", "config.ini"},
+		{{"s", "speed"}, "Steps-to-speed csv file (default from config).", "file"},
+		{{"o", "output"}, "Output loco file (default loco-<addr>.xml).", "file"},
+		{{"m", "max-speed"}, "Max speed of loco in km/h (default from speed file).", "kmph"},
+		{{"b", "batch"}, "Calibrate all locos from manifest file (see batch-queue.h).", "file"},
+		{"stop-on-error", "Stop batch when any loco fails."},
+		{"reset", "Decoder was reset or replaced: forget its decoder image first."},
+		{{"t", "trace"}, "Record calibration trace to file (default from config).", "file"},
+	});
+	parser.process(a);
+
+	QTextStream err(stderr);
+	Hr::HeadlessRunner runner;
+	runner.config_filename = parser.value("config");
+	runner.stop_on_error = parser.isSet("stop-on-error");
+	runner.trace_filename = parser.value("trace");
+	if (parser.isSet("max-speed"))
+		runner.max_speed = parser.value("max-speed").toUInt();
+
+	if (parser.isSet("batch")) {
+		try {
+			runner.jobs = Bq::loadManifest(parser.value("batch"));
+		} catch (const Bq::EManifest &e) {
+			err << e.str() << Qt::endl;
+			return Hr::EXIT_CONFIG;
+		}
+	} else {
+		bool ok;
+		Bq::Job job;
+		job.addr = parser.value("addr").toUInt(&ok);
+		if (!parser.isSet("addr") || !ok || job.addr == 0 || job.addr > 9999) {
+			err << "Valid loco address (--addr) or batch manifest (--batch) must be specified!"
+			    << Qt::endl;
+			return Hr::EXIT_CONFIG;
+		}
+		const QString direction = parser.value("direction").toLower();
+		if (direction != "forward" && direction != "backward") {
+			err << "Direction must be 'forward' or 'backward'!" << Qt::endl;
+			return Hr::EXIT_CONFIG;
+		}
+		job.direction = (direction == "forward") ? Xn::Direction::Forward : Xn::Direction::Backward;
+		job.speed_file = parser.value("speed");
+		job.output = parser.value("output");
+		job.reset = parser.isSet("reset");
+		runner.jobs.push_back(job);
+	}
+
+	QObject::connect(&runner, &Hr::HeadlessRunner::onLog,
+	                 [&err](const QString &message, Cm::LogLevel level) {
+		err << level_str(level) << " " << message << Qt::endl;
+	});
+
+	// Loco swap: wait for operator to press Enter. Console stdin could not be
+	// watched by the event loop on Windows -> blocking read in a helper thread.
+	QObject::connect(&runner, &Hr::HeadlessRunner::onSwapNeeded, [&err, &runner](unsigned addr) {
+		err << "Put loco " << addr << " on the track and press Enter..." << Qt::endl;
+		std::thread([&runner]() {
+			std::string line;
+			std::getline(std::cin, line);
+			QMetaObject::invokeMethod(&runner, [&runner]() { runner.resume(); }, Qt::QueuedConnection);
+		}).detach(); // blocked thread must not keep the process alive
+	});
+
+	QObject::connect(&runner, &Hr::HeadlessRunner::onFinished,
+	                 [&a](int exit_code) { a.exit(exit_code); });
+
+	QTimer::singleShot(0, &runner, [&runner]() { runner.start(); });
+	return a.exec();
+}
@@ -0,0 +1,123 @@
+#include "clock.h"
+
+namespace Vc {
+
+static VirtualClock *s_virtual_clock = nullptr;
+
+VirtualClock *virtualClock() { return s_virtual_clock; }
+void setVirtualClock(VirtualClock *clock) { s_virtual_clock = clock; }
+
+///////////////////////////////////////////////////////////////////////////////
+
+qint64 VirtualClock::now() const { return m_now; }
+
+unsigned VirtualClock::schedule(const qint64 delay, std::function<void()> func) {
+	const unsigned id = m_next_id++;
+	const qint64 time = m_now + std::max<qint64>(delay, 0);
+	m_events.emplace(std::make_pair(time, id), std::move(func));
+	m_event_times.emplace(id, time);
+	return id;
+}
+
+void VirtualClock::cancel(const unsigned id) {
+	auto it = m_event_times.find(id);
+	if (it == m_event_times.end())
+		return;
+	m_events.erase(std::make_pair(it->second, id));
+	m_event_times.erase(it);
+}
+
+bool VirtualClock::step() {
+	if (m_events.empty())
+		return false;
+
+	auto first = m_events.begin();
+	m_now = first->first.first;
+	std::function<void()> func = std::move(first->second);
+	m_event_times.erase(first->first.second);
+	m_events.erase(first);
+
+	func();
+	return true;
+}
+
+bool VirtualClock::idle() const { return m_events.empty(); }
+size_t VirtualClock::pending() const { return m_events.size(); }
+
+///////////////////////////////////////////////////////////////////////////////
+
+qint64 now() {
+	if (s_virtual_clock != nullptr)
+		return s_virtual_clock->now();
+
+	// Called from GUI, worker & log threads: static initialization is thread-safe
+	static const QElapsedTimer monotonic = []() {
+		QElapsedTimer timer;
+		timer.start();
+		return timer;
+	}();
+	return monotonic.elapsed();
+}
+
+void singleShot(const int ms, std::function<void()> func) {
+	if (s_virtual_clock != nullptr)
+		s_virtual_clock->schedule(ms, std::move(func));
+	else
+		QTimer::singleShot(ms, std::move(func));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+Timer::Timer(QObject *parent) : QObject(parent) {
+	QObject::connect(&m_timer, &QTimer::timeout, this, &Timer::timeout);
+}
+
+Timer::~Timer() { stop(); }
+
+void Timer::setSingleShot(const bool single_shot) {
+	m_single_shot = single_shot;
+	m_timer.setSingleShot(single_shot);
+}
+
+void Timer::setInterval(const int ms) {
+	m_interval = ms;
+	m_timer.setInterval(ms);
+}
+
+void Timer::start(const int ms) {
+	setInterval(ms);
+	start();
+}
+
+void Timer::start() {
+	stop();
+	if (s_virtual_clock != nullptr)
+		scheduleVirtual();
+	else
+		m_timer.start();
+}
+
+void Timer::scheduleVirtual() {
+	m_virtual_event = s_virtual_clock->schedule(m_interval, [this]() {
+		m_virtual_event = 0;
+		if (!m_single_shot)
+			scheduleVirtual();
+		emit timeout();
+	});
+}
+
+void Timer::stop() {
+	m_timer.stop();
+	if (m_virtual_event != 0 && s_virtual_clock != nullptr)
+		s_virtual_clock->cancel(m_virtual_event);
+	m_virtual_event = 0;
+}
+
+bool Timer::isActive() const { return m_timer.isActive() || m_virtual_event != 0; }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ElapsedTimer::start() { m_start = now(); }
+qint64 ElapsedTimer::elapsed() const { return now() - m_start; }
+
+} // namespace Vc
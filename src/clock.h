@@ -0,0 +1,86 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+/*
+This file defines timers used by the calibration core. By default they are
+thin wrappers around QTimer & QElapsedTimer. When a virtual clock is
+installed (setVirtualClock), all timers run on the virtual clock instead:
+no real time passes, events are executed in order of their virtual time by
+VirtualClock::step. This allows to run the whole calibration against
+a simulated loco (see sim/) in milliseconds.
+
+ * Virtual clock is single-threaded, it must be installed before any timer
+   is started and must outlive all the timers.
+ * Events with the same virtual time are executed in order of scheduling.
+*/
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <functional>
+#include <map>
+#include <utility>
+
+namespace Vc {
+
+class VirtualClock {
+public:
+	qint64 now() const; // ms
+	unsigned schedule(qint64 delay, std::function<void()>); // returns event id
+	void cancel(unsigned id);
+	bool step(); // execute the earliest event, returns false when there is none
+	bool idle() const;
+	size_t pending() const;
+
+private:
+	qint64 m_now = 0;
+	unsigned m_next_id = 1;
+	std::map<std::pair<qint64, unsigned>, std::function<void()>> m_events; // (time, id)
+	std::map<unsigned, qint64> m_event_times; // id -> time
+};
+
+VirtualClock *virtualClock(); // nullptr = real time
+void setVirtualClock(VirtualClock *);
+
+qint64 now(); // ms, monotonic, could be used only for differences
+
+void singleShot(int ms, std::function<void()>);
+
+class Timer : public QObject {
+	Q_OBJECT
+
+public:
+	Timer(QObject *parent = nullptr);
+	~Timer() override;
+
+	void setSingleShot(bool);
+	void setInterval(int ms);
+	void start(int ms);
+	void start();
+	void stop();
+	bool isActive() const;
+
+private:
+	QTimer m_timer;
+	int m_interval = 0;
+	bool m_single_shot = false;
+	unsigned m_virtual_event = 0;
+
+	void scheduleVirtual();
+
+signals:
+	void timeout();
+};
+
+class ElapsedTimer {
+public:
+	void start();
+	qint64 elapsed() const; // ms
+
+private:
+	qint64 m_start = 0;
+};
+
+} // namespace Vc
+
+#endif
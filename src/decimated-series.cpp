@@ -0,0 +1,88 @@
+#include <algorithm>
+
+#include "decimated-series.h"
+
+namespace Ds {
+
+DecimatedSeries::DecimatedSeries(const size_t buckets, const double bucket_width)
+    : m_max_buckets(std::max<size_t>(buckets, 2)), m_initial_width(bucket_width),
+      m_width(bucket_width) {
+	m_buckets.reserve(m_max_buckets);
+}
+
+void DecimatedSeries::clear() {
+	m_buckets.clear();
+	m_width = m_initial_width;
+	m_last.reset();
+	m_count = 0;
+}
+
+double DecimatedSeries::bucketWidth() const { return m_width; }
+size_t DecimatedSeries::count() const { return m_count; }
+
+void DecimatedSeries::append(const double x, const double y) {
+	const QPointF point(std::max(x, 0.0), y);
+	while (static_cast<size_t>(point.x() / m_width) >= m_max_buckets)
+		this->compact();
+
+	const size_t index = static_cast<size_t>(point.x() / m_width);
+	if (index >= m_buckets.size())
+		m_buckets.resize(index+1);
+
+	Bucket &bucket = m_buckets[index];
+	if (!bucket.used) {
+		bucket.min = point;
+		bucket.max = point;
+		bucket.used = true;
+	} else if (y < bucket.min.y()) {
+		bucket.min = point;
+	} else if (y > bucket.max.y()) {
+		bucket.max = point;
+	}
+
+	m_last = point;
+	m_count++;
+}
+
+void DecimatedSeries::merge(Bucket &into, const Bucket &other) {
+	if (!other.used)
+		return;
+	if (!into.used) {
+		into = other;
+		return;
+	}
+	if (other.min.y() < into.min.y())
+		into.min = other.min;
+	if (other.max.y() > into.max.y())
+		into.max = other.max;
+}
+
+void DecimatedSeries::compact() {
+	for (size_t i = 0; i < m_buckets.size(); i += 2) {
+		Bucket bucket = m_buckets[i];
+		if (i+1 < m_buckets.size())
+			merge(bucket, m_buckets[i+1]);
+		m_buckets[i/2] = bucket;
+	}
+	m_buckets.resize((m_buckets.size()+1) / 2);
+	m_width *= 2;
+}
+
+QList<QPointF> DecimatedSeries::points() const {
+	QList<QPointF> result;
+	result.reserve(2*m_buckets.size() + 1);
+	for (const Bucket &bucket : m_buckets) {
+		if (!bucket.used)
+			continue;
+		const QPointF &first = (bucket.min.x() <= bucket.max.x()) ? bucket.min : bucket.max;
+		const QPointF &second = (bucket.min.x() <= bucket.max.x()) ? bucket.max : bucket.min;
+		result.append(first);
+		if (second != first)
+			result.append(second);
+	}
+	if (m_last.has_value() && (result.isEmpty() || result.back() != m_last.value()))
+		result.append(m_last.value());
+	return result;
+}
+
+} // namespace Ds
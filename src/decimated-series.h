@@ -0,0 +1,61 @@
+#ifndef DECIMATED_SERIES_H
+#define DECIMATED_SERIES_H
+
+/*
+This file defines a DecimatedSeries class: a time series of (x, y) points
+kept in constant memory, so a chart of the whole session (hours of 10 Hz
+WSM samples) renders in constant time.
+
+ * x axis is divided into at most 'buckets' buckets of equal width, each
+   bucket keeps only the minimum & the maximum point (min/max decimation:
+   spikes and oscillations stay visible, unlike with averaging).
+ * When x gets over the last bucket, bucket width is doubled and each two
+   neighbouring buckets are merged. Resolution thus degrades gracefully as
+   the series grows, memory never grows.
+ * The last appended point is always kept, so the live end of the series
+   shows the current value.
+ * x must not decrease (it is time), it starts at 0.
+*/
+
+#include <QList>
+#include <QPointF>
+#include <optional>
+#include <vector>
+
+namespace Ds {
+
+constexpr size_t DEFAULT_BUCKETS = 1024;
+constexpr double DEFAULT_BUCKET_WIDTH = 0.5; // x units
+
+class DecimatedSeries {
+public:
+	explicit DecimatedSeries(size_t buckets = DEFAULT_BUCKETS,
+	                         double bucket_width = DEFAULT_BUCKET_WIDTH);
+
+	void append(double x, double y);
+	void clear();
+	QList<QPointF> points() const; // at most 2*buckets+1 points ordered by x
+	double bucketWidth() const;
+	size_t count() const; // points appended since clear()
+
+private:
+	struct Bucket {
+		QPointF min;
+		QPointF max;
+		bool used = false;
+	};
+
+	const size_t m_max_buckets;
+	const double m_initial_width;
+	double m_width;
+	std::vector<Bucket> m_buckets;
+	std::optional<QPointF> m_last;
+	size_t m_count = 0;
+
+	void compact(); // merge neighbouring buckets (doubles bucket width)
+	static void merge(Bucket &into, const Bucket &);
+};
+
+} // namespace Ds
+
+#endif
@@ -0,0 +1,138 @@
+#include <QStringList>
+
+#include "decoder-image.h"
+
+namespace Di {
+
+/* Ini file format:
+   [loco<addr>]
+   cv<cv>=<value>;<known mask>;<source>;<ISO time>
+*/
+
+QString DecoderImage::group(const unsigned addr) { return "loco" + QString::number(addr); }
+
+void DecoderImage::open(const QString &filename) {
+	m_locos.clear();
+	m_settings = std::make_unique<QSettings>(filename, QSettings::IniFormat);
+
+	for (const QString &g : m_settings->childGroups()) {
+		if (!g.startsWith("loco"))
+			continue;
+		bool ok;
+		const unsigned addr = g.mid(4).toUInt(&ok);
+		if (!ok)
+			continue;
+
+		m_settings->beginGroup(g);
+		for (const QString &key : m_settings->childKeys()) {
+			const unsigned cv = key.mid(2).toUInt(&ok);
+			const QStringList parts = m_settings->value(key).toString().split(';');
+			if (!key.startsWith("cv") || !ok || parts.size() < 4)
+				continue;
+			m_locos[addr][cv] = Cv{
+				static_cast<uint8_t>(parts[0].toUInt()),
+				static_cast<uint8_t>(parts[1].toUInt()),
+				sourceFromStr(parts[2]),
+				QDateTime::fromString(parts[3], Qt::ISODate),
+			};
+		}
+		m_settings->endGroup();
+	}
+}
+
+void DecoderImage::sync() {
+	if (m_settings != nullptr)
+		m_settings->sync();
+}
+
+void DecoderImage::set(const unsigned addr, const unsigned cv, const uint8_t value, const Source source) {
+	m_locos[addr][cv] = Cv{value, 0xFF, source, QDateTime::currentDateTime()};
+	store(addr, cv);
+}
+
+void DecoderImage::setBit(const unsigned addr, const unsigned cv, const unsigned bit, const bool value,
+                          const Source source) {
+	auto &locoCvs = m_locos[addr];
+	if (locoCvs.find(cv) == locoCvs.end())
+		locoCvs[cv] = Cv{0, 0, source, {}};
+
+	Cv &entry = locoCvs[cv];
+	entry.value = (entry.value & ~(1 << bit)) | (value << bit);
+	entry.known |= (1 << bit);
+	entry.source = source;
+	entry.time = QDateTime::currentDateTime();
+	store(addr, cv);
+}
+
+void DecoderImage::forget(const unsigned addr, const unsigned cv) {
+	auto loco = m_locos.find(addr);
+	if (loco == m_locos.end() || loco->second.erase(cv) == 0)
+		return;
+	if (m_settings != nullptr)
+		m_settings->remove(group(addr) + "/cv" + QString::number(cv));
+}
+
+void DecoderImage::forget(const unsigned addr) {
+	m_locos.erase(addr);
+	if (m_settings != nullptr)
+		m_settings->remove(group(addr));
+}
+
+Cv const *DecoderImage::at(const unsigned addr, const unsigned cv) const {
+	auto loco = m_locos.find(addr);
+	if (loco == m_locos.end())
+		return nullptr;
+	auto entry = loco->second.find(cv);
+	if (entry == loco->second.end())
+		return nullptr;
+	return &entry->second;
+}
+
+bool DecoderImage::fresh(const Cv &entry) const {
+	if (max_age == 0)
+		return true;
+	return (entry.time.isValid() &&
+	        entry.time.secsTo(QDateTime::currentDateTime()) <= static_cast<qint64>(max_age)*3600);
+}
+
+bool DecoderImage::isKnown(const unsigned addr, const unsigned cv, const uint8_t value) const {
+	Cv const *entry = at(addr, cv);
+	return (entry != nullptr && fresh(*entry) && entry->known == 0xFF && entry->value == value);
+}
+
+bool DecoderImage::isBitKnown(const unsigned addr, const unsigned cv, const unsigned bit,
+                              const bool value) const {
+	Cv const *entry = at(addr, cv);
+	return (entry != nullptr && fresh(*entry) && ((entry->known >> bit) & 1) &&
+	        static_cast<bool>((entry->value >> bit) & 1) == value);
+}
+
+void DecoderImage::store(const unsigned addr, const unsigned cv) {
+	if (m_settings == nullptr)
+		return;
+	const Cv &entry = m_locos[addr][cv];
+	m_settings->setValue(
+		group(addr) + "/cv" + QString::number(cv),
+		QString::number(entry.value) + ";" + QString::number(entry.known) + ";" +
+		sourceToStr(entry.source) + ";" + entry.time.toString(Qt::ISODate)
+	);
+}
+
+QString DecoderImage::sourceToStr(const Source source) {
+	switch (source) {
+		case Source::Written: return "written";
+		case Source::Read: return "read";
+		case Source::Verified: return "verified";
+	}
+	return "";
+}
+
+Source DecoderImage::sourceFromStr(const QString &str) {
+	if (str == "read")
+		return Source::Read;
+	if (str == "verified")
+		return Source::Verified;
+	return Source::Written;
+}
+
+} // namespace Di
@@ -0,0 +1,78 @@
+#ifndef DECODER_IMAGE_H
+#define DECODER_IMAGE_H
+
+/*
+This file defines a DecoderImage class which remembers last known values of
+CVs of decoders (per loco address). The image is stored in an ini file, so it
+survives restarts of the application.
+
+ * For each CV, value, mask of known bits, source of the knowledge
+   (written/read/verified) and time of the last change is stored.
+ * CV is 'known' only when all its bits are known.
+ * Writes of values already known to be in the decoder could be skipped
+   (see pom-queue.h).
+ * When a write is sent, the CV is forgotten until the write is confirmed,
+   so the image never claims a value the decoder might not have.
+ * POM could not be read back, so stored values could not be verified: the
+   decoder might have been reset, swapped or changed from another throttle
+   since they were stored. Stored values are trusted (so resumed calibration
+   skips writes done before), they are invalidated only explicitly: when
+   the operator forgets the loco (decoder reset, another decoder on the
+   address), when a batch job swaps or resets the loco (batch-queue.h) or
+   when they are older than max_age hours.
+*/
+
+#include <QDateTime>
+#include <QSettings>
+#include <QString>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+namespace Di {
+
+enum class Source {
+	Written,
+	Read,
+	Verified,
+};
+
+struct Cv {
+	uint8_t value;
+	uint8_t known; // mask of known bits
+	Source source;
+	QDateTime time;
+};
+
+class DecoderImage {
+public:
+	bool skip_known = true; // skip writes of known values
+	unsigned max_age = 0; // hours, older values are not known, 0 = no limit
+
+	void open(const QString &filename);
+	void sync();
+
+	void set(unsigned addr, unsigned cv, uint8_t value, Source);
+	void setBit(unsigned addr, unsigned cv, unsigned bit, bool value, Source);
+	void forget(unsigned addr, unsigned cv);
+	void forget(unsigned addr);
+
+	Cv const *at(unsigned addr, unsigned cv) const;
+	bool isKnown(unsigned addr, unsigned cv, uint8_t value) const;
+	bool isBitKnown(unsigned addr, unsigned cv, unsigned bit, bool value) const;
+
+	static QString sourceToStr(Source);
+	static Source sourceFromStr(const QString &);
+
+private:
+	std::map<unsigned, std::map<unsigned, Cv>> m_locos; // addr -> cv -> Cv
+	std::unique_ptr<QSettings> m_settings;
+
+	bool fresh(const Cv &) const;
+	void store(unsigned addr, unsigned cv);
+	static QString group(unsigned addr);
+};
+
+} // namespace Di
+
+#endif
@@ -0,0 +1,170 @@
+#include "headless-runner.h"
+#include "calib-config.h"
+
+namespace Hr {
+
+HeadlessRunner::HeadlessRunner(QObject *parent)
+    : QObject(parent), m_cm(m_xn, m_pm, m_wsm, m_ssm), m_batch(m_cm, m_pm, m_ssm) {
+	m_cm.pom.image = &m_di;
+	m_cm.setTrace(&m_trace);
+
+	QObject::connect(&m_xn, SIGNAL(onConnect()), this, SLOT(xn_onConnect()));
+	QObject::connect(&m_xn, SIGNAL(onDisconnect()), this, SLOT(xn_onDisconnect()));
+	QObject::connect(&m_xn, SIGNAL(onError(QString)), this, SLOT(xn_onError(QString)));
+	QObject::connect(&m_xn, SIGNAL(onLog(QString, Xn::LogLevel)), this,
+	                 SLOT(xn_onLog(QString, Xn::LogLevel)));
+
+	QObject::connect(&m_wsm, SIGNAL(speedRead(double,uint16_t)), this,
+	                 SLOT(wsm_speed_read(double,uint16_t)));
+	QObject::connect(&m_wsm, SIGNAL(onError(QString)), this, SLOT(wsm_error(QString)));
+
+	QObject::connect(&m_cm, SIGNAL(onLog(const QString&, Cm::LogLevel)),
+	                 this, SLOT(cm_log(const QString&, Cm::LogLevel)));
+	QObject::connect(&m_cm, SIGNAL(onProgressUpdate(size_t)), this,
+	                 SLOT(cm_progress_update(size_t)));
+
+	QObject::connect(&m_batch, SIGNAL(onLog(const QString&, Cm::LogLevel)),
+	                 this, SLOT(cm_log(const QString&, Cm::LogLevel)));
+	QObject::connect(&m_batch, SIGNAL(onSwapNeeded(size_t)), this, SLOT(bq_swap_needed(size_t)));
+	QObject::connect(&m_batch, SIGNAL(onFinished(uint,uint)), this, SLOT(bq_finished(uint,uint)));
+
+	t_wsm.setSingleShot(true);
+	QObject::connect(&t_wsm, SIGNAL(timeout()), this, SLOT(t_wsm_tick()));
+}
+
+void HeadlessRunner::log(const QString &message, const Cm::LogLevel level) {
+	emit onLog(message, level);
+}
+
+void HeadlessRunner::finish(const ExitCode code) {
+	if (m_finished)
+		return;
+	m_finished = true;
+
+	t_wsm.stop();
+	if (m_batch.inProgress())
+		m_batch.stop();
+	if (m_wsm.connected())
+		m_wsm.disconnect();
+	if (m_xn.connected())
+		m_xn.disconnect();
+	m_di.sync();
+	m_trace.close();
+
+	emit onFinished(code);
+}
+
+void HeadlessRunner::start() {
+	try {
+		m_settings.load(config_filename);
+		Cc::applyXn(m_settings, m_xn);
+		Cc::applyWsm(m_settings["WSM"], m_wsm);
+		Cc::applyDecoderImage(m_settings, m_di);
+		Cc::applyCalib(m_settings, m_cm);
+		if (!trace_filename.isEmpty())
+			m_settings["Trace"]["file"] = trace_filename;
+		Cc::applyTrace(m_settings, m_trace);
+	} catch (const QStrException &e) {
+		log("Config load: " + e.str(), Cm::LogLevel::Error);
+		return finish(EXIT_CONFIG);
+	} catch (const Xn::QStrException &e) {
+		log("Config load: " + e.str(), Cm::LogLevel::Error);
+		return finish(EXIT_CONFIG);
+	}
+
+	if (jobs.empty()) {
+		log("Nothing to calibrate!", Cm::LogLevel::Error);
+		return finish(EXIT_CONFIG);
+	}
+
+	QString default_speed;
+	Settings::cfgToQString(m_settings["Speed"], "file", default_speed);
+	for (Bq::Job &job : jobs) {
+		if (job.speed_file.isEmpty())
+			job.speed_file = default_speed;
+		if (job.output.isEmpty())
+			job.output = "loco-" + QString::number(job.addr) + ".xml";
+	}
+	m_batch.jobs = jobs;
+	m_batch.max_speed = max_speed;
+	m_batch.stop_on_error = stop_on_error;
+
+	try {
+		log("Connecting to XpressNET...");
+		Cc::connectXn(m_settings, m_xn);
+	} catch (const Xn::QStrException &e) {
+		log("XpressNET connect error: " + e.str(), Cm::LogLevel::Error);
+		return finish(EXIT_CONNECTION);
+	}
+}
+
+void HeadlessRunner::xn_onConnect() {
+	log("Connected to XpressNET.");
+
+	try {
+		const QString port = m_settings["WSM"]["port"].toString();
+		m_wsm.connect(port);
+		log("Connected to WSM " + port + ", waiting for data...");
+	} catch (const Wsm::EOpenError &e) {
+		log("WSM connect error: " + e.str(), Cm::LogLevel::Error);
+		return finish(EXIT_CONNECTION);
+	}
+
+	t_wsm.start(wsm_timeout);
+}
+
+void HeadlessRunner::xn_onDisconnect() {
+	if (m_finished)
+		return;
+	log("Disconnected from XpressNET!", Cm::LogLevel::Error);
+	finish(EXIT_CONNECTION);
+}
+
+void HeadlessRunner::xn_onError(QString error) {
+	log("XpressNET error: " + error, Cm::LogLevel::Error);
+}
+
+void HeadlessRunner::xn_onLog(QString message, Xn::LogLevel loglevel) {
+	if (loglevel == Xn::LogLevel::Error)
+		log("XN: " + message, Cm::LogLevel::Error);
+	else if (loglevel == Xn::LogLevel::Warning)
+		log("XN: " + message, Cm::LogLevel::Warning);
+}
+
+void HeadlessRunner::wsm_speed_read(double, uint16_t) {
+	if (t_wsm.isActive() && m_wsm.isSpeedOk()) {
+		t_wsm.stop();
+		calibrate();
+	}
+}
+
+void HeadlessRunner::wsm_error(QString error) {
+	log("WSM serial port error: " + error + "!", Cm::LogLevel::Error);
+	finish(m_batch.inProgress() ? EXIT_CALIBRATION : EXIT_CONNECTION);
+}
+
+void HeadlessRunner::t_wsm_tick() {
+	log("No data from WSM!", Cm::LogLevel::Error);
+	finish(EXIT_CONNECTION);
+}
+
+void HeadlessRunner::calibrate() {
+	log("Calibrating " + QString::number(jobs.size()) + " loco(s)...");
+	m_batch.start();
+}
+
+void HeadlessRunner::resume() { m_batch.resume(); }
+
+void HeadlessRunner::bq_swap_needed(size_t job) { emit onSwapNeeded(m_batch.jobs[job].addr); }
+
+void HeadlessRunner::bq_finished(unsigned, unsigned failed) {
+	finish(failed > 0 ? EXIT_CALIBRATION : EXIT_OK);
+}
+
+void HeadlessRunner::cm_log(const QString &message, Cm::LogLevel level) {
+	emit onLog(message, level);
+}
+
+void HeadlessRunner::cm_progress_update(size_t val) { emit onProgressUpdate(val); }
+
+} // namespace Hr
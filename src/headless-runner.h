@@ -0,0 +1,103 @@
+#ifndef HEADLESS_RUNNER_H
+#define HEADLESS_RUNNER_H
+
+/*
+This file defines a HeadlessRunner class which runs the whole calibration of
+locos without GUI. It is used by the command-line tool (cli.cpp).
+
+ * Runner loads config file, connects to XpressNET and WSM, waits for first
+   data from WSM and runs calibration jobs in a batch queue (batch-queue.h).
+   Single-loco calibration is a batch with a single job.
+ * Jobs without speed profile use [Speed]/file from config, jobs without
+   output file save to loco-<addr>.xml.
+ * At the end, onFinished event with process exit code is always emitted.
+   WSM receive timeout during calibration fails the job (CmError::WsmError),
+   so an unattended run never hangs.
+ * Trace (trace.h) is written to [Trace]/file from config, trace_filename
+   overrides it.
+ * Config file is shared with GUI (calib-config.h), so both calibrate the same
+   way. Missing config values are not written back to the config file.
+*/
+
+#include <QObject>
+#include <QTimer>
+
+#include "batch-queue.h"
+#include "calib-man.h"
+#include "decoder-image.h"
+#include "lib/wsm/wsm.h"
+#include "lib/xn/xn.h"
+#include "power-map.h"
+#include "settings.h"
+#include "speed-map.h"
+#include "trace.h"
+
+namespace Hr {
+
+constexpr unsigned DEFAULT_WSM_TIMEOUT = 5000; // ms
+
+enum ExitCode {
+	EXIT_OK = 0,
+	EXIT_CONFIG = 1,
+	EXIT_CONNECTION = 2,
+	EXIT_CALIBRATION = 3,
+	EXIT_SAVE = 4,
+};
+
+class HeadlessRunner : public QObject {
+	Q_OBJECT
+
+public:
+	std::vector<Bq::Job> jobs;
+	QString config_filename = "config.ini";
+	unsigned max_speed = 0; // 0 = use max speed from speed file
+	bool stop_on_error = false;
+	unsigned wsm_timeout = DEFAULT_WSM_TIMEOUT;
+	QString trace_filename; // empty = from config
+
+	HeadlessRunner(QObject *parent = nullptr);
+
+	void start(); // asynchronous, ends with onFinished
+	void resume(); // continue after onSwapNeeded
+
+private:
+	Settings m_settings;
+	Xn::XpressNet m_xn;
+	Wsm::Wsm m_wsm;
+	Pm::PowerToSpeedMap m_pm;
+	Ssm::StepsToSpeedMap m_ssm;
+	Di::DecoderImage m_di;
+	Tr::Trace m_trace;
+	Cm::CalibMan m_cm;
+	Bq::BatchQueue m_batch;
+	QTimer t_wsm;
+	bool m_finished = false;
+
+	void finish(ExitCode);
+	void log(const QString &, Cm::LogLevel = Cm::LogLevel::Info);
+	void calibrate();
+
+private slots:
+	void xn_onConnect();
+	void xn_onDisconnect();
+	void xn_onError(QString error);
+	void xn_onLog(QString message, Xn::LogLevel);
+	void wsm_speed_read(double speed, uint16_t speed_raw);
+	void wsm_error(QString error);
+	void t_wsm_tick();
+
+	void cm_log(const QString &, Cm::LogLevel);
+	void cm_progress_update(size_t val);
+	void bq_swap_needed(size_t job);
+	void bq_finished(unsigned done, unsigned failed);
+
+signals:
+	void onLog(const QString &, Cm::LogLevel);
+	void onProgressUpdate(size_t val); // value 0-100
+	void onSwapNeeded(unsigned addr);
+	void onFinished(int exit_code);
+};
+
+} // namespace Hr
+
+#endif
@@ -0,0 +1,120 @@
+#include <QFile>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <utility>
+#include <vector>
+
+#include "loco-file.h"
+
+namespace Lf {
+
+void load(const QString &filename, LocoInfo &info, Pm::PowerToSpeedMap &pm) {
+	QXmlStreamReader xr;
+	QFile file(filename);
+	if (!file.open(QFile::ReadOnly | QFile::Text))
+		throw EFileError("Cannot read file " + filename);
+
+	xr.setDevice(&file);
+	xr.readNext();
+
+	while (!xr.atEnd()) {
+		if (xr.isStartElement()) {
+			if (xr.name() == QString("powerToSpeed")) {
+				xr.readNext();
+				while (xr.name() != QString("powerToSpeed")) {
+					if (xr.name() == QString("record") && xr.attributes().hasAttribute("power") &&
+						xr.attributes().hasAttribute("speed")) {
+						int power = xr.attributes().value("power").toInt();
+						float speed = xr.attributes().value("speed").toFloat();
+						pm.addOrUpdate(power, speed);
+					}
+					xr.readNext();
+				}
+			} else if (xr.name() == QString("dcclocoaddress") && xr.attributes().hasAttribute("number")) {
+				info.addr = xr.attributes().value("number").toUInt();
+			} else if (xr.name() == QString("locomotive") && xr.attributes().hasAttribute("maxSpeed")) {
+				info.max_speed = xr.attributes().value("maxSpeed").toUInt();
+			}
+		}
+
+		xr.readNext();
+	}
+}
+
+void save(QString filename, const LocoInfo &info, const Pm::PowerToSpeedMap &pm) {
+	if (!filename.endsWith(".xml"))
+		filename += ".xml";
+
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly))
+		throw EFileError("Cannot write file " + filename);
+
+	QXmlStreamWriter xw(&file);
+	xw.setAutoFormatting(true);
+	xw.writeStartDocument();
+	xw.writeDTD("<!DOCTYPE locomotive-config SYSTEM \"/xml/DTD/locomotive-config.dtd\">");
+
+	xw.writeStartElement("locomotive-config");
+	xw.writeStartElement("locomotive");
+	xw.writeAttribute("id", QString::number(info.addr));
+	xw.writeAttribute("dccAddress", QString::number(info.addr));
+	xw.writeAttribute("maxSpeed", QString::number(info.max_speed));
+
+	// We must save decoder model, otherwise JMRI crashes at start
+	xw.writeStartElement("decoder");
+	xw.writeAttribute("model", "MX658N18 version 32+"); // TODO: save decoder nicely?
+	xw.writeEndElement();
+
+	xw.writeStartElement("locoaddress");
+	xw.writeStartElement("dcclocoaddress");
+	xw.writeAttribute("number", QString::number(info.addr));
+	xw.writeAttribute("longaddress", "yes");
+	xw.writeEndElement();
+	xw.writeTextElement("number", QString::number(info.addr));
+	xw.writeTextElement("protocol", "dcc_long");
+	xw.writeEndElement();
+
+	xw.writeStartElement("values");
+	xw.writeStartElement("decoderDef");
+
+	QString steps = "";
+	for (const unsigned power : info.steps)
+		steps += QString::number(power) + ",";
+
+	std::vector<std::pair<QString, QString>> values = {
+		std::make_pair("Acceleration Rate", QString::number(info.accel)),
+		std::make_pair("Deceleration Rate", QString::number(info.decel)),
+		std::make_pair("Use Speed Table", "1"),
+		std::make_pair("Speed Table", std::move(steps)),
+		std::make_pair("Vhigh", QString::number(info.vmax)),
+		std::make_pair("Vmid", "60"),
+		std::make_pair("Vstart", "1"),
+	};
+
+	for (const auto &val : values) {
+		xw.writeStartElement("varValue");
+		xw.writeAttribute("item", val.first);
+		xw.writeAttribute("value", val.second);
+		xw.writeEndElement();
+	}
+
+	xw.writeEndElement();
+	xw.writeEndElement();
+
+	xw.writeStartElement("powerToSpeed");
+	for (size_t i = 0; i < Pm::POWER_CNT; i++) {
+		if (nullptr != pm.speed(i)) {
+			xw.writeStartElement("record");
+			xw.writeAttribute("power", QString::number(i));
+			xw.writeAttribute("speed", QString::number(*pm.speed(i)));
+			xw.writeEndElement();
+		}
+	}
+	xw.writeEndElement();
+
+	xw.writeEndElement();
+	xw.writeEndElement();
+	file.close();
+}
+
+} // namespace Lf
@@ -0,0 +1,37 @@
+#ifndef LOCO_FILE_H
+#define LOCO_FILE_H
+
+/*
+This file defines functions for loading and saving a loco file. Loco file is
+a JMRI locomotive-config xml file with calibrated speed table and additional
+<powerToSpeed> element with measured power-to-speed records.
+*/
+
+#include <QString>
+#include <array>
+
+#include "lib/q-str-exception.h"
+#include "lib/xn/xn.h"
+#include "power-map.h"
+
+namespace Lf {
+
+struct EFileError : public QStrException {
+	EFileError(const QString str) : QStrException(str) {}
+};
+
+struct LocoInfo {
+	unsigned addr = 3;
+	unsigned max_speed = 0;
+	unsigned accel = 0;
+	unsigned decel = 0;
+	unsigned vmax = 255;
+	std::array<unsigned, Xn::_STEPS_CNT> steps {}; // powers of speed steps
+};
+
+void save(QString filename, const LocoInfo &, const Pm::PowerToSpeedMap &); // throws EFileError
+void load(const QString &filename, LocoInfo &, Pm::PowerToSpeedMap &); // throws EFileError
+
+} // namespace Lf
+
+#endif
@@ -0,0 +1,201 @@
+#include <QBrush>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+
+#include "log-model.h"
+
+namespace Lm {
+
+bool Filter::empty() const { return max_level == INT_MAX && text.isEmpty(); }
+
+bool Filter::matches(const int level, const QString &message) const {
+	return (level <= max_level && (text.isEmpty() || message.contains(text, Qt::CaseInsensitive)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+LogModel::LogModel(const size_t capacity, const bool newest_first, QObject *parent)
+    : QAbstractTableModel(parent), m_capacity(std::max<size_t>(capacity, 1)),
+      m_newest_first(newest_first) {
+	t_update.setSingleShot(true);
+	QObject::connect(&t_update, SIGNAL(timeout()), this, SLOT(t_update_tick()));
+	QObject::connect(&m_filter_watcher, SIGNAL(finished()), this, SLOT(filter_done()));
+}
+
+quint64 LogModel::first() const {
+	return std::max(m_base, (m_next > m_capacity) ? m_next - m_capacity : 0);
+}
+
+const Entry &LogModel::entry(const quint64 seq) const { return m_ring[(seq - m_base) % m_capacity]; }
+
+quint64 LogModel::rowSeq(const int row) const {
+	return m_newest_first ? m_rows[m_rows.size()-1-row] : m_rows[row];
+}
+
+size_t LogModel::size() const { return m_next - first(); }
+
+void LogModel::append(Entry entry) {
+	m_pending.push_back(std::move(entry));
+	if (!t_update.isActive())
+		t_update.start(UPDATE_INTERVAL);
+}
+
+void LogModel::t_update_tick() {
+	if (m_pending.empty())
+		return;
+
+	// Only the newest 'capacity' entries could be stored
+	if (m_pending.size() > m_capacity)
+		m_pending.erase(m_pending.begin(), m_pending.end() - m_capacity);
+
+	const quint64 next = m_next + m_pending.size();
+	evict(std::max(m_base, (next > m_capacity) ? next - m_capacity : 0));
+
+	std::vector<quint64> added;
+	for (Entry &e : m_pending) {
+		const quint64 seq = m_next++;
+		if (!m_filtering && m_filter.matches(e.level, e.message))
+			added.push_back(seq);
+		if (m_ring.size() < m_capacity)
+			m_ring.push_back(std::move(e));
+		else
+			m_ring[(seq - m_base) % m_capacity] = std::move(e);
+	}
+	m_pending.clear();
+
+	if (added.empty())
+		return;
+	const int count = static_cast<int>(added.size());
+	const int rows = static_cast<int>(m_rows.size());
+	if (m_newest_first)
+		beginInsertRows(QModelIndex(), 0, count-1);
+	else
+		beginInsertRows(QModelIndex(), rows, rows+count-1);
+	m_rows.insert(m_rows.end(), added.begin(), added.end());
+	endInsertRows();
+}
+
+void LogModel::evict(const quint64 new_first) {
+	// Entries older than 'new_first' are going to be overwritten
+	const auto end = std::lower_bound(m_rows.begin(), m_rows.end(), new_first);
+	const int count = static_cast<int>(end - m_rows.begin());
+	if (count == 0)
+		return;
+
+	const int rows = static_cast<int>(m_rows.size());
+	if (m_newest_first)
+		beginRemoveRows(QModelIndex(), rows-count, rows-1);
+	else
+		beginRemoveRows(QModelIndex(), 0, count-1);
+	m_rows.erase(m_rows.begin(), end);
+	endRemoveRows();
+}
+
+void LogModel::clear() {
+	m_generation++; // result of running filter is obsolete
+	m_filtering = false;
+	beginResetModel();
+	m_ring.clear();
+	m_rows.clear();
+	m_pending.clear();
+	m_base = m_next;
+	endResetModel();
+}
+
+void LogModel::setFilter(const Filter &filter) {
+	t_update_tick(); // filter everything stored so far at once
+	m_filter = filter;
+	m_generation++;
+
+	if (filter.empty()) {
+		m_filtering = false;
+		beginResetModel();
+		m_rows.clear();
+		for (quint64 seq = first(); seq < m_next; seq++)
+			m_rows.push_back(seq);
+		endResetModel();
+		return;
+	}
+
+	// Snapshot (QStrings are implicitly shared -> cheap to copy)
+	const quint64 start = first();
+	std::vector<int> levels;
+	std::vector<QString> messages;
+	levels.reserve(m_next - start);
+	messages.reserve(m_next - start);
+	for (quint64 seq = start; seq < m_next; seq++) {
+		levels.push_back(entry(seq).level);
+		messages.push_back(entry(seq).message);
+	}
+
+	m_filtering = true;
+	const unsigned generation = m_generation;
+	const quint64 end = m_next;
+	m_filter_watcher.setFuture(QtConcurrent::run(
+		[generation, start, end, filter, levels = std::move(levels),
+		 messages = std::move(messages)]() {
+			FilterResult result{generation, end, {}};
+			for (size_t i = 0; i < levels.size(); i++)
+				if (filter.matches(levels[i], messages[i]))
+					result.rows.push_back(start + i);
+			return result;
+		}
+	));
+}
+
+void LogModel::filter_done() {
+	const FilterResult result = m_filter_watcher.result();
+	if (result.generation != m_generation)
+		return; // filter changed meanwhile
+
+	m_filtering = false;
+	beginResetModel();
+	m_rows.clear();
+	const quint64 start = first();
+	for (const quint64 seq : result.rows)
+		if (seq >= start)
+			m_rows.push_back(seq);
+	for (quint64 seq = std::max(result.end, start); seq < m_next; seq++)
+		if (m_filter.matches(entry(seq).level, entry(seq).message))
+			m_rows.push_back(seq);
+	endResetModel();
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const {
+	return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+}
+
+int LogModel::columnCount(const QModelIndex &parent) const {
+	return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+QVariant LogModel::data(const QModelIndex &index, const int role) const {
+	if (!index.isValid() || index.row() >= static_cast<int>(m_rows.size()))
+		return QVariant();
+
+	const Entry &e = entry(rowSeq(index.row()));
+	if (role == Qt::DisplayRole || (role == Qt::ToolTipRole && index.column() == Message)) {
+		switch (index.column()) {
+			case Time: return e.time;
+			case Level: return e.level_name;
+			case Message: return e.message;
+		}
+	}
+	if (role == Qt::BackgroundRole && e.color.isValid())
+		return QBrush(e.color);
+	return QVariant();
+}
+
+QVariant LogModel::headerData(const int section, const Qt::Orientation orientation,
+                              const int role) const {
+	if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+		return QVariant();
+	switch (section) {
+		case Time: return tr("Time");
+		case Level: return tr("Loglevel");
+		case Message: return tr("Message");
+	}
+	return QVariant();
+}
+
+} // namespace Lm
@@ -0,0 +1,108 @@
+#ifndef LOG_MODEL_H
+#define LOG_MODEL_H
+
+/*
+This file defines a LogModel class: a fixed-capacity ring buffer of log
+entries exposed as a Qt item model, so log views (QTreeView with uniform
+row heights) render only the visible rows.
+
+ * Memory is constant: once 'capacity' entries are stored, the oldest entry
+   is dropped for each new one. History is never cleared as a whole.
+ * append() only queues the entry; queued entries are inserted to the model
+   in batches each update_interval ms (one insert & one remove notification
+   per batch, not per line).
+ * Filter (maximum level & case-insensitive text) is evaluated on a worker
+   thread over a snapshot of the buffer; entries appended meanwhile are
+   filtered once the result arrives. Until then, the old rows are shown.
+ * Rows are ordered oldest first, or newest first (newest_first).
+ * Level is a number, lower = more important (e.g. Xn::LogLevel).
+*/
+
+#include <QAbstractTableModel>
+#include <QColor>
+#include <QFutureWatcher>
+#include <QString>
+#include <QTimer>
+#include <climits>
+#include <deque>
+#include <vector>
+
+namespace Lm {
+
+constexpr size_t DEFAULT_CAPACITY = 100000; // entries
+constexpr unsigned UPDATE_INTERVAL = 100; // ms
+
+struct Entry {
+	QString time;
+	int level;
+	QString level_name;
+	QString message;
+	QColor color; // invalid = default background
+};
+
+struct Filter {
+	int max_level = INT_MAX;
+	QString text;
+
+	bool empty() const;
+	bool matches(int level, const QString &message) const;
+};
+
+struct FilterResult {
+	unsigned generation;
+	quint64 end; // sequence number after the last filtered entry
+	std::vector<quint64> rows;
+};
+
+class LogModel : public QAbstractTableModel {
+	Q_OBJECT
+
+public:
+	enum Column {
+		Time = 0,
+		Level = 1,
+		Message = 2,
+	};
+	static constexpr int COLUMN_COUNT = 3;
+
+	LogModel(size_t capacity = DEFAULT_CAPACITY, bool newest_first = false,
+	         QObject *parent = nullptr);
+
+	void append(Entry);
+	void clear();
+	void setFilter(const Filter &);
+	size_t size() const; // entries stored (without filter)
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+	QVariant data(const QModelIndex &, int role = Qt::DisplayRole) const override;
+	QVariant headerData(int section, Qt::Orientation, int role = Qt::DisplayRole) const override;
+
+private:
+	const size_t m_capacity;
+	const bool m_newest_first;
+	std::vector<Entry> m_ring;
+	quint64 m_next = 0; // sequence number of the next entry
+	quint64 m_base = 0; // sequence number of the first entry after clear()
+	std::deque<quint64> m_rows; // sequence numbers of shown entries, oldest first
+	std::vector<Entry> m_pending;
+	QTimer t_update;
+
+	Filter m_filter;
+	unsigned m_generation = 0;
+	bool m_filtering = false;
+	QFutureWatcher<FilterResult> m_filter_watcher;
+
+	quint64 first() const; // sequence number of the oldest stored entry
+	const Entry &entry(quint64 seq) const;
+	quint64 rowSeq(int row) const;
+	void evict(quint64 new_first);
+
+private slots:
+	void t_update_tick();
+	void filter_done();
+};
+
+} // namespace Lm
+
+#endif
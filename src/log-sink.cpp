@@ -0,0 +1,218 @@
+#include <QByteArray>
+#include <chrono>
+
+#include "log-sink.h"
+
+namespace Ls {
+
+static size_t roundUpPow2(size_t size) {
+	size_t result = 2;
+	while (result < size)
+		result *= 2;
+	return result;
+}
+
+LineQueue::LineQueue(const size_t size)
+    : m_slots(new Slot[roundUpPow2(size)]), m_mask(roundUpPow2(size) - 1) {
+	for (size_t i = 0; i <= m_mask; i++)
+		m_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+size_t LineQueue::capacity() const { return m_mask + 1; }
+
+bool LineQueue::push(std::string &&line) {
+	// Slot with sequence == pos is free for pos, sequence == pos+1 is filled
+	size_t pos = m_enqueue.load(std::memory_order_relaxed);
+	Slot *slot;
+	while (true) {
+		slot = &m_slots[pos & m_mask];
+		const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+		if (diff == 0) {
+			if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			return false; // full
+		} else {
+			pos = m_enqueue.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->line = std::move(line);
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+bool LineQueue::pop(std::string &line) {
+	Slot &slot = m_slots[m_dequeue & m_mask];
+	if (slot.sequence.load(std::memory_order_acquire) != m_dequeue + 1)
+		return false; // empty (or the producer has not finished yet)
+
+	line = std::move(slot.line);
+	slot.line.clear();
+	slot.sequence.store(m_dequeue + m_mask + 1, std::memory_order_release);
+	m_dequeue++;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Options::operator==(const Options &other) const {
+	return (memory_budget == other.memory_budget && max_size == other.max_size &&
+	        rotate_count == other.rotate_count && flush_interval == other.flush_interval);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+LogSink::LogSink(const size_t queue_size) : m_queue(queue_size) {
+	m_thread = std::thread([this]() { run(); });
+}
+
+LogSink::~LogSink() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+void LogSink::open(const QString &filename, const Options &options) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (filename == m_filename && options == m_options && !m_reopen)
+			return;
+		m_filename = filename;
+		m_options = options;
+		m_reopen = true;
+	}
+	m_memory_budget = options.memory_budget;
+	m_enabled = !filename.isEmpty();
+	m_wake.notify_one();
+}
+
+QString LogSink::filename() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_filename;
+}
+
+bool LogSink::enabled() const { return m_enabled; }
+unsigned LogSink::dropped() const { return m_dropped; }
+
+void LogSink::write(const QString &line) {
+	if (!m_enabled)
+		return;
+
+	std::string data = line.toUtf8().toStdString();
+	data += '\n';
+	const size_t size = data.size();
+
+	const size_t budget = m_memory_budget;
+	if (m_bytes.fetch_add(size) + size > budget || !m_queue.push(std::move(data))) {
+		// Writer does not keep up (e.g. slow disk) -> drop rather than block
+		m_bytes -= size;
+		m_dropped++;
+		m_dropped_pending++;
+		return;
+	}
+
+	if (m_bytes > budget/2 && !m_flush.exchange(true))
+		m_wake.notify_one(); // do not wait for flush_interval
+}
+
+void LogSink::run() {
+	while (true) {
+		bool reopen_needed;
+		bool stop;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait_for(lock, std::chrono::milliseconds(m_options.flush_interval),
+			                [this]() { return m_stop || m_reopen || m_flush; });
+			reopen_needed = m_reopen;
+			stop = m_stop;
+		}
+		m_flush = false; // before drain, so lines queued meanwhile wake us again
+
+		drain(); // lines written before open() belong to the old file
+		if (reopen_needed)
+			reopen();
+		if (stop) {
+			drain();
+			m_file.close();
+			return;
+		}
+	}
+}
+
+void LogSink::reopen() {
+	QString filename;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		filename = m_filename;
+		m_file_options = m_options;
+		m_reopen = false;
+	}
+
+	m_file.close();
+	if (filename.isEmpty())
+		return;
+	m_file.setFileName(filename);
+	m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+	m_size = m_file.size();
+	// When the file could not be opened, lines are discarded
+}
+
+void LogSink::drain() {
+	QByteArray buffer;
+	std::string line;
+	while (m_queue.pop(line)) {
+		m_bytes -= line.size();
+		if (!m_file.isOpen())
+			continue;
+
+		const qint64 max_size = m_file_options.max_size;
+		if (max_size > 0 && m_size > 0 && m_size + static_cast<qint64>(line.size()) > max_size) {
+			m_file.write(buffer);
+			buffer.clear();
+			rotate();
+			if (!m_file.isOpen())
+				continue;
+		}
+		buffer.append(line.data(), static_cast<int>(line.size()));
+		m_size += line.size();
+	}
+
+	const unsigned dropped = m_dropped_pending.exchange(0);
+	if (dropped > 0 && m_file.isOpen()) {
+		const QByteArray note = "... " + QByteArray::number(dropped) +
+		                        " log lines dropped (writer overloaded)\n";
+		buffer.append(note);
+		m_size += note.size();
+	}
+
+	if (m_file.isOpen() && !buffer.isEmpty()) {
+		m_file.write(buffer);
+		m_file.flush();
+	}
+}
+
+void LogSink::rotate() {
+	const QString filename = m_file.fileName();
+	const unsigned rotate_count = m_file_options.rotate_count;
+	m_file.close();
+
+	if (rotate_count == 0) {
+		QFile::remove(filename);
+	} else {
+		QFile::remove(filename + "." + QString::number(rotate_count));
+		for (unsigned i = rotate_count-1; i >= 1; i--)
+			QFile::rename(filename + "." + QString::number(i), filename + "." + QString::number(i+1));
+		QFile::rename(filename, filename + ".1");
+	}
+
+	m_file.setFileName(filename);
+	m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+	m_size = 0;
+}
+
+} // namespace Ls
@@ -0,0 +1,112 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+/*
+This file defines a LogSink class which writes log lines to a file in
+a background thread, so logging never blocks the thread which drives the
+calibration (GUI thread with its timers).
+
+ * write() only moves the line into a bounded lock-free queue (LineQueue),
+   it never blocks and never does a syscall.
+ * Writer thread wakes each flush_interval ms (or earlier when the queue is
+   getting full), writes all queued lines at once and flushes the file.
+ * Memory is bounded: at most memory_budget bytes of lines are queued, lines
+   over the budget are dropped and the number of dropped lines is written
+   to the file once there is space again.
+ * File is rotated once it exceeds max_size bytes: <file> -> <file>.1 ->
+   ... -> <file>.<rotate_count> (the oldest one is removed).
+ * Empty filename = logging to file disabled, lines are discarded.
+ * Options are passed to open(), so they are never changed under the hands
+   of the writer thread.
+*/
+
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Ls {
+
+constexpr size_t DEFAULT_QUEUE_SIZE = 4096; // lines, rounded up to power of 2
+constexpr size_t DEFAULT_MEMORY_BUDGET = 1024*1024; // bytes
+constexpr qint64 DEFAULT_MAX_SIZE = 10*1024*1024; // bytes, 0 = no rotation
+constexpr unsigned DEFAULT_ROTATE_COUNT = 3;
+constexpr unsigned DEFAULT_FLUSH_INTERVAL = 200; // ms
+
+// Bounded multi-producer single-consumer lock-free queue of lines
+class LineQueue {
+public:
+	explicit LineQueue(size_t size);
+
+	bool push(std::string &&line); // false = queue full
+	bool pop(std::string &line); // single consumer only
+	size_t capacity() const;
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;
+		std::string line;
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	size_t m_mask;
+	std::atomic<size_t> m_enqueue{0};
+	size_t m_dequeue = 0;
+};
+
+struct Options {
+	size_t memory_budget = DEFAULT_MEMORY_BUDGET;
+	qint64 max_size = DEFAULT_MAX_SIZE;
+	unsigned rotate_count = DEFAULT_ROTATE_COUNT;
+	unsigned flush_interval = DEFAULT_FLUSH_INTERVAL;
+
+	bool operator==(const Options &) const;
+};
+
+class LogSink {
+public:
+	LogSink(size_t queue_size = DEFAULT_QUEUE_SIZE);
+	~LogSink(); // writes all queued lines
+
+	void open(const QString &filename, const Options & = {}); // empty filename = disabled
+	QString filename() const;
+	bool enabled() const;
+
+	void write(const QString &line); // newline is appended
+	unsigned dropped() const; // lines dropped since start
+
+private:
+	LineQueue m_queue;
+	std::thread m_thread;
+	std::atomic<bool> m_enabled{false};
+	std::atomic<size_t> m_memory_budget{DEFAULT_MEMORY_BUDGET};
+	std::atomic<bool> m_stop{false};
+	std::atomic<size_t> m_bytes{0}; // bytes queued
+	std::atomic<unsigned> m_dropped{0};
+	std::atomic<unsigned> m_dropped_pending{0}; // not reported to file yet
+	std::atomic<bool> m_flush{false}; // queue is getting full, drain now
+
+	mutable std::mutex m_mutex; // filename, options & wake-up
+	std::condition_variable m_wake;
+	QString m_filename;
+	Options m_options;
+	bool m_reopen = false;
+
+	// Writer thread only
+	QFile m_file;
+	qint64 m_size = 0; // size of the file incl. written buffer
+	Options m_file_options;
+
+	void run();
+	void drain();
+	void reopen();
+	void rotate();
+};
+
+} // namespace Ls
+
+#endif
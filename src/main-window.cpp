@@ -1,17 +1,46 @@
 #include <QFileDialog>
+#include <QHBoxLayout>
 #include <QMessageBox>
 #include <QSlider>
-#include <QXmlStreamWriter>
-#include <fstream>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <optional>
+#include <tuple>
 #include <utility>
 
+#include "loco-file.h"
 #include "main-window.h"
 #include "ui_main-window.h"
 
 const unsigned int WSM_BLINK_TIMEOUT = 250; // ms
 
+CalibCore::CalibCore() : cm(xn, pm, wsm, ssm), cr(xn, wsm, cm.samples), batch(cm, pm, ssm) {
+	cm.pom.image = &di;
+	cm.setTrace(&trace);
+}
+
+static void register_metatypes() {
+	// Arguments of signals delivered from the core thread (queued connections)
+	qRegisterMetaType<Xn::LogLevel>("Xn::LogLevel");
+	qRegisterMetaType<Xn::TrkStatus>("Xn::TrkStatus");
+	qRegisterMetaType<Cm::CmError>("Cm::CmError");
+	qRegisterMetaType<Cm::LogLevel>("Cm::LogLevel");
+	qRegisterMetaType<Cm::CalibState>("Cm::CalibState");
+	qRegisterMetaType<Cr::CrError>("Cr::CrError");
+	qRegisterMetaType<uint16_t>("uint16_t");
+	qRegisterMetaType<uint32_t>("uint32_t");
+	qRegisterMetaType<size_t>("size_t");
+}
+
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), xn(this), cm(xn, m_pm, wsm, m_ssm), cr(xn, wsm) {
+    : QMainWindow(parent), m_core_thread("calib-core"),
+      m_core(m_core_thread.call([]() { return std::make_unique<CalibCore>(); })),
+      xn(m_core->xn), wsm(m_core->wsm), m_di(m_core->di), m_trace(m_core->trace),
+      m_pm(m_core->pm), m_ssm(m_core->ssm), cm(m_core->cm), cr(m_core->cr),
+      m_batch(m_core->batch), m_stations(m_core->stations) {
+	register_metatypes();
 	ui.setupUi(this);
 	this->setWindowTitle(QString("Automatic Calibration v%1.%2").arg(VERSION_MAJOR).arg(VERSION_MINOR));
 	this->setFixedSize(this->size());
@@ -28,7 +57,10 @@ MainWindow::MainWindow(QWidget *parent)
 	                 SLOT(ssm_onAddOrUpdate(uint,uint)));
 	QObject::connect(&m_ssm, SIGNAL(onClear()), this, SLOT(ssm_onClear()));
 	a_speed_load(true);
-	m_ssm.setMaxSpeed(m_ssm.maxSpeedInFile());
+	const unsigned max_speed = core([this]() {
+		m_ssm.setMaxSpeed(m_ssm.maxSpeedInFile());
+		return m_ssm.maxSpeedInFile();
+	});
 
 	// XN init
 	QObject::connect(&xn, SIGNAL(onError(QString)), this, SLOT(xn_onError(QString)));
@@ -78,13 +110,27 @@ MainWindow::MainWindow(QWidget *parent)
 	QObject::connect(ui.a_debug1, SIGNAL(triggered(bool)), this, SLOT(a_debug1(bool)));
 	QObject::connect(ui.a_debug2, SIGNAL(triggered(bool)), this, SLOT(a_debug2(bool)));
 
-	ui.sb_max_speed->setValue(m_ssm.maxSpeedInFile());
+	ui.sb_max_speed->setValue(max_speed);
 	QObject::connect(ui.sb_max_speed, SIGNAL(valueChanged(int)), this,
 	                 SLOT(sb_max_speed_changed(int)));
-	QObject::connect(ui.lv_log, SIGNAL(itemDoubleClicked(QListWidgetItem*)), this,
-                     SLOT(lv_log_dblclick(QListWidgetItem*)));
-	QObject::connect(ui.tw_xn_log, SIGNAL(itemDoubleClicked(QTreeWidgetItem*,int)), this,
-	                 SLOT(tw_xn_log_dblclick(QTreeWidgetItem*,int)));
+	ui.tv_log->setModel(&m_log_model);
+	ui.tv_log->setColumnHidden(Lm::LogModel::Level, true);
+	ui.tv_log->setColumnWidth(Lm::LogModel::Time, 70);
+	ui.tv_xn_log->setModel(&m_xn_log_model);
+	ui.tv_xn_log->setColumnWidth(Lm::LogModel::Time, 100);
+	ui.tv_xn_log->setColumnWidth(Lm::LogModel::Level, 80);
+	QObject::connect(ui.tv_log, SIGNAL(doubleClicked(const QModelIndex&)), this,
+	                 SLOT(tv_log_dblclick(const QModelIndex&)));
+	QObject::connect(ui.tv_xn_log, SIGNAL(doubleClicked(const QModelIndex&)), this,
+	                 SLOT(tv_xn_log_dblclick(const QModelIndex&)));
+	QObject::connect(ui.cb_log_show, SIGNAL(currentIndexChanged(int)), this,
+	                 SLOT(log_filter_changed()));
+	QObject::connect(ui.le_log_filter, SIGNAL(textChanged(const QString&)), this,
+	                 SLOT(log_filter_changed()));
+	QObject::connect(ui.cb_xn_log_show, SIGNAL(currentIndexChanged(int)), this,
+	                 SLOT(xn_log_filter_changed()));
+	QObject::connect(ui.le_xn_log_filter, SIGNAL(textChanged(const QString&)), this,
+	                 SLOT(xn_log_filter_changed()));
 
 	t_xn_disconnect.setSingleShot(true);
 	QObject::connect(&t_xn_disconnect, SIGNAL(timeout()), this, SLOT(t_xn_disconnect_tick()));
@@ -113,7 +159,7 @@ MainWindow::MainWindow(QWidget *parent)
 
 	// XN UI
 	ui.cb_xn_loglevel->setCurrentIndex(s["XN"]["loglevel"].toInt());
-	xn.loglevel = static_cast<Xn::LogLevel>(s["XN"]["loglevel"].toInt());
+	core([this]() { xn.loglevel = static_cast<Xn::LogLevel>(s["XN"]["loglevel"].toInt()); });
 	QObject::connect(ui.cb_xn_loglevel, SIGNAL(currentIndexChanged(int)), this,
 	                 SLOT(cb_xn_ll_index_changed(int)));
 
@@ -129,12 +175,23 @@ MainWindow::MainWindow(QWidget *parent)
 	QObject::connect(ui.b_wsm_lt, SIGNAL(released()), this, SLOT(b_wsm_lt_handle()));
 
 	QObject::connect(ui.a_power_graph, SIGNAL(triggered(bool)), this, SLOT(a_power_graph(bool)));
+	QObject::connect(ui.a_speed_chart, SIGNAL(triggered(bool)), this, SLOT(a_speed_chart(bool)));
 	QObject::connect(ui.a_use_speed_table, SIGNAL(triggered(bool)), this, SLOT(a_use_speed_table(bool)));
+	QObject::connect(ui.a_di_forget, SIGNAL(triggered(bool)), this, SLOT(a_di_forget(bool)));
 	QObject::connect(ui.a_loco_load, SIGNAL(triggered(bool)), this, SLOT(a_loco_load(bool)));
 	QObject::connect(ui.a_loco_save, SIGNAL(triggered(bool)), this, SLOT(a_loco_save(bool)));
 	QObject::connect(ui.a_config_load, SIGNAL(triggered(bool)), this, SLOT(a_config_load(bool)));
 	QObject::connect(ui.a_config_save, SIGNAL(triggered(bool)), this, SLOT(a_config_save(bool)));
 	QObject::connect(ui.a_speed_load, SIGNAL(triggered(bool)), this, SLOT(a_speed_load(bool)));
+	QObject::connect(ui.a_batch_run, SIGNAL(triggered(bool)), this, SLOT(a_batch_run(bool)));
+	QObject::connect(ui.a_batch_stop, SIGNAL(triggered(bool)), this, SLOT(a_batch_stop(bool)));
+
+	// Batch queue
+	QObject::connect(&m_batch, SIGNAL(onJobStart(size_t)), this, SLOT(bq_job_start(size_t)));
+	QObject::connect(&m_batch, SIGNAL(onSwapNeeded(size_t)), this, SLOT(bq_swap_needed(size_t)));
+	QObject::connect(&m_batch, SIGNAL(onFinished(uint,uint)), this, SLOT(bq_finished(uint,uint)));
+	QObject::connect(&m_batch, SIGNAL(onLog(const QString&, Cm::LogLevel)),
+	                 this, SLOT(cm_onLog(const QString&, Cm::LogLevel)));
 
 	// WSM init
 	QObject::connect(&wsm, SIGNAL(speedRead(double,uint16_t)), this,
@@ -164,20 +221,25 @@ MainWindow::MainWindow(QWidget *parent)
 	QObject::connect(&cm, SIGNAL(onDone()), this, SLOT(cm_done()));
 	QObject::connect(&cm, SIGNAL(onStepPowerChanged(uint,uint)),
 	                 this, SLOT(cm_step_power_changed(uint,uint)));
+	QObject::connect(&cm, SIGNAL(onPowerTried(uint,uint,Cm::CalibState)),
+	                 this, SLOT(cm_power_tried(uint,uint,Cm::CalibState)));
 	QObject::connect(&cm, SIGNAL(onProgressUpdate(size_t)), this, SLOT(cm_progress_update(size_t)));
 
 	// Connect power-to-map with GUI
 	QObject::connect(&m_pm, SIGNAL(onAddOrUpdate(uint,float)), &w_pg,
 	                 SLOT(addOrUpdate(uint,float)));
 	QObject::connect(&m_pm, SIGNAL(onClear()), &w_pg, SLOT(clear()));
-	m_pm.clear();
+	core([this]() { m_pm.clear(); });
 
 	// Range Calibration
 	QObject::connect(&cr, SIGNAL(on_error(Cr::CrError,uint,QString)), this,
 	                 SLOT(cr_error(Cr::CrError,uint,QString)));
 	QObject::connect(&cr, SIGNAL(measured(double)), this, SLOT(cr_measured(double)));
 
+	stations_init();
+
 	w_pg.setAttribute(Qt::WA_QuitOnClose, false);
+	w_sc.setAttribute(Qt::WA_QuitOnClose, false);
 
 	ui.tw_main->setCurrentIndex(0);
 	log("Application launched.");
@@ -190,6 +252,14 @@ MainWindow::~MainWindow() {
 		                    SLOT(xn_onLog(QString, Xn::LogLevel)));
 		QObject::disconnect(&xn, SIGNAL(onDisconnect()), this, SLOT(xn_onDisconnect()));
 		a_config_save(true);
+		core([this]() { m_di.sync(); });
+	}
+	catch (...) {
+		// No exceptions in destructor!
+	}
+
+	try {
+		core([this]() { m_core.reset(); }); // objects must be destroyed in their thread
 	}
 	catch (...) {
 		// No exceptions in destructor!
@@ -221,7 +291,7 @@ void MainWindow::t_xn_disconnect_tick() {
 
 void MainWindow::cb_xn_ll_index_changed(int index) {
 	s["XN"]["loglevel"] = index;
-	xn.loglevel = static_cast<Xn::LogLevel>(index);
+	core([this, index]() { xn.loglevel = static_cast<Xn::LogLevel>(index); });
 }
 
 void MainWindow::show_error(const QString &error) {
@@ -230,21 +300,39 @@ void MainWindow::show_error(const QString &error) {
 }
 
 void MainWindow::b_start_handle() {
-	if (!xn.connected()) {
+	const auto [xn_connected, wsm_connected] = core([this]() {
+		return std::make_pair(xn.connected(), wsm.connected());
+	});
+	if (!xn_connected) {
 		m_starting = true;
 		a_xn_connect(true);
 	} else {
-		if (!wsm.connected())
+		if (!wsm_connected)
 			a_wsm_connect(true);
 	}
 }
 
-void MainWindow::lv_log_dblclick(QListWidgetItem *) {
-	ui.lv_log->clear();
+void MainWindow::tv_log_dblclick(const QModelIndex &) { m_log_model.clear(); }
+
+void MainWindow::tv_xn_log_dblclick(const QModelIndex &) { m_xn_log_model.clear(); }
+
+void MainWindow::log_filter_changed() {
+	// Show: All, Warnings & errors, Errors
+	constexpr std::array<int, 3> MAX_LEVELS = {
+		INT_MAX, static_cast<int>(Cm::LogLevel::Warning), static_cast<int>(Cm::LogLevel::Error)};
+	Lm::Filter filter;
+	filter.max_level = MAX_LEVELS[std::clamp(ui.cb_log_show->currentIndex(), 0, 2)];
+	filter.text = ui.le_log_filter->text();
+	m_log_model.setFilter(filter);
 }
 
-void MainWindow::tw_xn_log_dblclick(QTreeWidgetItem *, int) {
-	ui.tw_xn_log->clear();
+void MainWindow::xn_log_filter_changed() {
+	// Show up to: Error ... Debug (= everything)
+	Lm::Filter filter;
+	if (ui.cb_xn_log_show->currentIndex() < ui.cb_xn_log_show->count()-1)
+		filter.max_level = ui.cb_xn_log_show->currentIndex() + static_cast<int>(Xn::LogLevel::Error);
+	filter.text = ui.le_xn_log_filter->text();
+	m_xn_log_model.setFilter(filter);
 }
 
 void MainWindow::step_set_color(const unsigned stepi, const QColor &color) {
@@ -254,44 +342,52 @@ void MainWindow::step_set_color(const unsigned stepi, const QColor &color) {
 }
 
 void MainWindow::gui_update_enabled() {
+	const auto [xn_connected, wsm_connected, cm_in_progress, batch_in_progress] = core([this]() {
+		return std::make_tuple(xn.connected(), wsm.connected(), cm.inProgress(), m_batch.inProgress());
+	});
+
 	// WSM
-	ui.a_wsm_connect->setEnabled(!wsm.connected());
-	ui.a_wsm_disconnect->setEnabled(wsm.connected());
+	ui.a_wsm_connect->setEnabled(!wsm_connected);
+	ui.a_wsm_disconnect->setEnabled(wsm_connected);
 
 	// XpressNET
-	ui.a_xn_connect->setEnabled(!xn.connected());
-	ui.a_xn_disconnect->setEnabled(xn.connected());
-	ui.a_xn_dcc_go->setEnabled(xn.connected());
-	ui.a_xn_dcc_stop->setEnabled(xn.connected());
-	ui.gb_speed->setEnabled(xn.connected() && !cm.inProgress());
-
-	ui.gb_cal_graph->setEnabled(xn.connected() && !cm.inProgress());
-	ui.b_calib_start->setEnabled(!cm.inProgress());
-	ui.b_calib_stop->setEnabled(cm.inProgress());
-	ui.sb_max_speed->setEnabled(!cm.inProgress());
-	ui.sb_vmax->setEnabled(!cm.inProgress() && ui.chb_vmax->isChecked());
-	ui.b_vmax_read->setEnabled(xn.connected());
-	ui.sb_volt_ref->setEnabled(!cm.inProgress() && ui.chb_volt_ref->isChecked());
-	ui.b_volt_ref_read->setEnabled(xn.connected());
-	ui.gb_ad->setEnabled(xn.connected() && !cm.inProgress());
-	ui.b_wsm_lt->setEnabled(wsm.connected() && !cm.inProgress());
-	ui.a_loco_load->setEnabled(!cm.inProgress());
-	ui.a_speed_load->setEnabled(!cm.inProgress());
-	ui.b_reset->setEnabled(!cm.inProgress());
-	ui.b_verify_all_steps->setEnabled(xn.connected() && !cm.inProgress() && !this->verif_in_progress);
+	ui.a_xn_connect->setEnabled(!xn_connected);
+	ui.a_xn_disconnect->setEnabled(xn_connected);
+	ui.a_xn_dcc_go->setEnabled(xn_connected);
+	ui.a_xn_dcc_stop->setEnabled(xn_connected);
+	ui.gb_speed->setEnabled(xn_connected && !cm_in_progress);
+
+	ui.gb_cal_graph->setEnabled(xn_connected && !cm_in_progress);
+	ui.b_calib_start->setEnabled(!cm_in_progress && !batch_in_progress);
+	ui.b_calib_stop->setEnabled(cm_in_progress);
+	ui.sb_max_speed->setEnabled(!cm_in_progress);
+	ui.sb_vmax->setEnabled(!cm_in_progress && ui.chb_vmax->isChecked());
+	ui.b_vmax_read->setEnabled(xn_connected);
+	ui.sb_volt_ref->setEnabled(!cm_in_progress && ui.chb_volt_ref->isChecked());
+	ui.b_volt_ref_read->setEnabled(xn_connected);
+	ui.gb_ad->setEnabled(xn_connected && !cm_in_progress);
+	ui.b_wsm_lt->setEnabled(wsm_connected && !cm_in_progress);
+	ui.a_loco_load->setEnabled(!cm_in_progress);
+	ui.a_speed_load->setEnabled(!cm_in_progress && !batch_in_progress);
+	ui.a_batch_run->setEnabled(!cm_in_progress && !batch_in_progress);
+	ui.a_di_forget->setEnabled(!cm_in_progress && !batch_in_progress);
+	ui.a_batch_stop->setEnabled(batch_in_progress);
+	ui.b_reset->setEnabled(!cm_in_progress);
+	ui.b_verify_all_steps->setEnabled(xn_connected && !cm_in_progress && !this->verif_in_progress);
 
 	for (auto& ui_step : ui_steps)
-		gui_step_update_enabled(ui_step);
+		gui_step_update_enabled(ui_step, xn_connected, cm_in_progress);
 
-	if (!xn.connected()) {
+	if (!xn_connected) {
 		ui.b_addr_set->setEnabled(true);
 		ui.b_addr_release->setEnabled(false);
 	}
 }
 
-void MainWindow::gui_step_update_enabled(UiStep& ui_step) {
-	ui_step.slider->setEnabled(xn.connected() && !cm.inProgress() && ui_step.selected->isChecked());
-	ui_step.read->setEnabled(xn.connected() && !cm.inProgress());
+void MainWindow::gui_step_update_enabled(UiStep& ui_step, const bool xn_connected,
+                                         const bool cm_in_progress) {
+	ui_step.slider->setEnabled(xn_connected && !cm_in_progress && ui_step.selected->isChecked());
+	ui_step.read->setEnabled(xn_connected && !cm_in_progress);
 	ui_step.write->setEnabled(ui_step.selected->isChecked());
 }
 
@@ -301,53 +397,39 @@ void MainWindow::gui_step_update_enabled(UiStep& ui_step) {
 void MainWindow::xn_onError(const QString &error) {
 	xn_onLog(error, Xn::LogLevel::Error);
 
-	if (!t_xn_disconnect.isActive() && xn.connected())
+	if (!t_xn_disconnect.isActive() && core([this]() { return xn.connected(); }))
 		t_xn_disconnect.start(0);
 }
 
-void MainWindow::xn_onLog(const QString &message, const Xn::LogLevel &loglevel) {
-	constexpr size_t COLUMN_COUNT = 3;
-
-	if (ui.tw_xn_log->topLevelItemCount() > 300)
-		ui.tw_xn_log->clear();
+static QString xn_loglevel_name(const Xn::LogLevel loglevel) {
+	switch (loglevel) {
+		case Xn::LogLevel::None: return "None";
+		case Xn::LogLevel::Error: return "Error";
+		case Xn::LogLevel::Warning: return "Warning";
+		case Xn::LogLevel::Info: return "Info";
+		case Xn::LogLevel::Commands: return "Commands";
+		case Xn::LogLevel::RawData: return "Raw Data";
+		case Xn::LogLevel::Debug: return "Debug";
+	}
+	return "";
+}
 
-	auto *item = new QTreeWidgetItem(ui.tw_xn_log);
-	item->setText(0, QTime::currentTime().toString("hh:mm:ss.zzz"));
+void MainWindow::xn_onLog(const QString &message, const Xn::LogLevel &loglevel) {
+	Lm::Entry entry{QTime::currentTime().toString("hh:mm:ss.zzz"), static_cast<int>(loglevel),
+	                xn_loglevel_name(loglevel), message, QColor()};
 
 	if (message.startsWith("GET:"))
-		for (size_t i = 0; i < COLUMN_COUNT; i++)
-			item->setBackground(i, LOGC_GET);
+		entry.color = LOGC_GET;
 	if (message.startsWith("PUT:"))
-		for (size_t i = 0; i < COLUMN_COUNT; i++)
-			item->setBackground(i, LOGC_PUT);
-
-	if (loglevel == Xn::LogLevel::None)
-		item->setText(1, "None");
-	else if (loglevel == Xn::LogLevel::Error) {
-		item->setText(1, "Error");
-		for (size_t i = 0; i < COLUMN_COUNT; i++)
-			item->setBackground(i, LOGC_ERROR);
-	} else if (loglevel == Xn::LogLevel::Warning) {
-		item->setText(1, "Warning");
-		for (size_t i = 0; i < COLUMN_COUNT; i++)
-			item->setBackground(i, LOGC_WARN);
-	} else if (loglevel == Xn::LogLevel::Info)
-		item->setText(1, "Info");
-	else if (loglevel == Xn::LogLevel::Commands)
-		item->setText(1, "Commands");
-	else if (loglevel == Xn::LogLevel::RawData)
-		item->setText(1, "Raw Data");
-	else if (loglevel == Xn::LogLevel::Debug)
-		item->setText(1, "Debug");
-
-	item->setText(2, message);
-	ui.tw_xn_log->addTopLevelItem(item);
-
-	if (s["XN"]["logfile"] != "") {
-		std::ofstream out(s["XN"]["logfile"].toString().toUtf8().data(), std::ofstream::app);
-		out << QTime::currentTime().toString("hh:mm:ss.zzz").toUtf8().data() << ": "
-		    << message.toUtf8().data() << std::endl;
-	}
+		entry.color = LOGC_PUT;
+	if (loglevel == Xn::LogLevel::Error)
+		entry.color = LOGC_ERROR;
+	else if (loglevel == Xn::LogLevel::Warning)
+		entry.color = LOGC_WARN;
+
+	if (m_xn_log_sink.enabled())
+		m_xn_log_sink.write(entry.time + ": " + message);
+	m_xn_log_model.append(std::move(entry));
 
 	if (loglevel == Xn::LogLevel::Error)
 		this->log("XN: "+message, LOGC_ERROR);
@@ -377,10 +459,12 @@ void MainWindow::xn_onConnect() {
 	log("Connected to XpressNET.");
 
 	try {
-		xn.getLIVersion(
-			[this](void *s, unsigned hw, unsigned sw) { xn_gotLIVersion(s, hw, sw); },
-			std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_onLIVersionError(s, d); })
-		);
+		core([this]() {
+			xn.getLIVersion(
+				gui([this](void *s, unsigned hw, unsigned sw) { xn_gotLIVersion(s, hw, sw); }),
+				std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_onLIVersionError(s, d); }))
+			);
+		});
 	}
 	catch (const Xn::QStrException& e) {
 		show_error(e.str());
@@ -392,8 +476,13 @@ void MainWindow::xn_onDisconnect() {
 		verif_stop();
 		verif_reset();
 	}
-	if (cm.inProgress())
-		cm.stop();
+	core([this]() {
+		if (m_batch.inProgress())
+			m_batch.stop();
+		if (cm.inProgress())
+			cm.stop();
+	});
+	b_stations_stop_handle();
 	widget_set_color(*(ui.l_xn), Qt::red);
 	widget_set_color(*(ui.l_dcc), Qt::gray);
 	loco_released();
@@ -451,7 +540,7 @@ void MainWindow::xn_onCSStatusOk(void *, void *) {
 	if (m_starting) {
 		m_starting = false;
 		log("Succesfully connected to Command station");
-		if (!wsm.connected())
+		if (!core([this]() { return wsm.connected(); }))
 			a_wsm_connect(true);
 	}
 }
@@ -459,10 +548,12 @@ void MainWindow::xn_onCSStatusOk(void *, void *) {
 void MainWindow::xn_gotLIVersion(void *, unsigned hw, unsigned sw) {
 	log("Got LI version. HW: " + QString::number(hw) + ", SW: " + QString::number(sw));
 	try {
-		xn.getCommandStationStatus(
-			std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_onCSStatusOk(s, d); }),
-			std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_onCSStatusError(s, d); })
-		);
+		core([this]() {
+			xn.getCommandStationStatus(
+				std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_onCSStatusOk(s, d); })),
+				std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_onCSStatusError(s, d); }))
+			);
+		});
 	}
 	catch (const Xn::QStrException& e) {
 		show_error(e.str());
@@ -584,11 +675,13 @@ void MainWindow::xn_cvRead(void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t valu
 		catch (const Xn::EInvalidAddr&) {
 			show_error("Invalid address!");
 		}
-		xn.readCVdirect(
-			CV_ADDR_HI,
-			[this](void *s, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) { xn_cvRead(s, st, cv, value); },
-			std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_addrReadError(s, d); })
-		);
+		core([this]() {
+			xn.readCVdirect(
+				CV_ADDR_HI,
+				gui([this](void *s, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) { xn_cvRead(s, st, cv, value); }),
+				std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_addrReadError(s, d); }))
+			);
+		});
 	} else if (cv == CV_ADDR_HI) {
 		try {
 			ui.sb_loco->setValue(Xn::LocoAddr(ui.sb_loco->value(), value));
@@ -607,12 +700,16 @@ void MainWindow::xn_cvRead(void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t valu
 		ui.b_addr_read->setEnabled(true);
 		a_dcc_go(true);
 	} else if (cv == CV_ACCEL) {
+		di_update(cv, value, Di::Source::Read);
 		ui.sb_accel->setValue(value);
-		xn.readCVdirect(CV_DECEL,
-			[this](void *s, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) { xn_cvRead(s, st, cv, value); },
-			std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_adReadError(s, d); })
-		);
+		core([this]() {
+			xn.readCVdirect(CV_DECEL,
+				gui([this](void *s, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) { xn_cvRead(s, st, cv, value); }),
+				std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_adReadError(s, d); }))
+			);
+		});
 	} else if (cv == CV_DECEL) {
+		di_update(cv, value, Di::Source::Read);
 		ui.sb_decel->setValue(value);
 		ui.gb_ad->setEnabled(true);
 		a_dcc_go(true);
@@ -625,12 +722,19 @@ void MainWindow::xn_adWriteError(void *, void *) {
 }
 
 void MainWindow::xn_accelWritten(void *, void *) {
-	xn.pomWriteCv(Xn::LocoAddr(ui.sb_loco->value()), CV_DECEL, ui.sb_decel->value(),
-	              std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_decelWritten(s, d); }),
-	              std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_adWriteError(s, d); }));
+	di_update(CV_ACCEL, ui.sb_accel->value(), Di::Source::Written);
+	di_forget(CV_DECEL);
+	const unsigned addr = ui.sb_loco->value();
+	const unsigned decel = ui.sb_decel->value();
+	core([this, addr, decel]() {
+		xn.pomWriteCv(Xn::LocoAddr(addr), CV_DECEL, decel,
+		              std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_decelWritten(s, d); })),
+		              std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_adWriteError(s, d); })));
+	});
 }
 
 void MainWindow::xn_decelWritten(void *, void *) {
+	di_update(CV_DECEL, ui.sb_decel->value(), Di::Source::Written);
 	ui.gb_ad->setEnabled(true);
 }
 
@@ -648,16 +752,14 @@ void MainWindow::xn_stepWriteError(void *, void *d) {
 // XpressNET connect/disconnect
 
 void MainWindow::a_xn_connect(bool) {
-	if (xn.connected())
+	if (core([this]() { return xn.connected(); }))
 		return;
 
 	try {
 		widget_set_color(*(ui.l_xn), Qt::yellow);
 		log("Connecting to XN: "+s["XN"]["port"].toString()+":"+s["XN"]["interface"].toString()+":"+
 		    s["XN"]["baudrate"].toString()+"...");
-		xn.connect(s["XN"]["port"].toString(), s["XN"]["baudrate"].toInt(),
-		           static_cast<QSerialPort::FlowControl>(s["XN"]["flowcontrol"].toInt()),
-				   Xn::liInterface(s["XN"]["interface"].toString()));
+		core([this]() { Cc::connectXn(s, xn); });
 	} catch (const Xn::QStrException &e) {
 		widget_set_color(*(ui.l_xn), Qt::red);
 		show_error("XN connect error while opening serial port '" +
@@ -666,13 +768,13 @@ void MainWindow::a_xn_connect(bool) {
 }
 
 void MainWindow::a_xn_disconnect(bool) {
-	if (!xn.connected())
+	if (!core([this]() { return xn.connected(); }))
 		return;
 
 	try {
 		log("Disconnecting from XN...");
-		xn.disconnect();
-		if (cm.inProgress())
+		core([this]() { xn.disconnect(); });
+		if (core([this]() { return cm.inProgress(); }))
 			b_calib_stop_handle();
 	} catch (const Xn::QStrException &e) {
 		show_error("XN disconnect error:\n" + e.str());
@@ -681,11 +783,13 @@ void MainWindow::a_xn_disconnect(bool) {
 
 void MainWindow::a_dcc_go(bool) {
 	try {
-		if (xn.connected())
-			xn.setTrkStatus(
-				Xn::TrkStatus::On, nullptr,
-				std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_onDccGoError(s, d); })
-			);
+		core([this]() {
+			if (xn.connected())
+				xn.setTrkStatus(
+					Xn::TrkStatus::On, nullptr,
+					std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_onDccGoError(s, d); }))
+				);
+		});
 	} catch (const Xn::QStrException& e) {
 		show_error(e.str());
 	}
@@ -693,11 +797,13 @@ void MainWindow::a_dcc_go(bool) {
 
 void MainWindow::a_dcc_stop(bool) {
 	try {
-		if (xn.connected())
-			xn.setTrkStatus(
-				Xn::TrkStatus::Off, nullptr,
-				std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_onDccStopError(s, d); })
-			);
+		core([this]() {
+			if (xn.connected())
+				xn.setTrkStatus(
+					Xn::TrkStatus::Off, nullptr,
+					std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_onDccStopError(s, d); }))
+				);
+		});
 	} catch (const Xn::QStrException& e) {
 		show_error(e.str());
 	}
@@ -706,36 +812,39 @@ void MainWindow::a_dcc_stop(bool) {
 ///////////////////////////////////////////////////////////////////////////////
 
 void MainWindow::log(const QString &message, const QColor &color) {
-	if (ui.lv_log->count() > 200)
-		ui.lv_log->clear();
-	ui.lv_log->insertItem(0, QTime::currentTime().toString("hh:mm:ss") + ": " + message);
-	ui.lv_log->item(0)->setBackground(color);
+	const QTime time = QTime::currentTime();
+	Cm::LogLevel level = Cm::LogLevel::Info;
+	if (color == LOGC_ERROR)
+		level = Cm::LogLevel::Error;
+	else if (color == LOGC_WARN)
+		level = Cm::LogLevel::Warning;
+	m_log_model.append({time.toString("hh:mm:ss"), static_cast<int>(level), "", message, color});
 
-	if (s["Logging"]["file"] != "") {
-		std::ofstream out(s["Logging"]["file"].toString().toUtf8().data(), std::ofstream::app);
-		out << QTime::currentTime().toString("hh:mm:ss.zzz").toUtf8().data() << ": "
-		    << message.toUtf8().data() << std::endl;
-	}
+	if (m_log_sink.enabled())
+		m_log_sink.write(time.toString("hh:mm:ss.zzz") + ": " + message);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Speed settings
 
 void MainWindow::b_addr_set_handle() {
-	if (!xn.connected() || !ui.sb_loco->isEnabled())
+	if (!ui.sb_loco->isEnabled() || !core([this]() { return xn.connected(); }))
 		return;
 
 	ui.b_addr_set->setEnabled(false);
 	ui.sb_loco->setEnabled(false);
 	ui.b_addr_read->setEnabled(false);
 
-	xn.getLocoInfo(
-		Xn::LocoAddr(ui.sb_loco->value()),
-		[this](void *s, bool used, Xn::Direction dir, unsigned speed, Xn::FA fa, Xn::FB fb) {
-			xn_gotLocoInfo(s, used, dir, speed, fa, fb);
-		},
-		std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_onLocoInfoError(s, d); })
-	);
+	const unsigned addr = ui.sb_loco->value();
+	core([this, addr]() {
+		xn.getLocoInfo(
+			Xn::LocoAddr(addr),
+			gui([this](void *s, bool used, Xn::Direction dir, unsigned speed, Xn::FA fa, Xn::FB fb) {
+				xn_gotLocoInfo(s, used, dir, speed, fa, fb);
+			}),
+			std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_onLocoInfoError(s, d); }))
+		);
+	});
 }
 
 void MainWindow::sb_loco_changed(int) {
@@ -755,27 +864,31 @@ void MainWindow::b_addr_read_handle() {
 	ui.b_addr_set->setEnabled(false);
 	ui.b_addr_read->setEnabled(false);
 
-	xn.readCVdirect(
-		CV_BASIC_CONFIG,
-		[this](void*, Xn::ReadCVStatus, uint8_t, uint8_t value) {
-			// Configuration successfully read
-			const auto& next_cv = (((value >> 5) & 0x1) == 1) ? CV_ADDR_LO : CV_ADDR_SHORT;
-			xn.readCVdirect(
-				next_cv,
-				[this](void *s, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
-					xn_cvRead(s, st, cv, value);
-				},
-				std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_addrReadError(s, d); })
-			);
-		},
-		std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_addrReadError(s, d); })
-	);
+	core([this]() {
+		xn.readCVdirect(
+			CV_BASIC_CONFIG,
+			[this](void*, Xn::ReadCVStatus, uint8_t, uint8_t value) {
+				// Configuration successfully read (called in core thread)
+				const auto& next_cv = (((value >> 5) & 0x1) == 1) ? CV_ADDR_LO : CV_ADDR_SHORT;
+				xn.readCVdirect(
+					next_cv,
+					gui([this](void *s, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
+						xn_cvRead(s, st, cv, value);
+					}),
+					std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_addrReadError(s, d); }))
+				);
+			},
+			std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_addrReadError(s, d); }))
+		);
+	});
 }
 
 void MainWindow::b_speed_set_handle() {
 	try {
-		xn.setSpeed(Xn::LocoAddr(ui.sb_loco->value()), ui.sb_speed->value(),
-		            static_cast<Xn::Direction>(ui.rb_forward->isChecked()));
+		const unsigned addr = ui.sb_loco->value();
+		const unsigned speed = ui.sb_speed->value();
+		const auto direction = static_cast<Xn::Direction>(ui.rb_forward->isChecked());
+		core([this, addr, speed, direction]() { xn.setSpeed(Xn::LocoAddr(addr), speed, direction); });
 		m_sent_speed = ui.sb_speed->value();
 		ui.vs_speed->setValue(ui.sb_speed->value());
 	}
@@ -789,7 +902,8 @@ void MainWindow::b_loco_stop_handle() {
 		m_sent_speed = 0;
 		ui.vs_speed->setValue(0);
 		ui.sb_speed->setValue(0);
-		xn.emergencyStop(Xn::LocoAddr(ui.sb_loco->value()));
+		const unsigned addr = ui.sb_loco->value();
+		core([this, addr]() { xn.emergencyStop(Xn::LocoAddr(addr)); });
 	}
 	catch (const Xn::QStrException& e) {
 		show_error(e.str());
@@ -809,8 +923,10 @@ void MainWindow::t_slider_tick() {
 	try {
 		if (ui.vs_speed->value() != m_sent_speed) {
 			m_sent_speed = ui.vs_speed->value();
-			xn.setSpeed(Xn::LocoAddr(ui.sb_loco->value()), ui.sb_speed->value(),
-			            static_cast<Xn::Direction>(ui.rb_forward->isChecked()));
+			const unsigned addr = ui.sb_loco->value();
+			const unsigned speed = ui.sb_speed->value();
+			const auto direction = static_cast<Xn::Direction>(ui.rb_forward->isChecked());
+			core([this, addr, speed, direction]() { xn.setSpeed(Xn::LocoAddr(addr), speed, direction); });
 		}
 	}
 	catch (const Xn::QStrException& e) {
@@ -822,10 +938,14 @@ void MainWindow::chb_f_clicked(bool) {
 	m_fa.sep.f0 = ui.chb_f0->isChecked();
 	m_fa.sep.f1 = ui.chb_f1->isChecked();
 	m_fa.sep.f2 = ui.chb_f2->isChecked();
-	xn.setFuncA(Xn::LocoAddr(ui.sb_loco->value()), m_fa);
+	const unsigned addr = ui.sb_loco->value();
+	const Xn::FA fa = m_fa;
+	core([this, addr, fa]() { xn.setFuncA(Xn::LocoAddr(addr), fa); });
 }
 
-void MainWindow::sb_max_speed_changed(int value) { m_ssm.setMaxSpeed(value); }
+void MainWindow::sb_max_speed_changed(int value) {
+	core([this, value]() { m_ssm.setMaxSpeed(value); });
+}
 
 void MainWindow::sb_speed_changed(int) {
 	if (m_sent_speed != ui.sb_speed->value())
@@ -849,7 +969,8 @@ void MainWindow::a_wsm_connect(bool) {
 
 	try {
 		widget_set_color(*(ui.l_wsm), Qt::yellow);
-		wsm.connect(s["WSM"]["port"].toString());
+		const QString port = s["WSM"]["port"].toString();
+		core([this, port]() { wsm.connect(port); });
 
 		gui_update_enabled();
 		widget_set_color(*(ui.l_wsm), Qt::green);
@@ -864,9 +985,12 @@ void MainWindow::a_wsm_connect(bool) {
 }
 
 void MainWindow::a_wsm_disconnect(bool) {
-	wsm.disconnect();
+	const bool cm_in_progress = core([this]() {
+		wsm.disconnect();
+		return cm.inProgress();
+	});
 
-	if (cm.inProgress())
+	if (cm_in_progress)
 		b_calib_stop_handle();
 
 	ui.l_wsm_speed->setText("??.?");
@@ -881,6 +1005,7 @@ void MainWindow::mc_speedRead(double speed, uint16_t speed_raw) {
 	(void)speed_raw;
 
 	ui.l_wsm_speed->setText(QString::number(speed, 'f', 1));
+	w_sc.speedRead(speed);
 
 	if (m_canBlink < QDateTime::currentDateTime()) {
 		wsm_status_blink();
@@ -894,7 +1019,7 @@ void MainWindow::mc_distanceRead(double distance, uint32_t distance_raw) {
 }
 
 void MainWindow::mc_onError(QString error) {
-	if (!t_wsm_disconnect.isActive() && wsm.connected()) {
+	if (!t_wsm_disconnect.isActive() && core([this]() { return wsm.connected(); })) {
 		t_wsm_disconnect.start(0);
 		show_error("WSM serial port error: " + error + "!");
 	}
@@ -936,9 +1061,9 @@ void MainWindow::mc_longTermMeasureDone(double speed, double diffusion) {
 }
 
 void MainWindow::b_wsm_lt_handle() {
-	if (wsm.connected()) {
+	if (core([this]() { return wsm.connected(); })) {
 		try {
-			wsm.startLongTermMeasure(30); // 3 s
+			core([this]() { wsm.startLongTermMeasure(30); }); // 3 s
 		}
 		catch (const Wsm::QStrException& e) {
 			show_error(e.str());
@@ -955,6 +1080,8 @@ void MainWindow::a_power_graph(bool) {
 	w_pg.show();
 }
 
+void MainWindow::a_speed_chart(bool) { w_sc.show(); }
+
 void MainWindow::init_calib_graph() {
 	for(size_t i = 0; i < STEPS_CNT; i++) {
 		{
@@ -1036,42 +1163,53 @@ void MainWindow::vs_steps_moved(int value) {
 void MainWindow::b_step_read_handle() {
 	unsigned stepi = qobject_cast<QPushButton*>(QObject::sender())->property("step").toUInt();
 
-	xn.readCVdirect(
-		CV_CURVE_START + stepi,
-		[this](void *, Xn::ReadCVStatus status, uint8_t cv, uint8_t value) {
-			unsigned stepi = cv-CV_CURVE_START;
-			if (status == Xn::ReadCVStatus::Ok) {
-				unsigned slider_value = this->ui_steps[stepi].slider->value();
-				QString text = "Step="+QString::number(stepi+1)+" CV="+QString::number(cv)+
-					" read="+QString::number(value) + " slider="+QString::number(slider_value);
-				bool match = (value == slider_value);
-				log(text+ (match ? " match." : " mismatch!"), match ? LOGC_DONE: LOGC_ERROR);
-			} else {
-				show_error("Unable to read step "+QString::number(stepi+1)+
-					": "+Xn::XpressNet::xnReadCVStatusToQString(status));
-				return;
-			}
-		},
-		std::make_unique<Xn::Cb>([this](void *, void *) {
-			show_error("Unable to read step "+QString::number(this->verif_next_step));
-		})
-	);
+	core([this, stepi]() {
+		xn.readCVdirect(
+			CV_CURVE_START + stepi,
+			gui([this](void *, Xn::ReadCVStatus status, uint8_t cv, uint8_t value) {
+				unsigned stepi = cv-CV_CURVE_START;
+				if (status == Xn::ReadCVStatus::Ok) {
+					di_update(cv, value, Di::Source::Read);
+					unsigned slider_value = this->ui_steps[stepi].slider->value();
+					QString text = "Step="+QString::number(stepi+1)+" CV="+QString::number(cv)+
+						" read="+QString::number(value) + " slider="+QString::number(slider_value);
+					bool match = (value == slider_value);
+					log(text+ (match ? " match." : " mismatch!"), match ? LOGC_DONE: LOGC_ERROR);
+				} else {
+					show_error("Unable to read step "+QString::number(stepi+1)+
+						": "+Xn::XpressNet::xnReadCVStatusToQString(status));
+					return;
+				}
+			}),
+			std::make_unique<Xn::Cb>(gui([this](void *, void *) {
+				show_error("Unable to read step "+QString::number(this->verif_next_step));
+			}))
+		);
+	});
 }
 
 void MainWindow::b_step_write_handle() {
 	unsigned stepi = qobject_cast<QPushButton*>(QObject::sender())->property("step").toUInt();
 
-	if (xn.connected() && !ui.sb_loco->isEnabled()) {
+	if (!ui.sb_loco->isEnabled() && core([this]() { return xn.connected(); })) {
 		ui_steps[stepi].selected->setChecked(true);
 		log("Setting power of step " + QString::number(stepi+1) + " manually.");
-		xn.pomWriteCv(
-			Xn::LocoAddr(ui.sb_loco->value()),
-			CV_CURVE_START + stepi,
-			ui_steps[stepi].slider->value(),
-			std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_stepWritten(s, d); }, reinterpret_cast<void*>(stepi)),
-			std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_stepWriteError(s, d); }, reinterpret_cast<void*>(stepi))
-		);
-		cm.setStepManually(stepi+1, ui_steps[stepi].slider->value());
+		const unsigned value = ui_steps[stepi].slider->value();
+		const unsigned addr = ui.sb_loco->value();
+		di_forget(CV_CURVE_START + stepi);
+		core([this, addr, stepi, value]() {
+			xn.pomWriteCv(
+				Xn::LocoAddr(addr),
+				CV_CURVE_START + stepi,
+				value,
+				std::make_unique<Xn::Cb>(gui([this, stepi, value](void *s, void *d) {
+					di_update(CV_CURVE_START + stepi, value, Di::Source::Written);
+					xn_stepWritten(s, d);
+				}), reinterpret_cast<void*>(stepi)),
+				std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_stepWriteError(s, d); }), reinterpret_cast<void*>(stepi))
+			);
+			cm.setStepManually(stepi+1, value);
+		});
 	} else {
 		QMessageBox::warning(this, "Command not executed", "Command not executed: either not connected to XpressNet or DCC address not set!");
 	}
@@ -1079,10 +1217,12 @@ void MainWindow::b_step_write_handle() {
 
 void MainWindow::chb_step_selected_clicked(bool checked) {
 	unsigned stepi = qobject_cast<QCheckBox*>(QObject::sender())->property("step").toUInt();
-	gui_step_update_enabled(ui_steps[stepi]);
-
-	if (!checked)
-		cm.unsetStep(stepi);
+	const auto [xn_connected, cm_in_progress] = core([this, checked, stepi]() {
+		if (!checked)
+			cm.unsetStep(stepi);
+		return std::make_pair(xn.connected(), cm.inProgress());
+	});
+	gui_step_update_enabled(ui_steps[stepi], xn_connected, cm_in_progress);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1104,6 +1244,12 @@ void MainWindow::cm_step_power_changed(unsigned step, unsigned power) {
 	ui_steps[step-1].slider->setValue(power);
 }
 
+void MainWindow::cm_power_tried(unsigned step, unsigned power, Cm::CalibState phase) {
+	(void)step;
+	// Iterations of step calibration are marked, overview powers are not
+	w_sc.powerChanged(power, phase == Cm::CalibState::Steps);
+}
+
 void MainWindow::cm_stepDone(unsigned step, unsigned power) {
 	(void)power;
 	step_set_color(step-1, STEPC_DONE);
@@ -1111,6 +1257,7 @@ void MainWindow::cm_stepDone(unsigned step, unsigned power) {
 
 void MainWindow::cm_stepStart(unsigned step) {
 	step_set_color(step-1, STEPC_CHANGED);
+	w_sc.setTarget(core([this, step]() { return *(m_ssm[step-1]); }));
 }
 
 void MainWindow::cm_stepError(Cm::CmError ce, unsigned step, const QString& note) {
@@ -1118,20 +1265,7 @@ void MainWindow::cm_stepError(Cm::CmError ce, unsigned step, const QString& note
 		step_set_color(step-1, STEPC_ERROR);
 	widget_set_color(*ui.l_calib_state, Qt::red);
 
-	if (ce == Cm::CmError::Exception)
-		log("Exception!", LOGC_ERROR);
-	else if (ce == Cm::CmError::LargeDiffusion)
-		log("Loco speed too diffused!", LOGC_ERROR);
-	else if (ce == Cm::CmError::XnNoResponse)
-		log("No response from XpressNET!", LOGC_ERROR);
-	else if (ce == Cm::CmError::LocoStopped)
-		log("Loco stopped!", LOGC_ERROR);
-	else if (ce == Cm::CmError::NoStep)
-		log("No suitable power step for this speed!", LOGC_ERROR);
-	else if (ce == Cm::CmError::Oscilation)
-		log("Unable to reach target speed due to low precision (try decreasing Vmax?)", LOGC_ERROR);
-	else if (ce == Cm::CmError::WsmError)
-		log("WSM read speed error!", LOGC_ERROR);
+	log(Cm::errorStr(ce), LOGC_ERROR);
 
 	if (note != "")
 		log(note, LOGC_ERROR);
@@ -1163,17 +1297,22 @@ void MainWindow::cm_onLog(const QString &message, Cm::LogLevel level) {
 void MainWindow::cm_progress_update(size_t val) { ui.pb_progress->setValue(val); }
 
 void MainWindow::b_calib_start_handle() {
-	if (!xn.connected()) {
+	const auto [xn_connected, wsm_connected, wsm_speed_ok, any_record, init_cvs] = core([this]() {
+		return std::make_tuple(xn.connected(), wsm.connected(), wsm.isSpeedOk(), m_pm.isAnyRecord(),
+		                       cm.init_cvs);
+	});
+
+	if (!xn_connected) {
 		show_error("Not connected to XpressNET!");
 		return;
 	}
 
-	if (!wsm.connected()) {
+	if (!wsm_connected) {
 		show_error("Not connected to WSM!");
 		return;
 	}
 
-	if (!wsm.isSpeedOk()) {
+	if (!wsm_speed_ok) {
 		show_error("No data from WSM!");
 		return;
 	}
@@ -1184,12 +1323,12 @@ void MainWindow::b_calib_start_handle() {
 	}
 
 	bool changed = false;
-	changed |= ((ui.chb_vmax->isChecked() != (cm.init_cvs.find(CV_VMAX) != cm.init_cvs.end())) ||
-		((cm.init_cvs.find(CV_VMAX) != cm.init_cvs.end()) && (static_cast<int>(cm.init_cvs[CV_VMAX]) != ui.sb_vmax->value())));
-	changed |= ((ui.chb_volt_ref->isChecked() != (cm.init_cvs.find(CV_UREF) != cm.init_cvs.end())) ||
-		((cm.init_cvs.find(CV_UREF) != cm.init_cvs.end()) && (static_cast<int>(cm.init_cvs[CV_UREF]) != ui.sb_volt_ref->value())));
+	changed |= ((ui.chb_vmax->isChecked() != (init_cvs.find(CV_VMAX) != init_cvs.end())) ||
+		((init_cvs.find(CV_VMAX) != init_cvs.end()) && (static_cast<int>(init_cvs.at(CV_VMAX)) != ui.sb_vmax->value())));
+	changed |= ((ui.chb_volt_ref->isChecked() != (init_cvs.find(CV_UREF) != init_cvs.end())) ||
+		((init_cvs.find(CV_UREF) != init_cvs.end()) && (static_cast<int>(init_cvs.at(CV_UREF)) != ui.sb_volt_ref->value())));
 
-	if (m_pm.isAnyRecord() && changed) {
+	if (any_record && changed) {
 		QMessageBox::StandardButton reply;
 		reply = QMessageBox::question(
 			this,
@@ -1203,40 +1342,54 @@ void MainWindow::b_calib_start_handle() {
 		reset();
 	}
 
+	std::optional<unsigned> vmax, volt_ref;
 	if (ui.chb_vmax->isChecked())
-		cm.init_cvs[CV_VMAX] = ui.sb_vmax->value();
-	else
-		cm.init_cvs.erase(CV_VMAX);
-
+		vmax = ui.sb_vmax->value();
 	if (ui.chb_volt_ref->isChecked())
-		cm.init_cvs[CV_UREF] = ui.sb_volt_ref->value();
-	else
-		cm.init_cvs.erase(CV_UREF);
+		volt_ref = ui.sb_volt_ref->value();
 
 	verif_reset();
 	ui.pb_progress->setValue(0);
 	widget_set_color(*ui.l_calib_state, Qt::yellow);
-	cm.calibrateAll(ui.sb_loco->value(),
-	                static_cast<Xn::Direction>(ui.rb_forward->isChecked()));
+	const unsigned addr = ui.sb_loco->value();
+	const auto direction = static_cast<Xn::Direction>(ui.rb_forward->isChecked());
+	core([this, vmax, volt_ref, addr, direction]() {
+		if (vmax.has_value())
+			cm.init_cvs[CV_VMAX] = vmax.value();
+		else
+			cm.init_cvs.erase(CV_VMAX);
+
+		if (volt_ref.has_value())
+			cm.init_cvs[CV_UREF] = volt_ref.value();
+		else
+			cm.init_cvs.erase(CV_UREF);
+
+		cm.calibrateAll(addr, direction);
+	});
 	gui_update_enabled();
 }
 
 void MainWindow::b_calib_stop_handle() {
-	if (!cm.inProgress())
+	if (core([this]() { return m_batch.inProgress(); })) {
+		a_batch_stop(true);
+		return;
+	}
+	if (!core([this]() { return cm.inProgress(); }))
 		return;
 
-	cm.stop();
+	core([this]() { cm.stop(); });
 	log("Calibration manually interrupted!", LOGC_WARN);
 	widget_set_color(*ui.l_calib_state, Qt::red);
 	cm_done_gui();
 }
 
 void MainWindow::cm_done_gui() {
+	w_sc.calibStopped();
 	gui_update_enabled();
 }
 
 void MainWindow::b_reset_handle() {
-	if (cm.inProgress())
+	if (core([this]() { return cm.inProgress(); }))
 		return;
 
 	QMessageBox::StandardButton reply;
@@ -1251,7 +1404,7 @@ void MainWindow::b_reset_handle() {
 }
 
 void MainWindow::t_calib_active_tick() {
-	if (cm.inProgress()) {
+	if (core([this]() { return cm.inProgress(); })) {
 		QPalette palette = ui.l_calib_state->palette();
 		const QColor &color = palette.color(QPalette::WindowText);
 		if (color == Qt::yellow)
@@ -1271,46 +1424,52 @@ void MainWindow::chb_volt_ref_clicked(bool checked) {
 
 void MainWindow::b_vmax_read_handle() {
 	ui.b_vmax_read->setEnabled(false);
-	xn.readCVdirect(
-		CV_VMAX,
-		[this](void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
-			if (st == Xn::ReadCVStatus::Ok) {
-				log("Read CV " + QString::number(cv) + " = " + QString::number(value) +
-				    ", overriding "+QString::number(ui.sb_vmax->value()));
-				ui.sb_vmax->setValue(value);
-			} else {
-				show_error("Unable to read CV " + QString::number(cv) + ": " +
-				           Xn::XpressNet::xnReadCVStatusToQString(st));
-			}
-			ui.b_vmax_read->setEnabled(true);
-		},
-		std::make_unique<Xn::Cb>([this](void *, void *) {
-			ui.b_vmax_read->setEnabled(true);
-			show_error("Unable to read CV: no response from command station!");
-		})
-	);
+	core([this]() {
+		xn.readCVdirect(
+			CV_VMAX,
+			gui([this](void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
+				if (st == Xn::ReadCVStatus::Ok) {
+					di_update(cv, value, Di::Source::Read);
+					log("Read CV " + QString::number(cv) + " = " + QString::number(value) +
+					    ", overriding "+QString::number(ui.sb_vmax->value()));
+					ui.sb_vmax->setValue(value);
+				} else {
+					show_error("Unable to read CV " + QString::number(cv) + ": " +
+					           Xn::XpressNet::xnReadCVStatusToQString(st));
+				}
+				ui.b_vmax_read->setEnabled(true);
+			}),
+			std::make_unique<Xn::Cb>(gui([this](void *, void *) {
+				ui.b_vmax_read->setEnabled(true);
+				show_error("Unable to read CV: no response from command station!");
+			}))
+		);
+	});
 }
 
 void MainWindow::b_volt_ref_read_handle() {
 	ui.b_volt_ref_read->setEnabled(false);
-	xn.readCVdirect(
-		CV_UREF,
-		[this](void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
-			if (st == Xn::ReadCVStatus::Ok) {
-				log("Read CV " + QString::number(cv) + " = " + QString::number(value) +
-				    ", overriding "+QString::number(ui.sb_volt_ref->value()));
-				ui.sb_volt_ref->setValue(value);
-			} else {
-				show_error("Unable to read CV " + QString::number(cv) + ": " +
-				           Xn::XpressNet::xnReadCVStatusToQString(st));
-			}
-			ui.b_volt_ref_read->setEnabled(true);
-		},
-		std::make_unique<Xn::Cb>([this](void *, void *) {
-			ui.b_volt_ref_read->setEnabled(true);
-			show_error("Unable to read CV: no response from command station!");
-		})
-	);
+	core([this]() {
+		xn.readCVdirect(
+			CV_UREF,
+			gui([this](void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
+				if (st == Xn::ReadCVStatus::Ok) {
+					di_update(cv, value, Di::Source::Read);
+					log("Read CV " + QString::number(cv) + " = " + QString::number(value) +
+					    ", overriding "+QString::number(ui.sb_volt_ref->value()));
+					ui.sb_volt_ref->setValue(value);
+				} else {
+					show_error("Unable to read CV " + QString::number(cv) + ": " +
+					           Xn::XpressNet::xnReadCVStatusToQString(st));
+				}
+				ui.b_volt_ref_read->setEnabled(true);
+			}),
+			std::make_unique<Xn::Cb>(gui([this](void *, void *) {
+				ui.b_volt_ref_read->setEnabled(true);
+				show_error("Unable to read CV: no response from command station!");
+			}))
+		);
+	});
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1318,11 +1477,13 @@ void MainWindow::b_volt_ref_read_handle() {
 
 void MainWindow::b_ad_read_handle() {
 	ui.gb_ad->setEnabled(false);
-	xn.readCVdirect(
-		CV_ACCEL,
-		[this](void *s, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) { xn_cvRead(s, st, cv, value); },
-		std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_adReadError(s, d); })
-	);
+	core([this]() {
+		xn.readCVdirect(
+			CV_ACCEL,
+			gui([this](void *s, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) { xn_cvRead(s, st, cv, value); }),
+			std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_adReadError(s, d); }))
+		);
+	});
 }
 
 void MainWindow::b_ad_write_handle() {
@@ -1333,33 +1494,46 @@ void MainWindow::b_ad_write_handle() {
 
 	ui.gb_ad->setEnabled(false);
 
-	xn.pomWriteCv(Xn::LocoAddr(
-		ui.sb_loco->value()), CV_ACCEL, ui.sb_accel->value(),
-		std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_accelWritten(s, d); }),
-		std::make_unique<Xn::Cb>([this](void *s, void *d) { xn_adWriteError(s, d); })
-	);
+	di_forget(CV_ACCEL);
+	const unsigned addr = ui.sb_loco->value();
+	const unsigned accel = ui.sb_accel->value();
+	core([this, addr, accel]() {
+		xn.pomWriteCv(Xn::LocoAddr(addr), CV_ACCEL, accel,
+			std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_accelWritten(s, d); })),
+			std::make_unique<Xn::Cb>(gui([this](void *s, void *d) { xn_adWriteError(s, d); }))
+		);
+	});
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void MainWindow::a_debug1(bool) {
-	xn.pomWriteBit(
-		Xn::LocoAddr(ui.sb_loco->value()),
-		CV_BASIC_CONFIG,
-		CV_CONFIG_BIT_SPEED_TABLE,
-		Cm::CV_CONFIG_SPEED_TABLE_VALUE
-	);
+	const unsigned addr = ui.sb_loco->value();
+	core([this, addr]() {
+		xn.pomWriteBit(
+			Xn::LocoAddr(addr),
+			CV_BASIC_CONFIG,
+			CV_CONFIG_BIT_SPEED_TABLE,
+			Cm::CV_CONFIG_SPEED_TABLE_VALUE
+		);
+	});
 }
 
-void MainWindow::a_debug_interpolate(bool) { cm.interpolateAll(); }
+void MainWindow::a_debug_interpolate(bool) { core([this]() { cm.interpolateAll(); }); }
 
 void MainWindow::a_debug2(bool) {
-	xn.writeCVdirect(
-		CV_RESET,
-		CV_RESET_RESET,
-		std::make_unique<Xn::Cb>([this](void *, void *) { log("Ok"); }),
-		std::make_unique<Xn::Cb>([this](void *, void *) { log("Error"); })
-	);
+	const bool addr_set = !ui.sb_loco->isEnabled();
+	const unsigned addr = ui.sb_loco->value();
+	core([this, addr_set, addr]() {
+		if (addr_set)
+			m_di.forget(addr); // decoder reset -> nothing known
+		xn.writeCVdirect(
+			CV_RESET,
+			CV_RESET_RESET,
+			std::make_unique<Xn::Cb>(gui([this](void *, void *) { log("Ok"); })),
+			std::make_unique<Xn::Cb>(gui([this](void *, void *) { log("Error"); }))
+		);
+	});
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1377,39 +1551,18 @@ void MainWindow::a_loco_load(bool) {
 
 	reset();
 
-	QXmlStreamReader xr;
-	QFile file(filename);
-	if (!file.open(QFile::ReadOnly | QFile::Text))
-	{
-		show_error("Cannot read file " + filename);
+	Lf::LocoInfo info;
+	info.addr = ui.sb_loco->value();
+	info.max_speed = ui.sb_max_speed->value();
+	try {
+		core([this, &filename, &info]() { Lf::load(filename, info, m_pm); });
+	} catch (const Lf::EFileError &e) {
+		show_error(e.str());
 		return;
 	}
 
-	xr.setDevice(&file);
-	xr.readNext();
-
-	while (!xr.atEnd()) {
-		if (xr.isStartElement()) {
-			if (xr.name() == QString("powerToSpeed")) {
-				xr.readNext();
-				while (xr.name() != QString("powerToSpeed")) {
-					if (xr.name() == QString("record") && xr.attributes().hasAttribute("power") &&
-						xr.attributes().hasAttribute("speed")) {
-						int power = xr.attributes().value("power").toInt();
-						float speed = xr.attributes().value("speed").toFloat();
-						m_pm.addOrUpdate(power, speed);
-					}
-					xr.readNext();
-				}
-			} else if (xr.name() == QString("dcclocoaddress") && xr.attributes().hasAttribute("number")) {
-				ui.sb_loco->setValue(xr.attributes().value("number").toInt());
-			} else if (xr.name() == QString("locomotive") && xr.attributes().hasAttribute("maxSpeed")) {
-				ui.sb_max_speed->setValue(xr.attributes().value("maxSpeed").toInt());
-			}
-		}
-
-		xr.readNext();
-	}
+	ui.sb_loco->setValue(info.addr);
+	ui.sb_max_speed->setValue(info.max_speed);
 }
 
 void MainWindow::a_loco_save(bool) {
@@ -1422,78 +1575,128 @@ void MainWindow::a_loco_save(bool) {
 	if (filename == "")
 		return;
 
-	if (!filename.endsWith(".xml"))
-		filename += ".xml";
-
-	QFile file(filename);
-	file.open(QIODevice::WriteOnly);
-
-	QXmlStreamWriter xw(&file);
-	xw.setAutoFormatting(true);
-	xw.writeStartDocument();
-	xw.writeDTD("<!DOCTYPE locomotive-config SYSTEM \"/xml/DTD/locomotive-config.dtd\">");
-
-	xw.writeStartElement("locomotive-config");
-	xw.writeStartElement("locomotive");
-	xw.writeAttribute("id", QString::number(ui.sb_loco->value()));
-	xw.writeAttribute("dccAddress", QString::number(ui.sb_loco->value()));
-	xw.writeAttribute("maxSpeed", QString::number(ui.sb_max_speed->value()));
-
-	// We must save decoder model, otherwise JMRI crashes at start
-	xw.writeStartElement("decoder");
-	xw.writeAttribute("model", "MX658N18 version 32+"); // TODO: save decoder nicely?
-	xw.writeEndElement();
-
-	xw.writeStartElement("locoaddress");
-	xw.writeStartElement("dcclocoaddress");
-	xw.writeAttribute("number", QString::number(ui.sb_loco->value()));
-	xw.writeAttribute("longaddress", "yes");
-	xw.writeEndElement();
-	xw.writeTextElement("number", QString::number(ui.sb_loco->value()));
-	xw.writeTextElement("protocol", "dcc_long");
-	xw.writeEndElement();
-
-	xw.writeStartElement("values");
-	xw.writeStartElement("decoderDef");
-
-	QString steps = "";
-	for (const auto &s : ui_steps)
-		steps += QString::number(s.slider->value()) + ",";
-
-	std::vector<std::pair<QString, QString>> values = {
-		std::make_pair("Acceleration Rate", QString::number(ui.sb_accel->value())),
-		std::make_pair("Deceleration Rate", QString::number(ui.sb_decel->value())),
-		std::make_pair("Use Speed Table", "1"),
-		std::make_pair("Speed Table", std::move(steps)),
-		std::make_pair("Vhigh", QString::number(ui.sb_vmax->value())),
-		std::make_pair("Vmid", "60"),
-		std::make_pair("Vstart", "1"),
-	};
-
-	for (const auto &val : values) {
-		xw.writeStartElement("varValue");
-		xw.writeAttribute("item", val.first);
-		xw.writeAttribute("value", val.second);
-		xw.writeEndElement();
-	}
-
-	xw.writeEndElement();
-	xw.writeEndElement();
-
-	xw.writeStartElement("powerToSpeed");
-	for (size_t i = 0; i < Pm::POWER_CNT; i++) {
-		if (nullptr != m_pm.speed(i)) {
-			xw.writeStartElement("record");
-			xw.writeAttribute("power", QString::number(i));
-			xw.writeAttribute("speed", QString::number(*m_pm.speed(i)));
-			xw.writeEndElement();
-		}
+	Lf::LocoInfo info;
+	info.addr = ui.sb_loco->value();
+	info.max_speed = ui.sb_max_speed->value();
+	info.accel = ui.sb_accel->value();
+	info.decel = ui.sb_decel->value();
+	info.vmax = ui.sb_vmax->value();
+	for (size_t i = 0; i < STEPS_CNT; i++)
+		info.steps[i] = ui_steps[i].slider->value();
+
+	try {
+		core([this, &filename, &info]() {
+			Lf::save(filename, info, m_pm);
+			if (cm.metrics.runs > 0) {
+				cm.metrics.saveJson(Mt::CalibMetrics::filename(filename, "json"));
+				cm.metrics.saveCsv(Mt::CalibMetrics::filename(filename, "csv"));
+			}
+		});
+	} catch (const QStrException &e) {
+		show_error(e.str());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Batch calibration:
+
+void MainWindow::a_batch_run(bool) {
+	const auto [in_progress, xn_connected, wsm_connected, wsm_speed_ok] = core([this]() {
+		return std::make_tuple(cm.inProgress() || m_batch.inProgress(), xn.connected(),
+		                       wsm.connected(), wsm.isSpeedOk());
+	});
+	if (in_progress)
+		return;
+
+	if (!xn_connected) {
+		show_error("Not connected to XpressNET!");
+		return;
 	}
-	xw.writeEndElement();
+	if (!wsm_connected) {
+		show_error("Not connected to WSM!");
+		return;
+	}
+	if (!wsm_speed_ok) {
+		show_error("No data from WSM!");
+		return;
+	}
+
+	QString filename = QFileDialog::getOpenFileName(
+		this,
+		tr("Open batch manifest"), ".",
+		tr("Batch manifest (*.csv *.txt)")
+	);
+	if (filename == "")
+		return;
+
+	std::vector<Bq::Job> jobs;
+	try {
+		jobs = Bq::loadManifest(filename);
+	} catch (const Bq::EManifest &e) {
+		show_error(e.str());
+		return;
+	}
+	if (jobs.empty()) {
+		show_error("No jobs in " + filename);
+		return;
+	}
+
+	log("Loaded batch of " + QString::number(jobs.size()) + " loco(s) from " + filename);
+	verif_reset();
+	core([this, &jobs]() {
+		m_batch.jobs = std::move(jobs);
+		m_batch.start();
+	});
+	gui_update_enabled();
+}
+
+void MainWindow::a_batch_stop(bool) {
+	const bool stopped = core([this]() {
+		if (!m_batch.inProgress())
+			return false;
+		m_batch.stop();
+		return true;
+	});
+	if (!stopped)
+		return;
+	widget_set_color(*ui.l_calib_state, Qt::red);
+	gui_update_enabled();
+}
+
+void MainWindow::bq_job_start(size_t job) {
+	reset();
+	widget_set_color(*ui.l_calib_state, Qt::yellow);
+	const auto [addr, count] = core([this, job]() {
+		return std::make_pair(m_batch.jobs[job].addr, m_batch.jobs.size());
+	});
+	log("Batch: calibrating loco " + QString::number(addr) + " (" +
+	    QString::number(job+1) + "/" + QString::number(count) + ")");
+	gui_update_enabled();
+}
 
-	xw.writeEndElement();
-	xw.writeEndElement();
-	file.close();
+void MainWindow::bq_swap_needed(size_t job) {
+	const auto addr = core([this, job]() { return m_batch.jobs[job].addr; });
+	QMessageBox::StandardButton reply = QMessageBox::question(
+		this,
+		"Batch",
+		"Put loco " + QString::number(addr) + " on the track.\nContinue?",
+		QMessageBox::Yes|QMessageBox::No, QMessageBox::Yes
+	);
+	if (reply == QMessageBox::Yes)
+		core([this]() { m_batch.resume(); });
+	else
+		core([this]() { m_batch.stop(); });
+}
+
+void MainWindow::bq_finished(unsigned done, unsigned failed) {
+	// Batch loads its own speed profiles, restore the current one
+	a_speed_load(true);
+	const unsigned max_speed = ui.sb_max_speed->value();
+	core([this, max_speed]() { m_ssm.setMaxSpeed(max_speed); });
+	gui_update_enabled();
+
+	QMessageBox::information(this, "Batch", "Batch finished: " + QString::number(done) +
+	                         " done, " + QString::number(failed) + " failed.");
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1511,16 +1714,20 @@ void MainWindow::cr_error(Cr::CrError, unsigned, const QString& message) {
 }
 
 void MainWindow::b_decel_measure_handle() {
-	if (!wsm.connected() || !wsm.isSpeedOk() || !xn.connected())
+	if (!core([this]() { return wsm.connected() && wsm.isSpeedOk() && xn.connected(); }))
 		return;
 
 	ui.b_decel_measure->setEnabled(false);
-	cr.measure(ui.sb_loco->value(), 15, static_cast<Xn::Direction>(ui.rb_forward->isChecked()), 40);
+	const unsigned addr = ui.sb_loco->value();
+	const auto direction = static_cast<Xn::Direction>(ui.rb_forward->isChecked());
+	core([this, addr, direction]() { cr.measure(addr, 15, direction, 40); });
 }
 
 void MainWindow::reset() {
-	m_pm.clear();
-	cm.reset();
+	core([this]() {
+		m_pm.clear();
+		cm.reset();
+	});
 	for (size_t i = 0; i < STEPS_CNT; i++) {
 		ui_steps[i].slider->setValue(0);
 		ui_steps[i].slider->setEnabled(false);
@@ -1532,49 +1739,224 @@ void MainWindow::reset() {
 	ui.pb_progress->setValue(0);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Calibration stations:
+
+void MainWindow::stations_init() {
+	const unsigned count = s["Stations"]["count"].toUInt();
+	for (unsigned id = 1; id <= count; id++) {
+		St::Station *station = core([this, id]() {
+			// Station must be created in core thread
+			auto station = std::make_unique<St::Station>(id, xn, m_ssm);
+			station->cm.pom.image = &m_di;
+			station->cm.setTrace(&m_trace);
+			m_stations.push_back(std::move(station));
+			return m_stations.back().get();
+		});
+		config_load_station(*station);
+
+		QObject::connect(station, SIGNAL(onDone(uint)), this, SLOT(st_done(uint)));
+		QObject::connect(station, SIGNAL(onError(uint,Cm::CmError,uint,const QString&)),
+		                 this, SLOT(st_error(uint,Cm::CmError,uint,const QString&)));
+		QObject::connect(station, SIGNAL(onLog(uint,const QString&,Cm::LogLevel)),
+		                 this, SLOT(st_log(uint,const QString&,Cm::LogLevel)));
+		QObject::connect(station, SIGNAL(onProgressUpdate(uint,size_t)),
+		                 this, SLOT(st_progress_update(uint,size_t)));
+		QObject::connect(station, SIGNAL(onSpeedRead(uint,double)),
+		                 this, SLOT(st_speed_read(uint,double)));
+	}
+
+	if (!m_stations.empty())
+		stations_init_gui();
+}
+
+void MainWindow::stations_init_gui() {
+	QWidget *tab = new QWidget();
+	QVBoxLayout *layout = new QVBoxLayout(tab);
+
+	tw_stations = new QTreeWidget(tab);
+	tw_stations->setHeaderLabels({"Station", "Loco", "WSM", "Speed", "State", "Progress"});
+	tw_stations->setRootIsDecorated(false);
+	layout->addWidget(tw_stations);
+
+	QHBoxLayout *buttons = new QHBoxLayout();
+	QPushButton *b_wsm_connect = new QPushButton("Connect WSMs", tab);
+	QPushButton *b_start = new QPushButton("Start all", tab);
+	QPushButton *b_stop = new QPushButton("Stop all", tab);
+	buttons->addWidget(b_wsm_connect);
+	buttons->addWidget(b_start);
+	buttons->addWidget(b_stop);
+	buttons->addStretch();
+	layout->addLayout(buttons);
+
+	QObject::connect(b_wsm_connect, SIGNAL(released()), this, SLOT(b_stations_wsm_connect_handle()));
+	QObject::connect(b_start, SIGNAL(released()), this, SLOT(b_stations_start_handle()));
+	QObject::connect(b_stop, SIGNAL(released()), this, SLOT(b_stations_stop_handle()));
+
+	for (const auto &station : m_stations) {
+		const auto [loco_addr, wsm_port] = core([&station]() {
+			return std::make_pair(station->loco_addr, station->wsm_port);
+		});
+		QTreeWidgetItem *item = new QTreeWidgetItem(tw_stations);
+		item->setText(0, QString::number(station->id));
+		item->setText(1, QString::number(loco_addr));
+		item->setText(2, wsm_port);
+		item->setText(3, "??.?");
+		item->setText(4, "Idle");
+
+		QProgressBar *progress = new QProgressBar();
+		progress->setRange(0, 100);
+		progress->setValue(0);
+		tw_stations->setItemWidget(item, 5, progress);
+
+		ui_stations.push_back({item, progress});
+	}
+
+	ui.tw_main->addTab(tab, "Stations");
+}
+
+void MainWindow::station_set_state(unsigned id, const QString &state, const QColor &color) {
+	ui_stations[id-1].item->setText(4, state);
+	ui_stations[id-1].item->setBackground(4, color);
+}
+
+void MainWindow::b_stations_wsm_connect_handle() {
+	const QStringList errors = core([this]() {
+		QStringList errors;
+		for (const auto &station : m_stations) {
+			if (station->wsm.connected())
+				continue;
+			try {
+				station->connectWsm();
+			} catch (const Wsm::EOpenError &e) {
+				errors.append(station->name() + ": WSM connect error while opening serial port '" +
+				              station->wsm_port + "': " + e);
+			}
+		}
+		return errors;
+	});
+	for (const QString &error : errors)
+		log(error, LOGC_ERROR);
+}
+
+void MainWindow::b_stations_start_handle() {
+	std::vector<unsigned> started;
+	QStringList errors;
+	core([this, &started, &errors]() {
+		for (const auto &station : m_stations) {
+			if (station->inProgress())
+				continue;
+			try {
+				station->cm.init_cvs = cm.init_cvs;
+				station->start();
+				started.push_back(station->id);
+			} catch (const St::ENotReady &e) {
+				errors.append(e.str());
+			}
+		}
+	});
+
+	for (const unsigned id : started)
+		station_set_state(id, "Calibrating", QC_LIGHT_YELLOW);
+	for (const QString &error : errors)
+		log(error, LOGC_ERROR);
+}
+
+void MainWindow::b_stations_stop_handle() {
+	const std::vector<unsigned> stopped = core([this]() {
+		std::vector<unsigned> stopped;
+		for (const auto &station : m_stations) {
+			if (!station->inProgress())
+				continue;
+			station->stop();
+			stopped.push_back(station->id);
+		}
+		return stopped;
+	});
+
+	for (const unsigned id : stopped)
+		station_set_state(id, "Stopped", LOGC_WARN);
+}
+
+void MainWindow::st_done(unsigned id) {
+	station_set_state(id, "Done", QC_LIGHT_GREEN);
+	log(m_stations[id-1]->name() + ": calibration done.", LOGC_DONE);
+}
+
+void MainWindow::st_error(unsigned id, Cm::CmError ce, unsigned step, const QString& note) {
+	station_set_state(id, "Error", QC_LIGHT_RED);
+	QString message = m_stations[id-1]->name() + ": " + Cm::errorStr(ce);
+	if (step != 0)
+		message += " (step " + QString::number(step) + ")";
+	log(message, LOGC_ERROR);
+	if (note != "")
+		log(m_stations[id-1]->name() + ": " + note, LOGC_ERROR);
+}
+
+void MainWindow::st_log(unsigned id, const QString &message, Cm::LogLevel level) {
+	cm_onLog(m_stations[id-1]->name() + ": " + message, level);
+}
+
+void MainWindow::st_progress_update(unsigned id, size_t val) {
+	ui_stations[id-1].progress->setValue(val);
+}
+
+void MainWindow::st_speed_read(unsigned id, double speed) {
+	ui_stations[id-1].item->setText(3, QString::number(speed, 'f', 1));
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Config IO:
 
 void MainWindow::a_config_load(bool) {
 	s.load(this->config_fn);
 
-	try {
-		bool ok;
-		Xn::XNConfig xn_config;
-		xn_config.outInterval = s["XN"]["outIntervalMs"].toUInt(&ok);
-		if (ok) {
-			xn.setConfig(xn_config);
-		} else {
-			this->log("XN config load: unable to parse outIntervalMs", LOGC_ERROR);
+	const Ls::Options log_options = Cc::logOptions(s);
+	m_log_sink.open(s["Logging"]["file"].toString(), log_options);
+	m_xn_log_sink.open(s["XN"]["logfile"].toString(), log_options);
+
+	const QStringList errors = core([this]() {
+		QStringList errors;
+		try {
+			Cc::applyXn(s, xn);
+		} catch (const QStrException& e) {
+			errors.append("XN config load: " + e.str());
+		} catch (const Xn::QStrException& e) {
+			errors.append("XN config load: " + e.str());
 		}
-	} catch (const Xn::QStrException& e) {
-		this->log("XN config load: " + e.str(), LOGC_ERROR);
-	}
-
-	wsm.scale = s["WSM"]["scale"].toInt();
-	wsm.wheelDiameter = s["WSM"]["wheelDiameter"].toDouble();
-	wsm.ticksPerRevolution = s["WSM"]["ticksPerRevolution"].toDouble();
-
-	auto& calcfg = s["Calibration"];
-
-	Settings::cfgToDouble(calcfg, "absDeviation", cm.cs.abs_deviation);
-	Settings::cfgToDouble(calcfg, "relDeviation", cm.cs.rel_deviation);
-	Settings::cfgToDouble(calcfg, "maxAbsDiffusion", cm.cs.max_abs_diffusion);
-	Settings::cfgToDouble(calcfg, "maxAbsDiffusion", cm.co.max_abs_diffusion);
-	Settings::cfgToDouble(calcfg, "maxRelDiffusion", cm.cs.max_rel_diffusion);
-	Settings::cfgToDouble(calcfg, "maxRelDiffusion", cm.co.max_rel_diffusion);
-	Settings::cfgToUnsigned(calcfg, "measureCount", cm.cs.measure_count);
-	Settings::cfgToUnsigned(calcfg, "measureCount", cm.co.measure_count);
-	Settings::cfgToUnsigned(calcfg, "spAdaptTimeout", cm.cs.sp_adapt_timeout);
-	Settings::cfgToUnsigned(calcfg, "spAdaptTimeout", cm.co.sp_adapt_timeout);
-	Settings::cfgToUnsigned(calcfg, "overviewStep", cm.co.overview_step);
-	Settings::cfgToUnsigned(calcfg, "overviewStart", cm.co.overview_start);
-	Settings::cfgToUnsigned(calcfg, "overviewMinSpeed", cm.co.min_speed);
-	Settings::cfgToUnsigned(calcfg, "rangeStopMinTimes", cr.stop_min);
+
+		Cc::applyWsm(s["WSM"], wsm);
+		Cc::applyDecoderImage(s, m_di);
+		try {
+			Cc::applyTrace(s, m_trace);
+		} catch (const QStrException& e) {
+			errors.append("Trace: " + e.str());
+		}
+		Cc::applyCalib(s, cm);
+		Settings::cfgToUnsigned(s["Calibration"], "rangeStopMinTimes", cr.stop_min);
+		return errors;
+	});
+	for (const QString &error : errors)
+		this->log(error, LOGC_ERROR);
+
+	for (const auto &station : m_stations)
+		config_load_station(*station);
 
 	log("Loaded config from " + this->config_fn);
 }
 
+void MainWindow::config_load_station(St::Station &station) {
+	const auto [loco_addr, wsm_port] = core([this, &station]() {
+		St::applyConfig(s, station);
+		return std::make_pair(station.loco_addr, station.wsm_port);
+	});
+
+	if (station.id <= ui_stations.size()) {
+		ui_stations[station.id-1].item->setText(1, QString::number(loco_addr));
+		ui_stations[station.id-1].item->setText(2, wsm_port);
+	}
+}
+
 void MainWindow::a_config_save(bool) {
 	s.save(this->config_fn);
 	log("Saved config to " + this->config_fn);
@@ -1587,7 +1969,7 @@ void MainWindow::a_speed_load(bool) {
 	QString filename;
 	Settings::cfgToQString(s["Speed"], "file", filename);
 	try {
-		m_ssm.load(filename);
+		core([this, &filename]() { m_ssm.load(filename); });
 		log("Loaded steps-to-speed mapping from " + filename);
 	}
 	catch (const std::exception& e) {
@@ -1698,16 +2080,19 @@ void MainWindow::verif_next() {
 	if ((this->verif_next_step < 1) || (this->verif_next_step > STEPS_CNT))
 		throw QStrException("verif_next: verif_next_step out of range!");
 
-	xn.readCVdirect(
-		CV_CURVE_START - 1 + this->verif_next_step,
-		[this](void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
-			this->verif_read(st, cv, value);
-		},
-		std::make_unique<Xn::Cb>([this](void *, void *) {
-			this->log("Unable to read step "+QString::number(this->verif_next_step), LOGC_ERROR);
-			this->verif_read_error(this->verif_next_step);
-		})
-	);
+	const unsigned cv = CV_CURVE_START - 1 + this->verif_next_step;
+	core([this, cv]() {
+		xn.readCVdirect(
+			cv,
+			gui([this](void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
+				this->verif_read(st, cv, value);
+			}),
+			std::make_unique<Xn::Cb>(gui([this](void *, void *) {
+				this->log("Unable to read step "+QString::number(this->verif_next_step), LOGC_ERROR);
+				this->verif_read_error(this->verif_next_step);
+			}))
+		);
+	});
 }
 
 void MainWindow::verif_read(Xn::ReadCVStatus status, uint8_t cv, uint8_t value) {
@@ -1724,6 +2109,7 @@ void MainWindow::verif_read(Xn::ReadCVStatus status, uint8_t cv, uint8_t value)
 			return;
 		}
 
+		di_update(cv, value, Di::Source::Verified);
 		unsigned slider_value = this->ui_steps[this->verif_next_step-1].slider->value();
 		bool match = (value == slider_value);
 		widget_set_bgcolor(*(this->ui_steps[this->verif_next_step-1].slider), match ? QC_LIGHT_GREEN : QC_LIGHT_BLUE);
@@ -1759,23 +2145,25 @@ void MainWindow::verif_read_error(unsigned step) {
 // Use speed table Service Mode
 
 void MainWindow::a_use_speed_table(bool) {
-	if (!xn.connected()) {
+	if (!core([this]() { return xn.connected(); })) {
 		show_error("Not connected to XpressNET!");
 		return;
 	}
 
-	xn.readCVdirect(
-		CV_BASIC_CONFIG,
-		[this](void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
-			if (cv == CV_BASIC_CONFIG)
-				use_speed_table_read_basic_config(st, value);
-			else
-				show_error("Different CV read!");
-		},
-		std::make_unique<Xn::Cb>([this](void *, void *) {
-			show_error("Unable to read CV "+QString::number(CV_BASIC_CONFIG)+": no response from command station!");
-		})
-	);
+	core([this]() {
+		xn.readCVdirect(
+			CV_BASIC_CONFIG,
+			gui([this](void *, Xn::ReadCVStatus st, uint8_t cv, uint8_t value) {
+				if (cv == CV_BASIC_CONFIG)
+					use_speed_table_read_basic_config(st, value);
+				else
+					show_error("Different CV read!");
+			}),
+			std::make_unique<Xn::Cb>(gui([this](void *, void *) {
+				show_error("Unable to read CV "+QString::number(CV_BASIC_CONFIG)+": no response from command station!");
+			}))
+		);
+	});
 }
 
 void MainWindow::use_speed_table_read_basic_config(Xn::ReadCVStatus status, uint8_t value) {
@@ -1785,6 +2173,7 @@ void MainWindow::use_speed_table_read_basic_config(Xn::ReadCVStatus status, uint
 		return;
 	}
 
+	di_update(CV_BASIC_CONFIG, value, Di::Source::Read);
 	log("Read CV "+QString::number(CV_BASIC_CONFIG)+" value="+QString::number(value)+
 		" = 0b"+QString::number(value, 2) + " = 0x"+QString::number(value, 16) + ": "+explain_cv29(value));
 
@@ -1793,16 +2182,58 @@ void MainWindow::use_speed_table_read_basic_config(Xn::ReadCVStatus status, uint
 	} else {
 		uint8_t new_value = value | (1 << CV_CONFIG_BIT_SPEED_TABLE);
 		log("Enable speed table: write value "+QString::number(new_value));
-		xn.writeCVdirect(
-			CV_BASIC_CONFIG,
-			new_value,
-			std::make_unique<Xn::Cb>([this](void *, void *) {
-				log("CV "+QString::number(CV_BASIC_CONFIG)+" succesfully written", LOGC_DONE);
-			}),
-			std::make_unique<Xn::Cb>([this](void *, void *) {
-				show_error("Unable to write CV "+QString::number(CV_BASIC_CONFIG)+": no response from command station!");
-			})
-		);
+		di_forget(CV_BASIC_CONFIG);
+		core([this, new_value]() {
+			xn.writeCVdirect(
+				CV_BASIC_CONFIG,
+				new_value,
+				std::make_unique<Xn::Cb>(gui([this, new_value](void *, void *) {
+					di_update(CV_BASIC_CONFIG, new_value, Di::Source::Written);
+					log("CV "+QString::number(CV_BASIC_CONFIG)+" succesfully written", LOGC_DONE);
+				})),
+				std::make_unique<Xn::Cb>(gui([this](void *, void *) {
+					show_error("Unable to write CV "+QString::number(CV_BASIC_CONFIG)+": no response from command station!");
+				}))
+			);
+		});
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decoder image: CVs read/written manually belong to the loco with set address
+
+void MainWindow::a_di_forget(bool) {
+	// Stored CV values are trusted by calibration, operator invalidates them
+	// after decoder reset or when another decoder got the address
+	const unsigned addr = ui.sb_loco->value();
+	QMessageBox::StandardButton reply = QMessageBox::question(
+		this,
+		"Question",
+		"Forget all CV values known for loco " + QString::number(addr) +
+		" (decoder reset or another decoder)?\nAll CVs will be written again by the next calibration.",
+		QMessageBox::Yes|QMessageBox::No, QMessageBox::No
+	);
+	if (reply != QMessageBox::Yes)
+		return;
+
+	core([this, addr]() {
+		m_di.forget(addr);
+		m_di.sync();
+	});
+	log("Decoder image of loco " + QString::number(addr) + " forgotten");
+}
+
+void MainWindow::di_update(unsigned cv, uint8_t value, Di::Source source) {
+	if (!ui.sb_loco->isEnabled()) {
+		const unsigned addr = ui.sb_loco->value();
+		core([this, addr, cv, value, source]() { m_di.set(addr, cv, value, source); });
+	}
+}
+
+void MainWindow::di_forget(unsigned cv) {
+	if (!ui.sb_loco->isEnabled()) {
+		const unsigned addr = ui.sb_loco->value();
+		core([this, addr, cv]() { m_di.forget(addr, cv); });
 	}
 }
 
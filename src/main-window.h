@@ -8,24 +8,48 @@ the application.
 It handles all the UI communication. It also contains CalibrationManager
 instance. It also owns instances of Xn and Wsm library classes, which are
 forwarded to Calibration Manager as a references.
+
+Additional calibration stations (see station.h) are created based on config
+file and shown in a separate "Stations" tab.
+
+XpressNET, WSM, the calibration managers and everything they use (CalibCore)
+live in a separate worker thread (worker-thread.h), so speed samples and POM
+responses are handled on time even when the GUI is busy (modal dialog, log
+flood, chart relayout). Their signals are delivered to MainWindow queued.
+MainWindow accesses them only via core(), callbacks passed to them are
+wrapped by gui(), so they are executed in the GUI thread.
 */
 
 #include <QCheckBox>
 #include <QLabel>
 #include <QMainWindow>
+#include <QProgressBar>
 #include <QPushButton>
 #include <QSlider>
+#include <QTreeWidget>
+#include <memory>
+#include <utility>
+#include <vector>
 
+#include "batch-queue.h"
+#include "calib-config.h"
 #include "calib-man.h"
 #include "calib-range.h"
 #include "calib-step.h"
+#include "decoder-image.h"
+#include "log-model.h"
+#include "log-sink.h"
 #include "lib/wsm/wsm.h"
 #include "lib/xn/xn.h"
 #include "power-graph-window.h"
 #include "power-map.h"
 #include "settings.h"
+#include "speed-chart-window.h"
 #include "speed-map.h"
+#include "station.h"
+#include "trace.h"
 #include "ui_main-window.h"
+#include "worker-thread.h"
 #include "cvs.h"
 
 constexpr char DEFAULT_CONFIG_FN[] = "config.ini";
@@ -54,6 +78,27 @@ struct UiStep {
 	QPushButton *write;
 };
 
+struct UiStation {
+	QTreeWidgetItem *item;
+	QProgressBar *progress;
+};
+
+// Everything living in the calibration worker thread
+struct CalibCore {
+	Xn::XpressNet xn;
+	Wsm::Wsm wsm;
+	Di::DecoderImage di;
+	Tr::Trace trace;
+	Pm::PowerToSpeedMap pm;
+	Ssm::StepsToSpeedMap ssm;
+	Cm::CalibMan cm;
+	Cr::CalibRange cr;
+	Bq::BatchQueue batch;
+	std::vector<std::unique_ptr<St::Station>> stations; // station id = index + 1
+
+	CalibCore();
+};
+
 class MainWindow : public QMainWindow {
 	Q_OBJECT
 
@@ -95,8 +140,10 @@ private slots:
 	void b_decel_measure_handle();
 	void b_wsm_lt_handle();
 	void sb_max_speed_changed(int value);
-	void lv_log_dblclick(QListWidgetItem *);
-	void tw_xn_log_dblclick(QTreeWidgetItem *, int column);
+	void tv_log_dblclick(const QModelIndex &);
+	void tv_xn_log_dblclick(const QModelIndex &);
+	void log_filter_changed();
+	void xn_log_filter_changed();
 	void b_reset_handle();
 	void t_calib_active_tick();
 	void vs_steps_moved(int);
@@ -106,6 +153,7 @@ private slots:
 	void t_xn_disconnect_tick();
 	void cb_xn_ll_index_changed(int index);
 	void a_use_speed_table(bool);
+	void a_di_forget(bool);
 
 	void b_verify_all_steps_handle();
 	void b_verify_stop_handle();
@@ -124,11 +172,14 @@ private slots:
 	void a_wsm_connect(bool);
 	void a_wsm_disconnect(bool);
 	void a_power_graph(bool);
+	void a_speed_chart(bool);
 	void a_loco_load(bool);
 	void a_loco_save(bool);
 	void a_config_load(bool);
 	void a_config_save(bool);
 	void a_speed_load(bool);
+	void a_batch_run(bool);
+	void a_batch_stop(bool);
 
 	// Wsm events:
 	void mc_speedRead(double speed, uint16_t speed_raw);
@@ -153,17 +204,43 @@ private slots:
 	void cm_locoSpeedChanged(unsigned step);
 	void cm_done();
 	void cm_step_power_changed(unsigned step, unsigned power);
+	void cm_power_tried(unsigned step, unsigned power, Cm::CalibState phase);
 	void cm_progress_update(size_t val);
 	void cm_done_gui();
 
+	// Calibration stations events & GUI:
+	void st_done(unsigned id);
+	void st_error(unsigned id, Cm::CmError, unsigned step, const QString& note);
+	void st_log(unsigned id, const QString &, Cm::LogLevel);
+	void st_progress_update(unsigned id, size_t val);
+	void st_speed_read(unsigned id, double speed);
+	void b_stations_wsm_connect_handle();
+	void b_stations_start_handle();
+	void b_stations_stop_handle();
+
+	// Batch queue events:
+	void bq_job_start(size_t job);
+	void bq_swap_needed(size_t job);
+	void bq_finished(unsigned done, unsigned failed);
+
 	// Calibration range events:
 	void cr_measured(double distance);
 	void cr_error(Cr::CrError, unsigned step, const QString&);
 
 private:
 	Ui::MainWindow ui;
-	Xn::XpressNet xn;
-	Wsm::Wsm wsm;
+	Wt::WorkerThread m_core_thread;
+	std::unique_ptr<CalibCore> m_core; // created & destroyed in m_core_thread
+	Xn::XpressNet &xn;
+	Wsm::Wsm &wsm;
+	Di::DecoderImage &m_di;
+	Tr::Trace &m_trace;
+	Pm::PowerToSpeedMap &m_pm;
+	Ssm::StepsToSpeedMap &m_ssm;
+	Cm::CalibMan &cm;
+	Cr::CalibRange &cr;
+	Bq::BatchQueue &m_batch;
+	std::vector<std::unique_ptr<St::Station>> &m_stations;
 	Settings s;
 	QTimer t_xn_disconnect;
 	QTimer t_wsm_disconnect;
@@ -173,15 +250,18 @@ private:
 	QDateTime m_canBlink;
 	bool m_starting = false;
 	PowerGraphWindow w_pg;
+	SpeedChartWindow w_sc;
 	UiStep ui_steps[STEPS_CNT];
 	Xn::FA m_fa;
-	Pm::PowerToSpeedMap m_pm;
-	Ssm::StepsToSpeedMap m_ssm;
-	Cm::CalibMan cm;
-	Cr::CalibRange cr;
+	Ls::LogSink m_log_sink;
+	Ls::LogSink m_xn_log_sink;
+	Lm::LogModel m_log_model{Lm::DEFAULT_CAPACITY, true};
+	Lm::LogModel m_xn_log_model;
 	QString config_fn;
 	unsigned verif_next_step = 0; // 0 = no verification in progress
 	bool verif_in_progress;
+	std::vector<UiStation> ui_stations;
+	QTreeWidget *tw_stations = nullptr;
 
 	// Callbacks from XpressNET library:
 	void xn_onDccGoError(void *, void *);
@@ -214,7 +294,13 @@ private:
 	void reset();
 	void step_set_color(unsigned stepi, const QColor &color);
 	void gui_update_enabled();
-	void gui_step_update_enabled(UiStep&);
+	void gui_step_update_enabled(UiStep&, bool xn_connected, bool cm_in_progress);
+
+	template <typename F>
+	auto core(F &&f) { return m_core_thread.call(std::forward<F>(f)); } // run in core thread
+
+	template <typename F>
+	auto gui(F &&f) { return Wt::queued(this, std::forward<F>(f)); } // callback to GUI thread
 
 	void verif_init();
 	void verif_reset();
@@ -225,6 +311,15 @@ private:
 	void verif_read_error(unsigned step);
 
 	void use_speed_table_read_basic_config(Xn::ReadCVStatus, uint8_t value);
+	void di_update(unsigned cv, uint8_t value, Di::Source);
+	void di_forget(unsigned cv);
+
+	void config_load_station(St::Station &);
+
+	void stations_init();
+	void stations_init_gui();
+	void station_set_state(unsigned id, const QString &state, const QColor &color);
+
 	static QString explain_cv29(uint8_t value);
 };
 
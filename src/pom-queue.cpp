@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <iterator>
+
+#include "clock.h"
+#include "pom-queue.h"
+
+namespace Pq {
+
+bool Write::isSpeed() const { return (bit == SPEED); }
+
+bool Write::sameCv(const Write &other) const {
+	return (!isSpeed() && !other.isSpeed() &&
+	        static_cast<uint16_t>(addr) == static_cast<uint16_t>(other.addr) && cv == other.cv);
+}
+
+bool Write::sameTarget(const Write &other) const {
+	if (isSpeed() || other.isSpeed())
+		return (isSpeed() && other.isSpeed() &&
+		        static_cast<uint16_t>(addr) == static_cast<uint16_t>(other.addr));
+	return (sameCv(other) && bit == other.bit);
+}
+
+PomQueue::PomQueue(Xn::XpressNet &xn) : m_xn(xn) {}
+
+void PomQueue::pomWriteCv(const Xn::LocoAddr &addr, uint16_t cv, uint8_t value, Xn::UPCb ok,
+                          Xn::UPCb err) {
+	if (image != nullptr && image->skip_known && image->isKnown(addr, cv, value) &&
+	    !isQueued(addr, cv))
+		return skip(Write{addr, cv, value, {}, {}}, std::move(ok)); // decoder already has the value
+
+	enqueue(Write{addr, cv, value, {}, {}}, std::move(ok), std::move(err));
+}
+
+void PomQueue::pomWriteBit(const Xn::LocoAddr &addr, uint16_t cv, uint8_t bit, bool value,
+                           Xn::UPCb ok, Xn::UPCb err) {
+	if (image != nullptr && image->skip_known && image->isBitKnown(addr, cv, bit, value) &&
+	    !isQueued(addr, cv))
+		return skip(Write{addr, cv, value, {}, {}, bit}, std::move(ok));
+
+	enqueue(Write{addr, cv, value, {}, {}, bit}, std::move(ok), std::move(err));
+}
+
+void PomQueue::setSpeed(const Xn::LocoAddr &addr, uint8_t speed, Xn::Direction direction,
+                        Xn::UPCb ok, Xn::UPCb err) {
+	enqueue(Write{addr, 0, speed, {}, {}, SPEED, direction}, std::move(ok), std::move(err));
+}
+
+void PomQueue::skip(const Write &write, Xn::UPCb ok) {
+	m_skipped++;
+	record("skip", write);
+	if (ok != nullptr) {
+		std::shared_ptr<Xn::Cb> cb = std::move(ok);
+		Vc::singleShot(0, [cb]() { cb->func(nullptr, cb->data); });
+	}
+}
+
+void PomQueue::enqueue(Write &&write, Xn::UPCb ok, Xn::UPCb err) {
+	const uint8_t value = write.value;
+	auto waiting = std::find_if(m_pending.begin(), m_pending.end(),
+	                            [&write](const Write &w) { return w.sameTarget(write); });
+	if (waiting != m_pending.end()) {
+		// Take over callbacks of the waiting write, it is never sent
+		const bool same = (waiting->value == value && waiting->direction == write.direction);
+		if (!write.isSpeed()) {
+			if (same)
+				m_merged++;
+			else
+				m_dropped++;
+		}
+		record(same ? "merge" : "drop", *waiting);
+		std::move(waiting->ok.begin(), waiting->ok.end(), std::back_inserter(write.ok));
+		std::move(waiting->err.begin(), waiting->err.end(), std::back_inserter(write.err));
+		m_pending.erase(waiting);
+	}
+	if (ok != nullptr)
+		write.ok.push_back(std::move(ok));
+	if (err != nullptr)
+		write.err.push_back(std::move(err));
+
+	if (m_in_flight.has_value() && m_in_flight->sameTarget(write) && m_in_flight->value == value &&
+	    m_in_flight->direction == write.direction) {
+		// The same value is being written right now
+		if (!write.isSpeed())
+			m_merged++;
+		record("merge", write);
+		std::move(write.ok.begin(), write.ok.end(), std::back_inserter(m_in_flight->ok));
+		std::move(write.err.begin(), write.err.end(), std::back_inserter(m_in_flight->err));
+		return;
+	}
+
+	if (write.isSpeed()) {
+		auto firstPom = std::find_if(m_pending.begin(), m_pending.end(),
+		                             [](const Write &w) { return !w.isSpeed(); });
+		m_pending.insert(firstPom, std::move(write));
+	} else {
+		m_pending.push_back(std::move(write));
+	}
+	sendNext();
+}
+
+void PomQueue::sendNext() {
+	if (m_in_flight.has_value() || m_pending.empty())
+		return;
+
+	m_in_flight = std::move(m_pending.front());
+	m_pending.pop_front();
+	const unsigned id = ++m_in_flight_id;
+	record("send", m_in_flight.value());
+	if (!m_in_flight->isSpeed()) {
+		m_sent++;
+		if (image != nullptr)
+			image->forget(m_in_flight->addr, m_in_flight->cv); // unknown until confirmed
+	}
+
+	auto ok = std::make_unique<Xn::Cb>([this, id](void *s, void *) { written(id, true, s); });
+	auto err = std::make_unique<Xn::Cb>([this, id](void *s, void *) { written(id, false, s); });
+	if (m_in_flight->isSpeed())
+		m_xn.setSpeed(m_in_flight->addr, m_in_flight->value, m_in_flight->direction, std::move(ok),
+		              std::move(err));
+	else if (m_in_flight->bit == WHOLE_CV)
+		m_xn.pomWriteCv(m_in_flight->addr, m_in_flight->cv, m_in_flight->value, std::move(ok),
+		                std::move(err));
+	else
+		m_xn.pomWriteBit(m_in_flight->addr, m_in_flight->cv, m_in_flight->bit, m_in_flight->value,
+		                 std::move(ok), std::move(err));
+}
+
+void PomQueue::written(const unsigned id, const bool ok, void *source) {
+	if (id != m_in_flight_id || !m_in_flight.has_value())
+		return; // queue was cleared meanwhile
+
+	Write write = std::move(m_in_flight.value());
+	m_in_flight.reset();
+	record(ok ? "ack" : "nack", write);
+	if (ok && image != nullptr && !write.isSpeed()) {
+		if (write.bit == WHOLE_CV)
+			image->set(write.addr, write.cv, write.value, Di::Source::Written);
+		else
+			image->setBit(write.addr, write.cv, write.bit, write.value, Di::Source::Written);
+	}
+
+	// Callbacks could write again -> call them with no write in flight
+	for (const Xn::UPCb &cb : (ok ? write.ok : write.err))
+		if (cb->func != nullptr)
+			cb->func(source, cb->data);
+
+	sendNext();
+}
+
+bool PomQueue::isQueued(const Xn::LocoAddr &addr, const uint16_t cv) const {
+	const Write write{addr, cv, 0, {}, {}};
+	if (m_in_flight.has_value() && m_in_flight->sameCv(write))
+		return true;
+	return std::any_of(m_pending.begin(), m_pending.end(),
+	                   [&write](const Write &w) { return w.sameCv(write); });
+}
+
+void PomQueue::record(const char *event, const Write &write) const {
+	if (trace == nullptr || !trace->enabled())
+		return;
+	if (write.isSpeed()) {
+		trace->record("speed", event, {
+			{"loco", static_cast<unsigned>(static_cast<uint16_t>(write.addr))},
+			{"speed", static_cast<unsigned>(write.value)},
+			{"forward", write.direction == Xn::Direction::Forward},
+			{"pending", static_cast<unsigned>(m_pending.size())},
+		});
+		return;
+	}
+	std::vector<Tr::Field> fields {
+		{"loco", static_cast<unsigned>(static_cast<uint16_t>(write.addr))},
+		{"cv", static_cast<unsigned>(write.cv)},
+		{"value", static_cast<unsigned>(write.value)},
+		{"pending", static_cast<unsigned>(m_pending.size())},
+	};
+	if (write.bit != WHOLE_CV)
+		fields.push_back({"bit", write.bit});
+	trace->record("pom", event, fields);
+}
+
+void PomQueue::clear() {
+	m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(),
+	                               [](const Write &w) { return !w.isSpeed(); }),
+	                m_pending.end());
+	m_in_flight.reset();
+	m_in_flight_id++;
+	sendNext();
+}
+
+size_t PomQueue::pending() const { return m_pending.size(); }
+bool PomQueue::idle() const { return !m_in_flight.has_value() && m_pending.empty(); }
+
+unsigned PomQueue::sent() const { return m_sent; }
+unsigned PomQueue::dropped() const { return m_dropped; }
+unsigned PomQueue::merged() const { return m_merged; }
+unsigned PomQueue::skipped() const { return m_skipped; }
+
+void PomQueue::resetCounters() {
+	m_sent = 0;
+	m_dropped = 0;
+	m_merged = 0;
+	m_skipped = 0;
+}
+
+} // namespace Pq
@@ -0,0 +1,103 @@
+#ifndef POM_QUEUE_H
+#define POM_QUEUE_H
+
+/*
+This file defines a PomQueue class which sits in front of
+Xn::XpressNet::pomWriteCv, pomWriteBit & setSpeed and coalesces POM writes.
+All XpressNET commands of a calibration go through a single PomQueue.
+
+ * Only one command is sent to XpressNET at a time (in flight), the rest
+   waits in the queue. As each station (station.h) has its own queue, at most
+   one command per station waits in the XpressNET library, so stations sharing
+   an interface are served round-robin.
+ * Speed commands go before waiting POM writes, so stopping the loco is not
+   delayed by the writes. A waiting speed command of the same loco is replaced
+   by the new one.
+ * When a write to (loco, CV[, bit]) is requested and there is a write to the
+   same (loco, CV[, bit]) waiting in the queue, the waiting write is replaced by the new
+   one (older value is never sent = 'dropped'). The new write is moved to the
+   end of the queue so the order of the latest writes is kept.
+ * When the requested value is already being written (in flight), no new
+   write is sent at all ('merged').
+ * Callbacks are never lost: callbacks of a dropped/merged write are called
+   (in the order of requests) once the write which replaced it succeeds/fails.
+ * When a decoder image (decoder-image.h) is attached, writes of values
+   already known to be in the decoder are not sent at all ('skipped'), their
+   ok callback is called asynchronously. Confirmed writes update the image.
+ * When a trace (trace.h) is attached, every write, ack and coalescing is
+   recorded.
+*/
+
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include "decoder-image.h"
+#include "lib/xn/xn.h"
+#include "trace.h"
+
+namespace Pq {
+
+constexpr int WHOLE_CV = -1;
+constexpr int SPEED = -2; // Write::bit of speed commands
+
+struct Write {
+	Xn::LocoAddr addr;
+	uint16_t cv; // 0 for speed commands
+	uint8_t value; // 0/1 for bit writes, speed step for speed commands
+	std::vector<Xn::UPCb> ok;
+	std::vector<Xn::UPCb> err;
+	int bit = WHOLE_CV;
+	Xn::Direction direction = Xn::Direction::Forward; // speed commands only
+
+	bool isSpeed() const;
+	bool sameCv(const Write &other) const; // POM writes only
+	bool sameTarget(const Write &other) const; // same CV & same bit / speed of the same loco
+};
+
+class PomQueue {
+public:
+	Di::DecoderImage *image = nullptr;
+	Tr::Trace *trace = nullptr;
+
+	PomQueue(Xn::XpressNet &xn);
+
+	void pomWriteCv(const Xn::LocoAddr &addr, uint16_t cv, uint8_t value,
+	                Xn::UPCb ok = nullptr, Xn::UPCb err = nullptr);
+	void pomWriteBit(const Xn::LocoAddr &addr, uint16_t cv, uint8_t bit, bool value,
+	                 Xn::UPCb ok = nullptr, Xn::UPCb err = nullptr);
+	void setSpeed(const Xn::LocoAddr &addr, uint8_t speed, Xn::Direction direction,
+	              Xn::UPCb ok = nullptr, Xn::UPCb err = nullptr);
+	void clear(); // forget all POM writes (not speed commands), callbacks are not called
+
+	size_t pending() const; // commands waiting (without the in-flight one)
+	bool idle() const;
+
+	unsigned sent() const; // POM writes only, as the rest of the counters
+	unsigned dropped() const;
+	unsigned merged() const;
+	unsigned skipped() const;
+	void resetCounters();
+
+private:
+	Xn::XpressNet &m_xn;
+	std::deque<Write> m_pending;
+	std::optional<Write> m_in_flight;
+	unsigned m_in_flight_id = 0;
+
+	unsigned m_sent = 0;
+	unsigned m_dropped = 0;
+	unsigned m_merged = 0;
+	unsigned m_skipped = 0;
+
+	void enqueue(Write &&, Xn::UPCb ok, Xn::UPCb err);
+	void skip(const Write &, Xn::UPCb ok);
+	void sendNext();
+	bool isQueued(const Xn::LocoAddr &addr, uint16_t cv) const;
+	void written(unsigned id, bool ok, void *source);
+	void record(const char *event, const Write &) const;
+};
+
+} // namespace Pq
+
+#endif
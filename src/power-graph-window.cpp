@@ -8,10 +8,13 @@ PowerGraphWindow::PowerGraphWindow(QWidget *parent) : QMainWindow(parent) {
 
 	series.setPointsVisible(true);
 
-	series.append(2, 4);
-	series.append(3, 8);
-	series.append(7, 4);
-	series.append(10, 5);
+	// Same as Pm::PowerToSpeedMap after clear()
+	m_speeds.fill(Pm::EMPTY_VALUE);
+	m_speeds[0] = 0;
+	series.append(0, 0);
+
+	t_refresh.setSingleShot(true);
+	QObject::connect(&t_refresh, SIGNAL(timeout()), this, SLOT(refresh()));
 
 	chart.legend()->hide();
 	chart.addSeries(&series);
@@ -37,8 +40,6 @@ PowerGraphWindow::PowerGraphWindow(QWidget *parent) : QMainWindow(parent) {
 	auto *chartView = new QChartView(&chart);
 	chartView->setRenderHint(QPainter::Antialiasing);
 	this->setCentralWidget(chartView);
-
-	series.append(100, 100);
 }
 
 PowerGraphWindow::~PowerGraphWindow() {
@@ -51,17 +52,38 @@ PowerGraphWindow::~PowerGraphWindow() {
 }
 
 void PowerGraphWindow::addOrUpdate(unsigned step, float speed) {
-	for (int i = 0; i < series.count(); i++) {
-		if (series.at(i).x() == step) {
-			series.replace(i, QPointF(step, speed));
-			return;
-		}
-		if (series.at(i).x() > step) {
-			series.insert(i, QPointF(step, speed));
-			return;
-		}
-	}
-	series.append(step, speed);
+	if (step >= m_speeds.size())
+		return;
+	m_speeds[step] = speed;
+	changed();
 }
 
-void PowerGraphWindow::clear() { series.clear(); }
+void PowerGraphWindow::clear() {
+	m_speeds.fill(Pm::EMPTY_VALUE);
+	changed();
+}
+
+void PowerGraphWindow::changed() {
+	m_dirty = true;
+	if (this->isVisible() && !t_refresh.isActive())
+		t_refresh.start(PG_REFRESH_INTERVAL);
+}
+
+void PowerGraphWindow::showEvent(QShowEvent *event) {
+	QMainWindow::showEvent(event);
+	if (m_dirty)
+		this->refresh();
+}
+
+void PowerGraphWindow::refresh() {
+	t_refresh.stop();
+	if (!m_dirty || !this->isVisible())
+		return;
+
+	QList<QPointF> points;
+	for (size_t i = 0; i < m_speeds.size(); i++)
+		if (m_speeds[i] != Pm::EMPTY_VALUE)
+			points.append(QPointF(i, m_speeds[i]));
+	series.replace(points);
+	m_dirty = false;
+}
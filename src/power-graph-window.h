@@ -5,18 +5,29 @@
 This file defines a PowerGraphWindow class which manages Power Graph UI form.
 The main object at this form is QChart displaying mapping of real speed to
 power steps in decoder.
+
+Updates of the mapping are only stored to a power-indexed shadow array, the
+series is rebuilt from it at most once per PG_REFRESH_INTERVAL ms with a single
+replace() call (one chart relayout per refresh, not per update). While the
+window is hidden, no refresh is done at all; the series is rebuilt once the
+window is shown.
 */
 
 #include <QMainWindow>
+#include <QTimer>
+#include <array>
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
 
+#include "power-map.h"
 #include "ui_power-graph-window.h"
 
 #if QT_VERSION < 0x060000
 using namespace QtCharts;
 #endif
 
+constexpr unsigned PG_REFRESH_INTERVAL = 100; // ms
+
 class PowerGraphWindow : public QMainWindow {
 	Q_OBJECT
 
@@ -28,10 +39,21 @@ public slots:
 	void addOrUpdate(unsigned step, float speed);
 	void clear();
 
+protected:
+	void showEvent(QShowEvent *) override;
+
 private:
 	Ui::PowerGraphWindow ui;
 	QLineSeries series;
 	QChart chart;
+	std::array<float, Pm::POWER_CNT> m_speeds; // Pm::EMPTY_VALUE = no record
+	bool m_dirty = false; // m_speeds changed since last refresh
+	QTimer t_refresh;
+
+	void changed();
+
+private slots:
+	void refresh();
 };
 
 #endif // POWERGRAPHWINDOW_H
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+
 #include "power-map.h"
 
 namespace Pm {
@@ -7,32 +10,120 @@ PowerToSpeedMap::PowerToSpeedMap(QObject *parent) : QObject(parent) { clear(); }
 void PowerToSpeedMap::clear() {
 	for (auto &item : map)
 		item = EMPTY_VALUE;
+	for (auto &slope : m_slopes)
+		slope = 0;
 	map[0] = 0;
+	m_records = {0};
 	emit onClear();
 	emit onAddOrUpdate(0, 0);
 }
 
 void PowerToSpeedMap::addOrUpdate(const unsigned power, const float speed) {
 	map[power] = speed;
+
+	auto it = std::lower_bound(m_records.begin(), m_records.end(), power);
+	if (it == m_records.end() || *it != power)
+		it = m_records.insert(it, power);
+
+	// Slope of a record depends on its neighbours, end slopes depend on two
+	// neighbours -> update slopes of records in distance <= 2.
+	const size_t index = it - m_records.begin();
+	const size_t first = (index >= 2) ? index-2 : 0;
+	const size_t last = std::min(index+2, m_records.size()-1);
+	for (size_t i = first; i <= last; i++)
+		updateSlope(i);
+
 	emit onAddOrUpdate(power, speed);
 }
 
+void PowerToSpeedMap::updateSlope(const size_t i) {
+	// PCHIP slopes (Fritsch-Butland weighted harmonic mean)
+	const size_t n = m_records.size();
+	float &slope = m_slopes[m_records[i]];
+
+	if (n < 2) {
+		slope = 0;
+		return;
+	}
+
+	auto h = [this](size_t k) -> float {
+		return static_cast<float>(m_records[k+1]) - m_records[k];
+	};
+	auto delta = [this, &h](size_t k) -> float {
+		return (map[m_records[k+1]] - map[m_records[k]]) / h(k);
+	};
+
+	if (n == 2) {
+		slope = delta(0);
+		return;
+	}
+
+	if (i == 0 || i == n-1) {
+		// One-sided three-point estimate, shape preserving
+		const size_t k0 = (i == 0) ? 0 : n-2; // adjacent interval
+		const size_t k1 = (i == 0) ? 1 : n-3; // next interval
+		const float d0 = delta(k0), d1 = delta(k1);
+		float d = ((2*h(k0) + h(k1))*d0 - h(k0)*d1) / (h(k0) + h(k1));
+		if (std::signbit(d) != std::signbit(d0) || d0 == 0)
+			d = 0;
+		else if ((std::signbit(d0) != std::signbit(d1)) && std::abs(d) > 3*std::abs(d0))
+			d = 3*d0;
+		slope = d;
+		return;
+	}
+
+	const float dl = delta(i-1), dr = delta(i);
+	if (dl*dr <= 0) {
+		slope = 0; // local extremum or flat part
+		return;
+	}
+	const float w1 = 2*h(i) + h(i-1);
+	const float w2 = h(i) + 2*h(i-1);
+	slope = (w1 + w2) / ((w1 / dl) + (w2 / dr));
+}
+
+float PowerToSpeedMap::hermite(const size_t i, const float t) const {
+	// Speed on spline between records i and i+1, t \in [0, 1]
+	const unsigned x0 = m_records[i], x1 = m_records[i+1];
+	const float h = static_cast<float>(x1) - x0;
+	const float t2 = t*t, t3 = t2*t;
+	return (2*t3 - 3*t2 + 1)*map[x0] + (t3 - 2*t2 + t)*h*m_slopes[x0] +
+	       (-2*t3 + 3*t2)*map[x1] + (t3 - t2)*h*m_slopes[x1];
+}
+
 unsigned PowerToSpeedMap::power(const float speed) const {
-	size_t last = 0;
-	for (size_t i = 0; i < POWER_CNT; i++) {
-		if (EMPTY_VALUE != map[i]) {
-			if (map[i] == speed)
-				return i;
-			if (map[i] > speed) {
-				float deltaSp = speed - map[last];
-				float distSp = map[i] - map[last];
-				return ((deltaSp / distSp) * (i - last)) + last;
-			}
-			last = i;
-		}
+	if (m_records.size() < 2 || map[m_records.back()] < speed)
+		throw ENoMap("No map data for this speed!");
+	if (map[m_records.back()] == speed)
+		return m_records.back();
+	if (speed <= map[m_records.front()])
+		return m_records.front();
+
+	// Find records lo, lo+1 so that map[lo] <= speed < map[lo+1]
+	size_t lo = 0, hi = m_records.size()-1;
+	while (hi - lo > 1) {
+		const size_t mid = (lo + hi) / 2;
+		if (map[m_records[mid]] <= speed)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	if (map[m_records[lo]] == speed)
+		return m_records[lo];
+
+	// Spline is monotone between records lo and hi -> bisection
+	float tl = 0, tr = 1;
+	for (unsigned iter = 0; iter < INVERSE_ITERATIONS; iter++) {
+		const float t = (tl + tr) / 2;
+		if (hermite(lo, t) <= speed)
+			tl = t;
+		else
+			tr = t;
 	}
 
-	throw ENoMap("No map data for this speed!");
+	const float x0 = m_records[lo], x1 = m_records[hi];
+	return static_cast<unsigned>(std::lround(x0 + ((tl + tr) / 2)*(x1 - x0)));
 }
 
 bool PowerToSpeedMap::isRecord(const unsigned power) const { return (EMPTY_VALUE != map[power]); }
@@ -7,12 +7,19 @@ This file defines power-to-speed mapping via PowerToSpeedMap class.
  * It allows to assign 'float' speed to each power step (0-255).
  * It allows to interpolate power based on the current records in the mapping.
  * It allows to add new records to mapping dynamically.
+
+Interpolation is done via monotone cubic (PCHIP) spline over the records.
+Real motor curves are not linear (esp. near stall point), PCHIP follows
+their shape without overshooting. Slopes of the spline are updated
+incrementally on each addOrUpdate, sorted list of records is kept, so
+power() costs O(log n).
 */
 
 #include <QObject>
 #include <cstddef>
 #include <memory>
 #include <array>
+#include <vector>
 
 #include "lib/q-str-exception.h"
 
@@ -22,6 +29,7 @@ namespace Pm {
 
 constexpr size_t POWER_CNT = 256;
 constexpr float EMPTY_VALUE = -1;
+constexpr unsigned INVERSE_ITERATIONS = 32; // bisection iterations in power()
 
 struct ENoMap : public QStrException {
 	ENoMap(const QString str) : QStrException(str) {}
@@ -49,6 +57,11 @@ signals:
 
 private:
 	std::array<float, POWER_CNT> map;
+	std::vector<unsigned> m_records; // sorted powers with record
+	std::array<float, POWER_CNT> m_slopes; // spline slope at record (speed per power)
+
+	void updateSlope(size_t index);
+	float hermite(size_t index, float t) const;
 };
 
 } // namespace Pm
@@ -0,0 +1,105 @@
+#include <algorithm>
+
+#include "clock.h"
+#include "sample-buffer.h"
+
+namespace Sb {
+
+SampleBuffer::SampleBuffer(Wsm::Wsm &wsm, const size_t capacity, QObject *parent)
+    : QObject(parent), m_wsm(wsm), m_capacity(std::max<size_t>(capacity, 1)),
+      m_slots(new Slot[m_capacity]) {
+	QObject::connect(&m_wsm, SIGNAL(speedRead(double,uint16_t)), this,
+	                 SLOT(wsm_speed_read(double,uint16_t)));
+	QObject::connect(&m_wsm, SIGNAL(speedReceiveTimeout()), this, SIGNAL(speedReceiveTimeout()));
+}
+
+size_t SampleBuffer::capacity() const { return m_capacity; }
+bool SampleBuffer::speedOk() const { return m_wsm.isSpeedOk(); }
+
+uint64_t SampleBuffer::head() const { return m_head.load(std::memory_order_acquire); }
+
+uint64_t SampleBuffer::tail() const {
+	const uint64_t head = this->head();
+	return (head > m_capacity) ? head - m_capacity : 0;
+}
+
+void SampleBuffer::wsm_speed_read(const double speed, const uint16_t speed_raw) {
+	this->add({Vc::now(), speed, speed_raw, m_wsm.distRaw()});
+}
+
+void SampleBuffer::add(const Sample &sample) {
+	const uint64_t seq = m_head.load(std::memory_order_relaxed);
+	Slot &slot = m_slots[seq % m_capacity];
+
+	// Readers see NO_SEQ (or a mismatch) while the slot is being written
+	slot.seq.store(NO_SEQ, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.time.store(sample.time, std::memory_order_relaxed);
+	slot.speed.store(sample.speed, std::memory_order_relaxed);
+	slot.speed_raw.store(sample.speed_raw, std::memory_order_relaxed);
+	slot.dist_raw.store(sample.dist_raw, std::memory_order_relaxed);
+	slot.seq.store(seq, std::memory_order_release);
+
+	m_head.store(seq+1, std::memory_order_release);
+	emit sampleAdded(seq);
+}
+
+bool SampleBuffer::read(const uint64_t seq, Sample &sample) const {
+	const Slot &slot = m_slots[seq % m_capacity];
+	if (slot.seq.load(std::memory_order_acquire) != seq)
+		return false;
+
+	sample.time = slot.time.load(std::memory_order_relaxed);
+	sample.speed = slot.speed.load(std::memory_order_relaxed);
+	sample.speed_raw = slot.speed_raw.load(std::memory_order_relaxed);
+	sample.dist_raw = slot.dist_raw.load(std::memory_order_relaxed);
+
+	// Slot must not have been overwritten meanwhile
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return (slot.seq.load(std::memory_order_relaxed) == seq);
+}
+
+std::optional<Sample> SampleBuffer::last() const {
+	const uint64_t head = this->head();
+	Sample sample;
+	if (head == 0 || !this->read(head-1, sample))
+		return {};
+	return sample;
+}
+
+double SampleBuffer::tickSpeed() const {
+	// calcDist is in real meters, speeds are in scale kmph
+	return m_wsm.calcDist(1) * 3.6 * m_wsm.scale;
+}
+
+double SampleBuffer::ticksPerRevolution() const { return m_wsm.ticksPerRevolution; }
+
+///////////////////////////////////////////////////////////////////////////////
+
+Reader::Reader(const SampleBuffer &buffer) : m_buffer(buffer), m_pos(buffer.head()) {}
+
+void Reader::seekHead() { m_pos = m_buffer.head(); }
+
+void Reader::seek(const uint64_t seq) { m_pos = seq; }
+
+uint64_t Reader::position() const { return m_pos; }
+
+uint64_t Reader::lost() const { return m_lost; }
+
+const SampleBuffer &Reader::buffer() const { return m_buffer; }
+
+bool Reader::next(Sample &sample) {
+	while (m_pos < m_buffer.head()) {
+		const uint64_t tail = m_buffer.tail();
+		if (m_pos < tail) {
+			m_lost += tail - m_pos;
+			m_pos = tail;
+		}
+		if (m_buffer.read(m_pos++, sample))
+			return true;
+		m_lost++; // overwritten while reading
+	}
+	return false;
+}
+
+} // namespace Sb
@@ -0,0 +1,100 @@
+#ifndef SAMPLE_BUFFER_H
+#define SAMPLE_BUFFER_H
+
+/*
+This file defines a SampleBuffer class: timestamped history of samples from
+a single WSM shared by all the components which measure speed. Components
+do not connect to/disconnect from WSM signals for each measurement, they
+read the buffer with their own Reader instead.
+
+ * Single producer: the buffer itself (connected to WSM once). Any number
+   of readers, readers do not block the producer and do not allocate.
+ * Each sample gets a sequence number (0, 1, 2, ...). The last 'capacity'
+   samples are kept, older ones are overwritten.
+ * Readers may run in another thread than the producer (e.g. GUI). Each
+   slot is guarded by its sequence number (seqlock), so a reader never gets
+   a sample which was overwritten while being read.
+ * sampleAdded(seq) is emitted after each sample. Readers in the producer's
+   thread could read the sample straight away, readers in other threads
+   get the signal queued and should use Reader to catch up.
+*/
+
+#include <QObject>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "lib/wsm/wsm.h"
+
+namespace Sb {
+
+constexpr size_t DEFAULT_CAPACITY = 4096; // ~7 minutes of WSM samples
+
+struct Sample {
+	qint64 time; // ms, Vc::now()
+	double speed; // kmph
+	uint16_t speed_raw;
+	uint32_t dist_raw; // WSM distance counter when the speed was received
+};
+
+class SampleBuffer : public QObject {
+	Q_OBJECT
+
+public:
+	SampleBuffer(Wsm::Wsm &wsm, size_t capacity = DEFAULT_CAPACITY, QObject *parent = nullptr);
+
+	size_t capacity() const;
+	uint64_t head() const; // sequence number of the next sample (= number of samples so far)
+	uint64_t tail() const; // sequence number of the oldest sample available
+	bool read(uint64_t seq, Sample &) const; // false = not written yet or already overwritten
+	std::optional<Sample> last() const;
+	double tickSpeed() const; // kmph of one distance tick per second
+	double ticksPerRevolution() const;
+	bool speedOk() const; // WSM sends speed, producer's thread only
+
+	void add(const Sample &); // producer only
+
+private:
+	struct Slot {
+		std::atomic<uint64_t> seq{NO_SEQ};
+		std::atomic<qint64> time{0};
+		std::atomic<double> speed{0};
+		std::atomic<uint16_t> speed_raw{0};
+		std::atomic<uint32_t> dist_raw{0};
+	};
+	static constexpr uint64_t NO_SEQ = UINT64_MAX;
+
+	Wsm::Wsm &m_wsm;
+	const size_t m_capacity;
+	std::unique_ptr<Slot[]> m_slots;
+	std::atomic<uint64_t> m_head{0};
+
+private slots:
+	void wsm_speed_read(double speed, uint16_t speed_raw);
+
+signals:
+	void sampleAdded(quint64 seq);
+	void speedReceiveTimeout(); // forwarded from WSM
+};
+
+class Reader {
+public:
+	Reader(const SampleBuffer &);
+
+	void seekHead(); // read only samples added from now on
+	void seek(uint64_t seq);
+	bool next(Sample &); // false = no new sample
+	uint64_t position() const; // sequence number of the next sample to read
+	uint64_t lost() const; // samples overwritten before they were read
+	const SampleBuffer &buffer() const;
+
+private:
+	const SampleBuffer &m_buffer;
+	uint64_t m_pos = 0;
+	uint64_t m_lost = 0;
+};
+
+} // namespace Sb
+
+#endif
@@ -30,6 +30,20 @@ const Config DEFAULTS {
 	}},
 	{"Logging", {
 		{"file", ""},
+		{"maxSizeKb", 10240}, // rotate log files (incl. XN log) above this size, 0 = never
+		{"rotateCount", 3},
+		{"memoryKb", 1024}, // maximum log data waiting to be written
+	}},
+	{"DecoderImage", {
+		{"file", "decoders.ini"},
+		{"skipKnown", 1},
+		{"maxAgeHours", 0}, // older stored CV values are written again, 0 = no limit
+	}},
+	{"Trace", {
+		{"file", ""}, // calibration trace (jsonl), empty = disabled, see trace.h
+	}},
+	{"Stations", {
+		{"count", 0}, // additional calibration stations, see station.h
 	}},
 };
 
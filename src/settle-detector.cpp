@@ -0,0 +1,43 @@
+#include <cmath>
+
+#include "settle-detector.h"
+
+namespace Sd {
+
+void SettleDetector::reset() { m_samples.clear(); }
+
+bool SettleDetector::add(const double speed) {
+	m_samples.push_back(speed);
+	while (m_samples.size() > window)
+		m_samples.pop_front();
+	return settled();
+}
+
+bool SettleDetector::settled() const {
+	if (window < 2 || m_samples.size() < window)
+		return false;
+	return std::abs(slope()) <= max_slope;
+}
+
+double SettleDetector::slope() const {
+	// Least-squares fit of line through the samples, x = sample index
+	const size_t n = m_samples.size();
+	if (n < 2)
+		return 0;
+
+	const double mean_x = (n - 1) / 2.0;
+	double mean_y = 0;
+	for (const double &speed : m_samples)
+		mean_y += speed;
+	mean_y /= n;
+
+	double num = 0, den = 0;
+	for (size_t i = 0; i < n; i++) {
+		num += (i - mean_x) * (m_samples[i] - mean_y);
+		den += (i - mean_x) * (i - mean_x);
+	}
+
+	return (num / den) / SAMPLE_PERIOD;
+}
+
+} // namespace Sd
@@ -0,0 +1,42 @@
+#ifndef SETTLE_DETECTOR_H
+#define SETTLE_DETECTOR_H
+
+/*
+This file defines a SettleDetector class which decides whether the speed of
+a loco has already adapted to a newly set power.
+
+Instantaneous speeds from WSM are fed into the detector via add() function.
+The detector keeps last 'window' samples and fits a line through them. Once
+the window is full and the slope of the line is lower than 'max_slope', the
+speed is considered settled (it is not trending anymore, only noise remains).
+
+The detector does not care about time itself, caller should limit the
+waiting by a timeout.
+*/
+
+#include <cstddef>
+#include <deque>
+
+namespace Sd {
+
+constexpr unsigned DEFAULT_WINDOW = 10; // 10 samples = 1 s
+constexpr double DEFAULT_MAX_SLOPE = 1; // kmph per second
+constexpr double SAMPLE_PERIOD = 0.1; // WSM sends speed every 100 ms
+
+class SettleDetector {
+public:
+	unsigned window = DEFAULT_WINDOW;
+	double max_slope = DEFAULT_MAX_SLOPE;
+
+	void reset();
+	bool add(double speed); // returns true when settled
+	bool settled() const;
+	double slope() const; // kmph per second
+
+private:
+	std::deque<double> m_samples;
+};
+
+} // namespace Sd
+
+#endif
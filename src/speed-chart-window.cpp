@@ -0,0 +1,155 @@
+#include <algorithm>
+
+#include "power-map.h"
+#include "speed-chart-window.h"
+#include "speed-map.h"
+#include "ui_speed-chart-window.h"
+
+SpeedChartWindow::SpeedChartWindow(QWidget *parent) : QMainWindow(parent) {
+	ui.setupUi(this);
+	m_time.start();
+
+	s_speed.setName("Measured speed");
+	s_target.setName("Target speed");
+	s_power.setName("Power");
+	s_iterations.setName("Iteration");
+	s_iterations.setMarkerSize(7);
+
+	chart.addSeries(&s_speed);
+	chart.addSeries(&s_target);
+	chart.addSeries(&s_power);
+	chart.addSeries(&s_iterations);
+
+	axis_time.setRange(0, 60);
+	axis_time.setLabelFormat("%d");
+	axis_time.setTitleText("Time [s]");
+	chart.addAxis(&axis_time, Qt::AlignBottom);
+
+	axis_speed.setRange(0, Ssm::SPEED_MAX);
+	axis_speed.setTickCount(7);
+	axis_speed.setLabelFormat("%d");
+	axis_speed.setTitleText("Speed [model km/h]");
+	chart.addAxis(&axis_speed, Qt::AlignLeft);
+
+	axis_power.setRange(0, Pm::POWER_CNT);
+	axis_power.setTickCount(9);
+	axis_power.setLabelFormat("%d");
+	axis_power.setTitleText("Power [decoder step]");
+	chart.addAxis(&axis_power, Qt::AlignRight);
+
+	for (QAbstractSeries *series : {static_cast<QAbstractSeries *>(&s_speed),
+	                                static_cast<QAbstractSeries *>(&s_target)}) {
+		series->attachAxis(&axis_time);
+		series->attachAxis(&axis_speed);
+	}
+	for (QAbstractSeries *series : {static_cast<QAbstractSeries *>(&s_power),
+	                                static_cast<QAbstractSeries *>(&s_iterations)}) {
+		series->attachAxis(&axis_time);
+		series->attachAxis(&axis_power);
+	}
+
+	chart.setTitle("Speed & power in time");
+
+	auto *chartView = new QChartView(&chart);
+	chartView->setRenderHint(QPainter::Antialiasing);
+	this->setCentralWidget(chartView);
+
+	t_refresh.setSingleShot(true);
+	QObject::connect(&t_refresh, SIGNAL(timeout()), this, SLOT(refresh()));
+}
+
+SpeedChartWindow::~SpeedChartWindow() {
+	try {
+		// Series & axes are members, chart must not delete them
+		chart.removeSeries(&s_iterations);
+		chart.removeSeries(&s_power);
+		chart.removeSeries(&s_target);
+		chart.removeSeries(&s_speed);
+		chart.removeAxis(&axis_power);
+		chart.removeAxis(&axis_speed);
+		chart.removeAxis(&axis_time);
+	}
+	catch (...) {
+		// No exceptions in destructor!
+	}
+}
+
+double SpeedChartWindow::now() const { return m_time.elapsed() / 1000.0; }
+
+void SpeedChartWindow::speedRead(double speed) {
+	const double time = this->now();
+	m_speed.append(time, speed);
+	// Power & target are sampled with speed, so they keep their level
+	if (m_current_power.has_value())
+		m_power.append(time, m_current_power.value());
+	if (m_current_target.has_value())
+		m_target.append(time, m_current_target.value());
+	changed();
+}
+
+void SpeedChartWindow::powerChanged(unsigned power, bool iteration) {
+	const double time = this->now();
+	if (m_current_power.has_value())
+		m_power.append(time, m_current_power.value()); // vertical edge
+	m_power.append(time, power);
+	m_current_power = power;
+
+	if (iteration) {
+		if (m_iterations.size() >= SC_MAX_MARKERS) {
+			// Keep the whole session covered in constant memory
+			for (size_t i = 0; i < m_iterations.size()/2; i++)
+				m_iterations[i] = m_iterations[2*i+1];
+			m_iterations.resize(m_iterations.size()/2);
+		}
+		m_iterations.push_back(QPointF(time, power));
+	}
+	changed();
+}
+
+void SpeedChartWindow::setTarget(double speed) {
+	const double time = this->now();
+	if (m_current_target.has_value())
+		m_target.append(time, m_current_target.value());
+	m_target.append(time, speed);
+	m_current_target = speed;
+	changed();
+}
+
+void SpeedChartWindow::calibStopped() {
+	m_current_power.reset();
+	m_current_target.reset();
+}
+
+void SpeedChartWindow::clear() {
+	m_speed.clear();
+	m_power.clear();
+	m_target.clear();
+	m_iterations.clear();
+	m_time.restart();
+	changed();
+}
+
+void SpeedChartWindow::changed() {
+	m_dirty = true;
+	if (this->isVisible() && !t_refresh.isActive())
+		t_refresh.start(SC_REFRESH_INTERVAL);
+}
+
+void SpeedChartWindow::showEvent(QShowEvent *event) {
+	QMainWindow::showEvent(event);
+	if (m_dirty)
+		this->refresh();
+}
+
+void SpeedChartWindow::refresh() {
+	t_refresh.stop();
+	if (!m_dirty || !this->isVisible())
+		return;
+
+	s_speed.replace(m_speed.points());
+	s_power.replace(m_power.points());
+	s_target.replace(m_target.points());
+	s_iterations.replace(QList<QPointF>(m_iterations.begin(), m_iterations.end()));
+	axis_time.setRange(0, std::max(this->now(), 60.0));
+	m_dirty = false;
+}
@@ -0,0 +1,85 @@
+#ifndef SPEEDCHARTWINDOW_H
+#define SPEEDCHARTWINDOW_H
+
+/*
+This file defines a SpeedChartWindow class which manages Speed Chart UI form.
+It shows a live chart of the whole session: speed measured by WSM, power
+tried by the calibration (overview & steps, not neighbour steps nor
+interpolation) and the target speed of the calibrated step. Iterations of
+step calibration (each new power tried) are marked, so it is visible
+straight away when a loco is still settling or hunting.
+
+ * All series are decimated (decimated-series.h), so hours of samples
+   render in constant time & memory.
+ * Chart is refreshed at most once per SC_REFRESH_INTERVAL ms and not at
+   all while the window is hidden (like PowerGraphWindow).
+ * Time is in seconds since the start of the application.
+*/
+
+#include <QElapsedTimer>
+#include <QMainWindow>
+#include <QTimer>
+#include <QtCharts/QChartView>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QScatterSeries>
+#include <QtCharts/QValueAxis>
+#include <optional>
+#include <vector>
+
+#include "decimated-series.h"
+#include "ui_speed-chart-window.h"
+
+#if QT_VERSION < 0x060000
+using namespace QtCharts;
+#endif
+
+constexpr unsigned SC_REFRESH_INTERVAL = 500; // ms
+constexpr size_t SC_MAX_MARKERS = 1024; // every second marker is dropped above
+
+class SpeedChartWindow : public QMainWindow {
+	Q_OBJECT
+
+public:
+	SpeedChartWindow(QWidget *parent = nullptr);
+	~SpeedChartWindow() override;
+
+	void speedRead(double speed);
+	void powerChanged(unsigned power, bool iteration); // iteration = mark it
+	void setTarget(double speed);
+	void calibStopped(); // no power & target is shown until next change
+
+public slots:
+	void clear();
+
+protected:
+	void showEvent(QShowEvent *) override;
+
+private:
+	Ui::SpeedChartWindow ui;
+	QLineSeries s_speed;
+	QLineSeries s_power;
+	QLineSeries s_target;
+	QScatterSeries s_iterations;
+	QValueAxis axis_time;
+	QValueAxis axis_speed;
+	QValueAxis axis_power;
+	QChart chart;
+
+	QElapsedTimer m_time;
+	Ds::DecimatedSeries m_speed;
+	Ds::DecimatedSeries m_power;
+	Ds::DecimatedSeries m_target;
+	std::vector<QPointF> m_iterations;
+	std::optional<unsigned> m_current_power;
+	std::optional<double> m_current_target;
+	bool m_dirty = false;
+	QTimer t_refresh;
+
+	double now() const; // s
+	void changed();
+
+private slots:
+	void refresh();
+};
+
+#endif // SPEEDCHARTWINDOW_H
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cmath>
+
+#include "speed-estimator.h"
+
+namespace Se {
+
+RollingSpeed::RollingSpeed(const size_t capacity) : m_capacity(std::max<size_t>(capacity, 1)) {}
+
+void RollingSpeed::reset() {
+	m_samples.clear();
+	m_sum = 0;
+	m_sum_sq = 0;
+	m_sum_lag = 0;
+}
+
+void RollingSpeed::reset(const size_t capacity) {
+	m_capacity = std::max<size_t>(capacity, 1);
+	reset();
+}
+
+void RollingSpeed::add(const double speed) {
+	if (!m_samples.empty())
+		m_sum_lag += m_samples.back()*speed;
+	m_samples.push_back(speed);
+	m_sum += speed;
+	m_sum_sq += speed*speed;
+
+	if (m_samples.size() > m_capacity) {
+		const double old = m_samples.front();
+		m_samples.pop_front();
+		m_sum -= old;
+		m_sum_sq -= old*old;
+		m_sum_lag -= old*m_samples.front();
+	}
+}
+
+size_t RollingSpeed::capacity() const { return m_capacity; }
+
+size_t RollingSpeed::count() const { return m_samples.size(); }
+
+bool RollingSpeed::full() const { return m_samples.size() >= m_capacity; }
+
+bool RollingSpeed::empty() const { return m_samples.empty(); }
+
+double RollingSpeed::mean() const {
+	return m_samples.empty() ? 0 : m_sum / m_samples.size();
+}
+
+double RollingSpeed::diffusion() const {
+	if (m_samples.size() < 2)
+		return 0;
+	const double avg = mean();
+	// Running sums may get slightly negative variance due to rounding
+	return std::sqrt(std::max(0.0, (m_sum_sq / m_samples.size()) - avg*avg));
+}
+
+double RollingSpeed::autocorrelation() const {
+	const size_t n = m_samples.size();
+	if (n < 3)
+		return 0;
+	const double var = diffusion()*diffusion();
+	if (var <= 0)
+		return 0;
+	// sum of (x[i]-mean)*(x[i+1]-mean) from running sums, pairs do not
+	// contain the last (first) sample as x[i] (x[i+1])
+	const double avg = mean();
+	const double pairs = m_sum_lag - avg*((m_sum - m_samples.back()) + (m_sum - m_samples.front())) +
+	                     (n-1)*avg*avg;
+	return std::clamp((pairs / (n-1)) / var, -1.0, 1.0);
+}
+
+double RollingSpeed::effectiveCount() const {
+	// Negative correlation would make the window look more precise -> ignored
+	const double r = std::clamp(autocorrelation(), 0.0, 0.99);
+	return m_samples.size() * (1-r) / (1+r);
+}
+
+double RollingSpeed::meanError() const {
+	const size_t n = m_samples.size();
+	if (n < 2)
+		return 0;
+	// diffusion() is population deviation -> correct it to sample deviation
+	const double deviation = diffusion() * std::sqrt(static_cast<double>(n) / (n-1));
+	return deviation / std::sqrt(std::max(effectiveCount(), 1.0));
+}
+
+double repeatedZ(const double z, const unsigned look) {
+	const double k = std::max(look, 1u);
+	const double alpha = std::erfc(z / std::sqrt(2.0)) / (k*(k+1));
+	double low = 0, high = 40; // erfc is decreasing -> bisection
+	for (unsigned i = 0; i < 64; i++) {
+		const double mid = (low+high) / 2;
+		if (std::erfc(mid / std::sqrt(2.0)) > alpha)
+			low = mid;
+		else
+			high = mid;
+	}
+	return high;
+}
+
+bool RollingSpeed::isStable(const double max_abs_diffusion, const double max_rel_diffusion) const {
+	const double diff = diffusion();
+	return (diff <= max_abs_diffusion || diff <= mean()*max_rel_diffusion);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+DistanceSpeed::DistanceSpeed(const size_t capacity, const double tick_kmph)
+    : m_capacity(std::max<size_t>(capacity, 2)), m_tick_kmph(tick_kmph) {}
+
+void DistanceSpeed::reset() { m_samples.clear(); }
+
+void DistanceSpeed::reset(const size_t capacity, const double tick_kmph) {
+	m_capacity = std::max<size_t>(capacity, 2); // speed needs both ends of the window
+	m_tick_kmph = tick_kmph;
+	reset();
+}
+
+void DistanceSpeed::add(const qint64 time, const uint32_t dist_raw) {
+	m_samples.emplace_back(time, dist_raw);
+	if (m_samples.size() > m_capacity)
+		m_samples.pop_front();
+}
+
+size_t DistanceSpeed::count() const { return m_samples.size(); }
+
+bool DistanceSpeed::valid() const { return m_samples.size() >= 2 && duration() > 0; }
+
+qint64 DistanceSpeed::duration() const {
+	return m_samples.empty() ? 0 : m_samples.back().first - m_samples.front().first;
+}
+
+uint32_t DistanceSpeed::ticks() const {
+	// Unsigned difference is correct even when the counter overflowed
+	return m_samples.empty() ? 0 : m_samples.back().second - m_samples.front().second;
+}
+
+double DistanceSpeed::speed() const {
+	if (!valid())
+		return 0;
+	return m_tick_kmph * ticks() * 1000 / duration();
+}
+
+double DistanceSpeed::uncertainty() const {
+	if (!valid())
+		return m_tick_kmph; // as if measured for 1 s
+	return m_tick_kmph * 1000 / duration();
+}
+
+double estimate(const Method method, const RollingSpeed &samples, const DistanceSpeed &distance) {
+	if (method == Method::Distance && distance.valid())
+		return distance.speed();
+	return samples.mean();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RevolutionSpeed::reset(const size_t capacity, const double tick_kmph,
+                            const double ticks_per_revolution) {
+	m_means.reset(capacity);
+	m_distance.reset(capacity+1, tick_kmph); // boundaries of 'capacity' revolutions
+	m_ticks_per_revolution = std::max(ticks_per_revolution, 1.0);
+	m_revolution.reset();
+	m_started = false;
+	m_sum = 0;
+	m_count = 0;
+}
+
+bool RevolutionSpeed::add(const qint64 time, const double speed, const uint32_t dist_raw) {
+	const uint32_t revolution = static_cast<uint32_t>(dist_raw / m_ticks_per_revolution);
+	if (m_revolution == revolution) {
+		if (m_started) {
+			m_sum += speed;
+			m_count++;
+		}
+		return false;
+	}
+
+	const bool boundary = m_revolution.has_value(); // first sample is not a boundary
+	m_revolution = revolution;
+	if (!boundary)
+		return false;
+
+	const bool completed = m_started;
+	if (completed)
+		m_means.add(m_sum / m_count);
+	m_distance.add(time, dist_raw);
+	m_started = true;
+	m_sum = speed;
+	m_count = 1;
+	return completed;
+}
+
+const RollingSpeed &RevolutionSpeed::means() const { return m_means; }
+
+const DistanceSpeed &RevolutionSpeed::distance() const { return m_distance; }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Measurement::reset(const Method method, const size_t samples, const size_t revolutions,
+                        const double tick_kmph, const double ticks_per_revolution) {
+	m_method = method;
+	m_revolutions = revolutions;
+	m_too_slow = false;
+	m_samples.reset(samples);
+	m_distance.reset(samples, tick_kmph);
+	m_revolution_speed.reset(std::max<size_t>(revolutions, 1), tick_kmph, ticks_per_revolution);
+}
+
+bool Measurement::add(const qint64 time, const double speed, const uint32_t dist_raw) {
+	m_samples.add(speed);
+	m_distance.add(time, dist_raw);
+	const bool completed = m_revolution_speed.add(time, speed, dist_raw);
+	if (m_revolutions > 0 && m_samples.full() && m_revolution_speed.means().count() < 2)
+		m_too_slow = true; // (or stopped) -> window of samples
+	return aligned() ? completed : true;
+}
+
+bool Measurement::aligned() const { return m_revolutions > 0 && !m_too_slow; }
+
+const RollingSpeed &Measurement::window() const {
+	return aligned() ? m_revolution_speed.means() : m_samples;
+}
+
+const RollingSpeed &Measurement::samples() const { return m_samples; }
+
+const DistanceSpeed &Measurement::distance() const {
+	return aligned() ? m_revolution_speed.distance() : m_distance;
+}
+
+double Measurement::speed() const { return estimate(m_method, window(), distance()); }
+
+double Measurement::uncertainty(const double z) const {
+	if (m_method == Method::Distance && distance().valid())
+		return distance().uncertainty();
+	return z * window().meanError();
+}
+
+} // namespace Se
@@ -0,0 +1,166 @@
+#ifndef SPEED_ESTIMATOR_H
+#define SPEED_ESTIMATOR_H
+
+/*
+This file defines speed estimators of a loco measured by WSM.
+
+RollingSpeed estimates speed from a stream of instantaneous speeds.
+
+ * Samples are added one-by-one via add() function.
+ * Only last 'capacity' samples are taken into account, older samples are
+   forgotten (sliding window).
+ * Mean and diffusion (standard deviation) of the window are kept up-to-date
+   on each sample, so the caller can ask "is the speed stable now?" after
+   every sample instead of starting a new measurement from scratch.
+ * Standard error of the mean is provided too, so the caller can end
+   the measurement early, once the mean is known precisely enough.
+   Consecutive WSM speeds are strongly correlated (the loco does not change
+   speed within 100 ms), so the standard error uses effective number of
+   samples by lag-1 autocorrelation r: n * (1-r) / (1+r).
+ * Checking a confidence interval after every sample is a repeated test:
+   repeatedZ() gives a stricter z for each further check, so the overall
+   chance of a false decision stays the one of a single check with z.
+
+DistanceSpeed estimates speed from the WSM distance counter over the same
+sliding window: distance travelled / time. Instantaneous speeds are noisy
+and quantised, so their mean converges slowly; the distance is exact up to
+one tick, so the error of the speed falls with 1/duration of the window
+instead of 1/sqrt(samples).
+
+ * Uncertainty is +- one tick over the duration of the window (hard bound,
+   not a standard error).
+ * Distance counter is unsigned 32-bit, overflow is handled.
+
+RevolutionSpeed groups speeds by wheel revolutions (distance counter /
+ticks per revolution). Wheel eccentricity and magnet spacing add a ripple
+with period of one revolution to instantaneous speeds. Mean speed of a whole
+revolution does not contain the ripple, so mean & diffusion of revolution
+means are not inflated by it. The partial revolution at the beginning is
+dropped, so the window begins and ends on a revolution boundary.
+
+Measurement is the sliding window used by CalibStep & CalibOverview: it
+combines the estimators above by method & alignment. When aligned to
+revolutions, the window changes only when a revolution is completed. When
+the loco is too slow to complete 2 revolutions in the window of samples,
+the window of samples is used instead.
+*/
+
+#include <QtGlobal>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <utility>
+
+namespace Se {
+
+constexpr size_t UNLIMITED = std::numeric_limits<size_t>::max(); // window never slides
+
+enum class Method {
+	Samples, // mean of instantaneous speeds
+	Distance, // distance over time
+};
+
+class RollingSpeed {
+public:
+	RollingSpeed(size_t capacity = 1);
+
+	void reset();
+	void reset(size_t capacity);
+	void add(double speed);
+
+	size_t capacity() const;
+	size_t count() const;
+	bool full() const;
+	bool empty() const;
+
+	double mean() const;
+	double diffusion() const;
+	double autocorrelation() const; // lag-1
+	double effectiveCount() const; // count() corrected for autocorrelation
+	double meanError() const; // standard error of mean() by effectiveCount()
+	bool isStable(double max_abs_diffusion, double max_rel_diffusion) const;
+
+private:
+	size_t m_capacity;
+	std::deque<double> m_samples;
+	double m_sum = 0;
+	double m_sum_sq = 0;
+	double m_sum_lag = 0; // sum of products of consecutive samples
+};
+
+// z of a two-sided confidence interval for the look-th check (1, 2, ...) of
+// a sequential test, so that all checks together have the error rate of a
+// single check with z (error rate alpha is spent as alpha/(look*(look+1)))
+double repeatedZ(double z, unsigned look);
+
+class DistanceSpeed {
+public:
+	DistanceSpeed(size_t capacity = 1, double tick_kmph = 0);
+
+	void reset();
+	void reset(size_t capacity, double tick_kmph); // tick_kmph = speed of 1 tick per second
+	void add(qint64 time, uint32_t dist_raw); // time in ms
+
+	size_t count() const;
+	bool valid() const; // at least two samples in different time
+	qint64 duration() const; // ms
+	uint32_t ticks() const; // distance over the window
+
+	double speed() const; // kmph, 0 when !valid()
+	double uncertainty() const; // kmph, +- of speed()
+
+private:
+	size_t m_capacity;
+	double m_tick_kmph;
+	std::deque<std::pair<qint64, uint32_t>> m_samples; // (time, dist_raw)
+};
+
+// Speed of the window by 'method', falls back to samples when distance is not valid yet
+double estimate(Method, const RollingSpeed &, const DistanceSpeed &);
+
+class RevolutionSpeed {
+public:
+	void reset(size_t capacity, double tick_kmph, double ticks_per_revolution); // capacity in revolutions
+	bool add(qint64 time, double speed, uint32_t dist_raw); // returns true when revolution completed
+
+	const RollingSpeed &means() const; // mean speed of each whole revolution
+	const DistanceSpeed &distance() const; // from first to last revolution boundary
+
+private:
+	RollingSpeed m_means;
+	DistanceSpeed m_distance;
+	double m_ticks_per_revolution = 1;
+	std::optional<uint32_t> m_revolution; // index of current revolution
+	bool m_started = false; // first boundary crossed
+	double m_sum = 0; // speeds of current revolution
+	size_t m_count = 0;
+};
+
+class Measurement {
+public:
+	void reset(Method, size_t samples, size_t revolutions, double tick_kmph,
+	           double ticks_per_revolution); // revolutions = 0: not aligned
+	bool add(qint64 time, double speed, uint32_t dist_raw); // returns true when window changed
+
+	bool aligned() const; // window consists of whole revolutions
+	const RollingSpeed &window() const; // speeds (or revolution means) of the window
+	const RollingSpeed &samples() const; // last 'samples' instantaneous speeds
+	double speed() const; // kmph, by method
+	double uncertainty(double z) const; // kmph, +- of speed(), z applies to mean of speeds only
+
+private:
+	Method m_method = Method::Samples;
+	size_t m_revolutions = 0;
+	bool m_too_slow = false; // not aligned for the rest of the measurement
+	RollingSpeed m_samples;
+	DistanceSpeed m_distance;
+	RevolutionSpeed m_revolution_speed;
+
+	const DistanceSpeed &distance() const;
+};
+
+} // namespace Se
+
+#endif
@@ -0,0 +1,113 @@
+#include "calib-config.h"
+#include "station.h"
+
+namespace St {
+
+Station::Station(unsigned id, Xn::XpressNet &xn, Ssm::StepsToSpeedMap &ssm, QObject *parent)
+    : QObject(parent), id(id), cm(xn, pm, wsm, ssm), m_xn(xn) {
+	QObject::connect(&cm, SIGNAL(onDone()), this, SLOT(cm_done()));
+	QObject::connect(&cm, SIGNAL(onError(Cm::CmError,uint,const QString&)),
+	                 this, SLOT(cm_error(Cm::CmError,uint,const QString&)));
+	QObject::connect(&cm, SIGNAL(onLog(const QString&, Cm::LogLevel)),
+	                 this, SLOT(cm_log(const QString&, Cm::LogLevel)));
+	QObject::connect(&cm, SIGNAL(onProgressUpdate(size_t)), this, SLOT(cm_progress_update(size_t)));
+
+	QObject::connect(&wsm, SIGNAL(speedRead(double,uint16_t)), this,
+	                 SLOT(wsm_speed_read(double,uint16_t)));
+	QObject::connect(&wsm, SIGNAL(onError(QString)), this, SLOT(wsm_error(QString)));
+}
+
+QString Station::name() const { return "Station " + QString::number(id); }
+
+void Station::connectWsm() {
+	wsm.connect(wsm_port);
+	emit onLog(id, "Connected to WSM " + wsm_port, Cm::LogLevel::Info);
+}
+
+void Station::disconnectWsm() {
+	if (cm.inProgress())
+		stop();
+	wsm.disconnect();
+}
+
+void Station::start() {
+	if (cm.inProgress())
+		throw ENotReady(name() + " is already calibrating!");
+	if (!m_xn.connected())
+		throw ENotReady("Not connected to XpressNET!");
+	if (!wsm.connected())
+		throw ENotReady(name() + ": not connected to WSM!");
+	if (!wsm.isSpeedOk())
+		throw ENotReady(name() + ": no data from WSM!");
+
+	m_progress = 0;
+	emit onProgressUpdate(id, m_progress);
+	cm.calibrateAll(loco_addr, direction);
+}
+
+void Station::stop() {
+	if (!cm.inProgress())
+		return;
+
+	cm.stop();
+	emit onLog(id, "Calibration manually interrupted!", Cm::LogLevel::Warning);
+}
+
+void Station::reset() {
+	cm.reset();
+	pm.clear();
+	m_progress = 0;
+	emit onProgressUpdate(id, m_progress);
+}
+
+bool Station::inProgress() const { return cm.inProgress(); }
+size_t Station::progress() const { return m_progress; }
+
+void Station::cm_done() {
+	m_progress = 100;
+	emit onProgressUpdate(id, m_progress);
+	emit onDone(id);
+}
+
+void Station::cm_error(Cm::CmError error, unsigned step, const QString &note) {
+	emit onError(id, error, step, note);
+}
+
+void Station::cm_log(const QString &message, Cm::LogLevel level) {
+	emit onLog(id, message, level);
+}
+
+void Station::cm_progress_update(size_t val) {
+	m_progress = val;
+	emit onProgressUpdate(id, val);
+}
+
+void Station::wsm_speed_read(double speed, uint16_t) {
+	emit onSpeedRead(id, speed);
+}
+
+void Station::wsm_error(QString error) {
+	emit onLog(id, "WSM serial port error: " + error + "!", Cm::LogLevel::Error);
+	if (cm.inProgress())
+		cm.stop();
+}
+
+void applyConfig(Settings &s, Station &station) {
+	auto& stcfg = s["Station"+QString::number(station.id)];
+
+	Settings::cfgToQString(stcfg, "wsmPort", station.wsm_port);
+	Settings::cfgToUnsigned(stcfg, "loco", station.loco_addr);
+	unsigned forward = (station.direction == Xn::Direction::Forward);
+	Settings::cfgToUnsigned(stcfg, "forward", forward);
+	station.direction = static_cast<Xn::Direction>(forward > 0);
+
+	// Each track could have different WSM, defaults are taken from [WSM]
+	for (const char *key : {"scale", "wheelDiameter", "ticksPerRevolution"})
+		if (stcfg.find(key) == stcfg.end())
+			stcfg[key] = s["WSM"][key];
+	Cc::applyWsm(stcfg, station.wsm);
+
+	Cc::applyCalib(s, station.cm);
+}
+
+} // namespace St
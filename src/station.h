@@ -0,0 +1,87 @@
+#ifndef STATION_H
+#define STATION_H
+
+/*
+This file defines a Station class which represents a single calibration
+station = a test track with its own loco and its own WSM. Multiple stations
+could calibrate in parallel in a single process.
+
+ * Each station owns its WSM, its power-to-speed map and its calibration
+   manager. Steps-to-speed map (wanted speeds) is shared.
+ * All stations share a single XpressNET interface. Every command of
+   a station (POM writes, CV29 bit write, speed commands) goes through the
+   station's PomQueue (pom-queue.h), which keeps at most one command of the
+   station in flight. XpressNET library sends commands in FIFO order, so
+   stations are served round-robin: each station gets one command per round,
+   no matter how many commands it has queued (e.g. CalibStep::set_power
+   requests 3 POM writes at once). Time of each command still grows with
+   the number of stations.
+ * Station reports progress & log on its own, all events carry station id.
+*/
+
+#include <QObject>
+
+#include "calib-man.h"
+#include "lib/q-str-exception.h"
+#include "lib/wsm/wsm.h"
+#include "lib/xn/xn.h"
+#include "power-map.h"
+#include "settings.h"
+#include "speed-map.h"
+
+namespace St {
+
+struct ENotReady : public QStrException {
+	ENotReady(const QString str) : QStrException(str) {}
+};
+
+class Station : public QObject {
+	Q_OBJECT
+
+public:
+	const unsigned id;
+	QString wsm_port;
+	unsigned loco_addr = 3;
+	Xn::Direction direction = Xn::Direction::Forward;
+
+	Wsm::Wsm wsm;
+	Pm::PowerToSpeedMap pm;
+	Cm::CalibMan cm;
+
+	Station(unsigned id, Xn::XpressNet &xn, Ssm::StepsToSpeedMap &ssm, QObject *parent = nullptr);
+
+	void connectWsm(); // throws Wsm::EOpenError
+	void disconnectWsm();
+	void start(); // throws ENotReady
+	void stop();
+	void reset();
+	bool inProgress() const;
+	size_t progress() const; // 0-100
+	QString name() const;
+
+private:
+	Xn::XpressNet &m_xn;
+	size_t m_progress = 0;
+
+private slots:
+	void cm_done();
+	void cm_error(Cm::CmError, unsigned step, const QString &note);
+	void cm_log(const QString &, Cm::LogLevel);
+	void cm_progress_update(size_t val);
+	void wsm_speed_read(double speed, uint16_t speed_raw);
+	void wsm_error(QString error);
+
+signals:
+	void onDone(unsigned id);
+	void onError(unsigned id, Cm::CmError, unsigned step, const QString &note);
+	void onLog(unsigned id, const QString &, Cm::LogLevel);
+	void onProgressUpdate(unsigned id, size_t val); // value 0-100
+	void onSpeedRead(unsigned id, double speed);
+};
+
+// Applies [Station<id>] config section, see calib-config.h
+void applyConfig(Settings &, Station &);
+
+} // namespace St
+
+#endif
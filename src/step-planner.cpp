@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cmath>
+
+#include "step-planner.h"
+
+namespace Sp {
+
+double TransitionCost::transition(const double from, const double to) const {
+	return base + per_kmph * std::abs(to - from);
+}
+
+double TransitionCost::order(const std::vector<Target> &order, const double start_speed) const {
+	double total = 0;
+	double speed = start_speed;
+	for (const Target &target : order) {
+		total += transition(speed, target.speed);
+		speed = target.speed;
+	}
+	return total;
+}
+
+static void bisection_bin(const std::vector<Target> &targets, const size_t left,
+                          const size_t right, std::vector<Target> &result) {
+	// interval=[left, right)
+	if (right <= left)
+		return;
+
+	const size_t middle = ((right-left) / 2) + left;
+	if (middle != 0 && middle != targets.size()-1)
+		result.push_back(targets[middle]);
+
+	bisection_bin(targets, left, middle, result);
+	bisection_bin(targets, middle+1, right, result);
+}
+
+std::vector<Target> bisection(const std::vector<Target> &targets) {
+	std::vector<Target> result;
+	if (targets.empty())
+		return result;
+
+	result.push_back(targets.front());
+	if (targets.size() > 1)
+		result.push_back(targets.back());
+	bisection_bin(targets, 0, targets.size(), result);
+	return result;
+}
+
+std::vector<Target> plan(const std::vector<Target> &targets, const double start_speed,
+                         const unsigned anchors, const TransitionCost &cost) {
+	std::vector<Target> sorted = targets;
+	std::stable_sort(sorted.begin(), sorted.end(),
+	                 [](const Target &a, const Target &b) { return a.speed < b.speed; });
+
+	// Anchors: evenly spread from the top of the speed range
+	std::vector<Target> anchor_targets;
+	std::vector<Target> rest;
+	std::vector<bool> is_anchor(sorted.size(), false);
+	const unsigned anchors_cnt = std::min<size_t>(anchors, sorted.size());
+	for (unsigned i = 1; i <= anchors_cnt; i++)
+		is_anchor[std::lround(static_cast<double>(i) * (sorted.size()-1) / anchors_cnt)] = true;
+	for (size_t i = 0; i < sorted.size(); i++)
+		(is_anchor[i] ? anchor_targets : rest).push_back(sorted[i]);
+
+	// Try both directions of anchors and of the sweep, take the cheapest
+	std::vector<Target> best;
+	double best_cost = 0;
+	for (const bool anchors_up : {true, false}) {
+		for (const bool rest_up : {true, false}) {
+			std::vector<Target> candidate;
+			if (anchors_up)
+				candidate.insert(candidate.end(), anchor_targets.begin(), anchor_targets.end());
+			else
+				candidate.insert(candidate.end(), anchor_targets.rbegin(), anchor_targets.rend());
+			if (rest_up)
+				candidate.insert(candidate.end(), rest.begin(), rest.end());
+			else
+				candidate.insert(candidate.end(), rest.rbegin(), rest.rend());
+
+			const double candidate_cost = cost.order(candidate, start_speed);
+			if (best.empty() || candidate_cost < best_cost) {
+				best = candidate;
+				best_cost = candidate_cost;
+			}
+		}
+	}
+
+	return best;
+}
+
+} // namespace Sp
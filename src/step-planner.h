@@ -0,0 +1,48 @@
+#ifndef STEP_PLANNER_H
+#define STEP_PLANNER_H
+
+/*
+This file defines functions which decide in which order the speed steps are
+calibrated.
+
+Each change of speed costs time: the loco must accelerate/decelerate and the
+speed must settle before measuring. This is modelled by TransitionCost:
+cost = base + per_kmph * |speed difference| (seconds).
+
+ * bisection() returns the classic order: min step, max step, then middles
+   of the remaining intervals. The loco jumps between very different speeds.
+ * plan() returns an order minimizing total transition cost: optional
+   'anchor' steps evenly spread over the speed range are calibrated first
+   (they bound powers of the steps between them), the rest is swept
+   monotonically (ascending or descending, whichever is cheaper).
+*/
+
+#include <vector>
+
+namespace Sp {
+
+constexpr double DEFAULT_COST_BASE = 1.5; // s, settling after any speed change
+constexpr double DEFAULT_COST_PER_KMPH = 0.1; // s per kmph of speed change
+constexpr unsigned DEFAULT_ANCHORS = 0;
+
+struct Target {
+	unsigned step; // step index
+	double speed;
+};
+
+struct TransitionCost {
+	double base = DEFAULT_COST_BASE;
+	double per_kmph = DEFAULT_COST_PER_KMPH;
+
+	double transition(double from, double to) const;
+	double order(const std::vector<Target> &order, double start_speed) const;
+};
+
+// 'targets' must be sorted by step
+std::vector<Target> bisection(const std::vector<Target> &targets);
+std::vector<Target> plan(const std::vector<Target> &targets, double start_speed,
+                         unsigned anchors, const TransitionCost &cost);
+
+} // namespace Sp
+
+#endif
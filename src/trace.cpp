@@ -0,0 +1,114 @@
+#include <QDateTime>
+#include <cmath>
+
+#include "clock.h"
+#include "trace.h"
+
+namespace Tr {
+
+Trace::~Trace() { close(); }
+
+void Trace::open(const QString &filename) {
+	close();
+	m_file.setFileName(filename);
+	if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+		throw QStrException("Unable to open trace file " + filename + ": " + m_file.errorString());
+
+	m_start = Vc::now();
+	m_last_flush = m_start;
+	m_records = 0;
+	record("trace", "open", {
+		{"time", QDateTime::currentDateTime().toString(Qt::ISODate)},
+		{"version", QString("%1.%2").arg(VERSION_MAJOR).arg(VERSION_MINOR)},
+	});
+}
+
+void Trace::close() {
+	if (!m_file.isOpen())
+		return;
+	flush();
+	m_file.close();
+}
+
+bool Trace::enabled() const { return m_file.isOpen(); }
+QString Trace::filename() const { return m_file.fileName(); }
+unsigned Trace::records() const { return m_records; }
+
+void Trace::record(const char *source, const char *event, std::initializer_list<Field> fields) {
+	if (m_file.isOpen())
+		append(source, event, fields.begin(), fields.end());
+}
+
+void Trace::record(const char *source, const char *event, const std::vector<Field> &fields) {
+	if (m_file.isOpen())
+		append(source, event, fields.data(), fields.data() + fields.size());
+}
+
+void Trace::append(const char *source, const char *event, const Field *begin, const Field *end) {
+	const qint64 now = Vc::now();
+	m_buffer.append("{\"t\":");
+	m_buffer.append(QByteArray::number(now - m_start));
+	m_buffer.append(",\"src\":\"");
+	m_buffer.append(source);
+	m_buffer.append("\",\"ev\":\"");
+	m_buffer.append(event);
+	m_buffer.append('"');
+
+	for (const Field *field = begin; field != end; field++) {
+		m_buffer.append(",\"");
+		m_buffer.append(field->key);
+		m_buffer.append("\":");
+		switch (field->type) {
+			case Field::Type::Int:
+				m_buffer.append(QByteArray::number(field->i));
+				break;
+			case Field::Type::Double:
+				if (std::isfinite(field->d))
+					m_buffer.append(QByteArray::number(field->d, 'g', 6));
+				else
+					m_buffer.append("null"); // not representable in JSON
+				break;
+			case Field::Type::Bool:
+				m_buffer.append(field->i ? "true" : "false");
+				break;
+			case Field::Type::String:
+				appendString(m_buffer, field->s);
+				break;
+		}
+	}
+	m_buffer.append("}\n");
+	m_records++;
+
+	if (static_cast<size_t>(m_buffer.size()) >= buffer_size || now - m_last_flush >= flush_interval)
+		flush();
+}
+
+void Trace::flush() {
+	m_last_flush = Vc::now();
+	if (!m_file.isOpen() || m_buffer.isEmpty())
+		return;
+	m_file.write(m_buffer);
+	m_file.flush();
+	m_buffer.clear();
+}
+
+void Trace::appendString(QByteArray &buffer, const QString &str) {
+	buffer.append('"');
+	for (const char c : str.toUtf8()) {
+		switch (c) {
+			case '"': buffer.append("\\\""); break;
+			case '\\': buffer.append("\\\\"); break;
+			case '\n': buffer.append("\\n"); break;
+			case '\r': buffer.append("\\r"); break;
+			case '\t': buffer.append("\\t"); break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+					buffer.append(QString::asprintf("\\u%04x", c).toLatin1());
+				else
+					buffer.append(c);
+		}
+	}
+	buffer.append('"');
+}
+
+} // namespace Tr
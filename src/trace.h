@@ -0,0 +1,90 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+This file defines a Trace class which records a structured trace of the
+calibration: every WSM speed sample, every speed measure result, every POM
+write & speed command with its acknowledgement, every power decision and
+every state transition of CalibMan, CalibStep and CalibOverview.
+
+ * Trace is a JSONL file: one JSON object per line, e.g.
+   {"t":1520,"src":"cs","ev":"set_power","loco":1234,"step":5,"power":87}
+   "t" is time in ms since the trace was opened (clock.h, so virtual time
+   in the simulator), "src" is the source component, "ev" the event.
+ * Trace is cheap enough to be left on permanently: when no file is open,
+   record() returns immediately; otherwise records are formatted directly
+   into an in-memory buffer, which is written to the file once it exceeds
+   buffer_size or flush_interval passes (and on flush() & close()).
+ * The file is appended to, so traces of multiple runs (and stations)
+   could be kept in a single file.
+ * Components hold a pointer to the trace (nullptr = no trace), see
+   CalibMan::setTrace.
+*/
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <initializer_list>
+#include <vector>
+
+#include "lib/q-str-exception.h"
+
+namespace Tr {
+
+constexpr size_t DEFAULT_BUFFER_SIZE = 64*1024; // bytes
+constexpr qint64 DEFAULT_FLUSH_INTERVAL = 5000; // ms
+
+struct Field {
+	enum class Type {
+		Int,
+		Double,
+		Bool,
+		String,
+	};
+
+	const char *key;
+	Type type;
+	qint64 i = 0;
+	double d = 0;
+	QString s;
+
+	Field(const char *key, int value) : key(key), type(Type::Int), i(value) {}
+	Field(const char *key, unsigned value) : key(key), type(Type::Int), i(value) {}
+	Field(const char *key, qint64 value) : key(key), type(Type::Int), i(value) {}
+	Field(const char *key, double value) : key(key), type(Type::Double), d(value) {}
+	Field(const char *key, bool value) : key(key), type(Type::Bool), i(value) {}
+	Field(const char *key, const char *value) : key(key), type(Type::String), s(value) {}
+	Field(const char *key, const QString &value) : key(key), type(Type::String), s(value) {}
+};
+
+class Trace {
+public:
+	size_t buffer_size = DEFAULT_BUFFER_SIZE;
+	qint64 flush_interval = DEFAULT_FLUSH_INTERVAL;
+
+	~Trace();
+
+	void open(const QString &filename); // throws QStrException
+	void close();
+	bool enabled() const;
+	QString filename() const;
+
+	void record(const char *source, const char *event, std::initializer_list<Field> = {});
+	void record(const char *source, const char *event, const std::vector<Field> &);
+	void flush();
+	unsigned records() const; // since open()
+
+private:
+	QFile m_file;
+	QByteArray m_buffer;
+	qint64 m_start = 0;
+	qint64 m_last_flush = 0;
+	unsigned m_records = 0;
+
+	void append(const char *source, const char *event, const Field *begin, const Field *end);
+	static void appendString(QByteArray &, const QString &);
+};
+
+} // namespace Tr
+
+#endif
@@ -0,0 +1,52 @@
+#include "track-mark.h"
+
+namespace Tm {
+
+bool TrackMark::enabled() const { return track_length > 0; }
+
+void TrackMark::setOrigin(const uint32_t dist_raw) { m_origin = dist_raw; }
+
+uint32_t TrackMark::position(const uint32_t dist_raw) const {
+	if (!enabled())
+		return 0;
+	const uint64_t travelled = static_cast<uint32_t>(dist_raw - m_origin); // counter may overflow
+	return static_cast<uint32_t>((travelled + track_length - mark % track_length) % track_length);
+}
+
+unsigned TrackMark::crossings(const uint32_t from, const uint32_t to) const {
+	if (!enabled())
+		return 0;
+	const uint64_t travelled = static_cast<uint32_t>(to - from); // counter may overflow
+	return static_cast<unsigned>((position(from) + travelled) / track_length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void MarkTracker::reset(const TrackMark &track) {
+	m_track = &track;
+	m_last_dist.reset();
+	m_mark_time = 0;
+	m_passed = 0;
+}
+
+bool MarkTracker::add(const qint64 time, const uint32_t dist_raw) {
+	if (!m_last_dist.has_value()) {
+		m_last_dist = dist_raw;
+		m_mark_time = time;
+		return false;
+	}
+
+	const unsigned crossings = m_track->crossings(m_last_dist.value(), dist_raw);
+	m_last_dist = dist_raw;
+	if (crossings == 0)
+		return false;
+	m_passed += crossings;
+	m_mark_time = time;
+	return true;
+}
+
+unsigned MarkTracker::passed() const { return m_passed; }
+
+qint64 MarkTracker::sinceMark(const qint64 time) const { return time - m_mark_time; }
+
+} // namespace Tm
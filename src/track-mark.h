@@ -0,0 +1,56 @@
+#ifndef TRACK_MARK_H
+#define TRACK_MARK_H
+
+/*
+This file defines position of a loco on a closed track (oval) computed from
+the WSM distance counter. Gradients & curves change the speed of a loco
+along the track, so a measurement is biased by where the loco happens to be.
+Measurements could start at the same position (mark) instead and could be
+averaged over whole laps, which removes the bias completely.
+
+ * TrackMark: track length & position of the mark in WSM distance ticks.
+   Positions are counted from an origin: the distance counter at the start
+   of the calibration (the loco is at the same place then in each run).
+ * MarkTracker: follows the loco while measuring and reports when the mark
+   is passed.
+ * The counter only increases while the loco moves, whatever the
+   direction is.
+*/
+
+#include <QtGlobal>
+#include <cstdint>
+#include <optional>
+
+namespace Tm {
+
+class TrackMark {
+public:
+	uint32_t track_length = 0; // WSM distance ticks per lap, 0 = position not known
+	uint32_t mark = 0; // ticks of the mark after the origin
+
+	bool enabled() const;
+	void setOrigin(uint32_t dist_raw);
+	uint32_t position(uint32_t dist_raw) const; // ticks after the mark within a lap
+	unsigned crossings(uint32_t from, uint32_t to) const; // how many times the mark is passed
+
+private:
+	uint32_t m_origin = 0;
+};
+
+class MarkTracker {
+public:
+	void reset(const TrackMark &);
+	bool add(qint64 time, uint32_t dist_raw); // returns true when the mark was passed
+	unsigned passed() const; // marks passed since reset
+	qint64 sinceMark(qint64 time) const; // ms since the last mark passed (or the first sample)
+
+private:
+	const TrackMark *m_track = nullptr;
+	std::optional<uint32_t> m_last_dist;
+	qint64 m_mark_time = 0;
+	unsigned m_passed = 0;
+};
+
+} // namespace Tm
+
+#endif
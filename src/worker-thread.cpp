@@ -0,0 +1,18 @@
+#include "worker-thread.h"
+
+namespace Wt {
+
+WorkerThread::WorkerThread(const QString &name) {
+	m_thread.setObjectName(name);
+	m_context.moveToThread(&m_thread);
+	m_thread.start();
+}
+
+WorkerThread::~WorkerThread() {
+	m_thread.quit();
+	m_thread.wait();
+}
+
+bool WorkerThread::isCurrent() const { return QThread::currentThread() == &m_thread; }
+
+} // namespace Wt
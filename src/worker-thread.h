@@ -0,0 +1,92 @@
+#ifndef WORKER_THREAD_H
+#define WORKER_THREAD_H
+
+/*
+This file defines a WorkerThread class: a thread with its own Qt event loop.
+Objects living in the thread (e.g. XpressNET & WSM serial stacks and the
+calibration state machine) handle their serial port data & timers there, so
+their timing does not depend on what the GUI thread is doing.
+
+ * Objects must be created in the thread (via call()), so their member
+   QObjects & timers belong to the thread too. They must be destroyed in
+   the thread as well.
+ * call() runs a function in the thread and waits for its result,
+   exceptions are rethrown to the caller. Called from the thread itself,
+   the function is just executed. The thread must never call() another
+   thread waiting for it (deadlock): worker thread reports to the GUI only
+   asynchronously (signals connected across threads are queued
+   automatically, callbacks are wrapped by queued()).
+ * post() runs a function in the thread without waiting.
+ * queued(context, f) wraps a callback, so it is always executed in the
+   thread of 'context' (asynchronously).
+*/
+
+#include <QMetaObject>
+#include <QObject>
+#include <QThread>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace Wt {
+
+class WorkerThread {
+public:
+	explicit WorkerThread(const QString &name);
+	~WorkerThread(); // stops the event loop & waits for the thread
+
+	bool isCurrent() const;
+
+	template <typename F>
+	void post(F &&f) {
+		QMetaObject::invokeMethod(&m_context, std::forward<F>(f), Qt::QueuedConnection);
+	}
+
+	template <typename F>
+	auto call(F &&f) -> decltype(f()) {
+		using Result = decltype(f());
+		if (this->isCurrent())
+			return f();
+
+		std::exception_ptr error;
+		if constexpr (std::is_void_v<Result>) {
+			QMetaObject::invokeMethod(&m_context, [&f, &error]() {
+				try {
+					f();
+				} catch (...) {
+					error = std::current_exception();
+				}
+			}, Qt::BlockingQueuedConnection);
+			if (error)
+				std::rethrow_exception(error);
+		} else {
+			std::optional<Result> result;
+			QMetaObject::invokeMethod(&m_context, [&f, &error, &result]() {
+				try {
+					result.emplace(f());
+				} catch (...) {
+					error = std::current_exception();
+				}
+			}, Qt::BlockingQueuedConnection);
+			if (error)
+				std::rethrow_exception(error);
+			return std::move(result.value());
+		}
+	}
+
+private:
+	QThread m_thread;
+	QObject m_context; // lives in m_thread, receives the calls
+};
+
+template <typename F>
+auto queued(QObject *context, F f) {
+	return [context, f](auto... args) {
+		QMetaObject::invokeMethod(context, [f, args...]() { f(args...); }, Qt::QueuedConnection);
+	};
+}
+
+} // namespace Wt
+
+#endif